@@ -0,0 +1,84 @@
+lib = File.expand_path('../../lib', __FILE__)
+$LOAD_PATH.unshift(lib) unless $LOAD_PATH.include?(lib)
+require 'rbuv'
+require 'benchmark'
+
+# Measures what a callback costs, run it before and after changing how
+# callbacks are called.
+
+EVENTS = 1_000_000
+CHUNK = "x" * 16
+CHUNKS = 100_000
+
+class Counter
+  attr_reader :count
+  def initialize(stream)
+    @stream = stream
+    @count = 0
+  end
+  def on_data(data) @count += 1 end
+  def on_eof; @stream.close end
+end
+
+def idle_events
+  Rbuv.run do
+    count = 0
+    idle = Rbuv::Idle.new
+    idle.start do
+      count += 1
+      idle.close if count == EVENTS
+    end
+  end
+end
+
+def read_events(handler)
+  reads = 0
+  Rbuv.run do
+    server = Rbuv::Tcp.new
+    server.bind '127.0.0.1', 60000
+    server.listen 10 do
+      client = Rbuv::Tcp.new
+      server.accept client
+      server.close
+      if handler
+        handler = Counter.new(client)
+        client.read_start(handler)
+      else
+        client.read_start do |data, error|
+          if error
+            client.close
+          else
+            reads += 1
+          end
+        end
+      end
+    end
+    writer = Rbuv::Tcp.new
+    writer.connect '127.0.0.1', 60000 do
+      sent = 0
+      pump = Rbuv::Idle.new
+      pump.start do
+        # One small write per loop iteration, so most reads are one chunk
+        writer.write CHUNK
+        sent += 1
+        if sent >= CHUNKS
+          pump.close
+          writer.shutdown { writer.close }
+        end
+      end
+    end
+  end
+  handler ? handler.count : reads
+end
+
+Benchmark.bm(16) do |x|
+  x.report("idle callbacks") { idle_events }
+  x.report("read block") { read_events(false) }
+  x.report("read handler") do
+    begin
+      read_events(true)
+    rescue ArgumentError
+      puts "read_start does not take a handler"
+    end
+  end
+end
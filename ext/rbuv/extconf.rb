@@ -5,6 +5,10 @@ dir_config('uv')
 if have_library('uv', 'uv_version', ['uv.h'])
   have_header('ruby/thread.h')
   have_func('rb_thread_call_without_gvl', 'ruby/thread.h')
+  have_func('rb_gc_mark_movable')
+  if have_header('ruby/io/buffer.h')
+    have_func('rb_io_buffer_get_bytes_for_writing', 'ruby/io/buffer.h')
+  end
 
   ##
   # Adds -DRBUV_DEBUG for compilation
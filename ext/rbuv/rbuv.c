@@ -18,8 +18,10 @@ void Init_rbuv() {
   Init_rbuv_handle();
   Init_rbuv_loop();
   Init_rbuv_timer();
+  Init_rbuv_timer_wheel();
   Init_rbuv_stream();
   Init_rbuv_tcp();
+  Init_rbuv_pipe();
   Init_rbuv_signal();
   Init_rbuv_poll();
   Init_rbuv_prepare();
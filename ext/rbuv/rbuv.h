@@ -12,15 +12,19 @@
 #include "rbuv_debug.h"
 
 #include "rbuv_error.h"
+#include "rbuv_buffer.h"
+#include "rbuv_framer.h"
 #include "rbuv_handle.h"
 #include "rbuv_loop.h"
 #include "rbuv_timer.h"
+#include "rbuv_timer_wheel.h"
 #include "rbuv_request.h"
 #include "rbuv_write.h"
 #include "rbuv_shutdown.h"
 #include "rbuv_getaddrinfo.h"
 #include "rbuv_stream.h"
 #include "rbuv_tcp.h"
+#include "rbuv_pipe.h"
 #include "rbuv_signal.h"
 #include "rbuv_poll.h"
 #include "rbuv_prepare.h"
@@ -35,7 +39,7 @@ extern VALUE mRbuv;
 
 #define RBUV_CHECK_UV_RETURN(uv_ret) do { \
   if (uv_ret < 0) { \
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret)); \
+    rbuv_error_raise(uv_ret); \
   } \
 } while(0)
 
@@ -44,7 +48,7 @@ extern VALUE mRbuv;
   const typeof( ((type *)0)->member ) *__mptr = (ptr); \
   (type *)( (char *)__mptr - RBUV_OFFSETOF(type, member) );})
 #define Data_Get_Handle_Struct(obj, type, sval) do { \
-  Data_Get_Struct(obj, type, sval); \
+  TypedData_Get_Struct(obj, type, &rbuv_handle_type, sval); \
   if (sval->uv_handle == NULL) { \
     rb_raise(eRbuvError, "This %s handle is closed", rb_obj_classname(obj));\
   } \
@@ -52,4 +56,19 @@ extern VALUE mRbuv;
 
 typedef void *(*rbuv_rb_blocking_function_t)(void *);
 
+/*
+ * Objects only referenced by rbuv are marked with rb_gc_mark_movable and
+ * updated by the dcompact functions. The ones libuv holds on to, like the
+ * handles, the requests and the buffers it reads into or writes from, are
+ * marked with rb_gc_mark so they are pinned.
+ */
+#ifdef HAVE_RB_GC_MARK_MOVABLE
+# define RBUV_DCOMPACT(compact) .dcompact = (RUBY_DATA_FUNC)(compact),
+#else
+# define rb_gc_mark_movable(value) rb_gc_mark(value)
+# define rb_gc_location(value) (value)
+# define RBUV_DCOMPACT(compact)
+#endif
+#define RBUV_GC_UPDATE(value) ((value) = rb_gc_location(value))
+
 #endif  /* RBUV_H_ */
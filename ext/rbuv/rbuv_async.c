@@ -3,20 +3,40 @@
 struct rbuv_async_s {
   uv_async_t *uv_handle;
   VALUE cb_on_close;
+  uv_async_t uv_async;
   VALUE cb_on_async;
 };
 typedef struct rbuv_async_s rbuv_async_t;
 
 VALUE cRbuvAsync;
 
+struct rbuv_async_on_async_arg_s {
+  uv_async_t *uv_async;
+};
+typedef struct rbuv_async_on_async_arg_s rbuv_async_on_async_arg_t;
+
 /* Allocator / Mark / Deallocator */
 static VALUE rbuv_async_alloc(VALUE klass);
 static void rbuv_async_mark(rbuv_async_t *rbuv_async);
 static void rbuv_async_free(rbuv_async_t *rbuv_async);
+static void rbuv_async_compact(rbuv_async_t *rbuv_async);
+static size_t rbuv_async_memsize(const rbuv_async_t *rbuv_async);
+
+static const rb_data_type_t rbuv_async_type = {
+  .wrap_struct_name = "rbuv_async",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_async_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_async_free,
+    .dsize = (size_t (*)(const void *))rbuv_async_memsize,
+    RBUV_DCOMPACT(rbuv_async_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_async_on_async(uv_async_t *uv_async);
-static void rbuv_async_on_async_no_gvl(uv_async_t *uv_async);
+static void rbuv_async_on_async_no_gvl(rbuv_async_on_async_arg_t *arg);
 
 static VALUE rbuv_async_alloc(VALUE klass) {
   rbuv_async_t *rbuv_async;
@@ -24,7 +44,7 @@ static VALUE rbuv_async_alloc(VALUE klass) {
   rbuv_async = malloc(sizeof(*rbuv_async));
   rbuv_handle_alloc((rbuv_handle_t *)rbuv_async);
   rbuv_async->cb_on_async = Qnil;
-  return Data_Wrap_Struct(klass, rbuv_async_mark, rbuv_async_free, rbuv_async);
+  return TypedData_Wrap_Struct(klass, &rbuv_async_type, rbuv_async);
 }
 
 static void rbuv_async_mark(rbuv_async_t *rbuv_async) {
@@ -32,7 +52,7 @@ static void rbuv_async_mark(rbuv_async_t *rbuv_async) {
 
   RBUV_DEBUG_LOG_DETAIL("rbuv_async: %p, uv_handle: %p", rbuv_async, rbuv_async->uv_handle);
   rbuv_handle_mark((rbuv_handle_t *)rbuv_async);
-  rb_gc_mark(rbuv_async->cb_on_async);
+  rb_gc_mark_movable(rbuv_async->cb_on_async);
 }
 
 static void rbuv_async_free(rbuv_async_t *rbuv_async) {
@@ -40,6 +60,15 @@ static void rbuv_async_free(rbuv_async_t *rbuv_async) {
   rbuv_handle_free((rbuv_handle_t *)rbuv_async);
 }
 
+static void rbuv_async_compact(rbuv_async_t *rbuv_async) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_async);
+  RBUV_GC_UPDATE(rbuv_async->cb_on_async);
+}
+
+static size_t rbuv_async_memsize(const rbuv_async_t *rbuv_async) {
+  return sizeof(*rbuv_async);
+}
+
 /*
  * @overload initialize(loop = nil)
  *   Creates a new async handle.
@@ -65,13 +94,13 @@ static VALUE rbuv_async_intialize(int argc, VALUE *argv, VALUE self) {
 
   rb_need_block(); // Raise error if block is not given
 
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  Data_Get_Struct(self, rbuv_async_t, rbuv_async);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_async_t, &rbuv_async_type, rbuv_async);
   rbuv_async->cb_on_async = rb_block_proc();
-  rbuv_async->uv_handle = malloc(sizeof(*rbuv_async->uv_handle));
-  rbuv_async->uv_handle->data = (void *)self;
-  uv_async_init(rbuv_loop->uv_handle, rbuv_async->uv_handle,
+  uv_async_init(rbuv_loop->uv_handle, &rbuv_async->uv_async,
                 rbuv_async_on_async);
+  rbuv_async->uv_handle = &rbuv_async->uv_async;
+  rbuv_async->uv_handle->data = (void *)self;
   return self;
 }
 
@@ -98,21 +127,30 @@ static VALUE rbuv_async_send(VALUE self) {
 }
 
 static void rbuv_async_on_async(uv_async_t *uv_async) {
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_async_on_async_no_gvl, uv_async);
+  rbuv_async_on_async_arg_t arg = { .uv_async = uv_async };
+  rbuv_loop_defer(uv_async->loop, (VALUE)uv_async->data,
+                  (rbuv_loop_deferred_cb)rbuv_async_on_async_no_gvl, &arg, sizeof(arg));
 }
 
-static void rbuv_async_on_async_no_gvl(uv_async_t *uv_async) {
+static void rbuv_async_on_async_no_gvl(rbuv_async_on_async_arg_t *arg) {
+  uv_async_t *uv_async = arg->uv_async;
   VALUE async;
   VALUE error;
   rbuv_async_t *rbuv_async;
 
+  // a callback earlier in the batch may have closed it
+  if (uv_is_closing((uv_handle_t *)uv_async)) {
+    return;
+  }
   async = (VALUE)uv_async->data;
   Data_Get_Handle_Struct(async, struct rbuv_async_s, rbuv_async);
   error = Qnil;
-  rb_funcall(rbuv_async->cb_on_async, id_call, 2, async, error);
+  rbuv_call(rbuv_async->cb_on_async, 2, async, error);
 }
 
 void Init_rbuv_async() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_async_t, uv_async);
+
   cRbuvAsync = rb_define_class_under(mRbuv, "Async", cRbuvHandle);
   rb_define_alloc_func(cRbuvAsync, rbuv_async_alloc);
 
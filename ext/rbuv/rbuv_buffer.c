@@ -0,0 +1,201 @@
+#include "rbuv_buffer.h"
+
+/*
+ * Every loop keeps a few spare String objects with RBUV_BUFFER_SIZE bytes of
+ * capacity. libuv reads straight into their memory, so when a read is handed
+ * to Ruby the String already owns the data and nothing has to be copied.
+ *
+ * Taking a spare out of the pool does not need the GVL, filling the pool does.
+ * When the pool runs dry we fall back to a plain malloc'd buffer which is
+ * copied into a fresh String and freed.
+ */
+
+void rbuv_buffer_pool_init(rbuv_buffer_pool_t *pool) {
+  int i;
+  for (i = 0; i < RBUV_BUFFER_POOL_SIZE; i++) {
+    pool->spares[i] = Qnil;
+  }
+  pool->count = 0;
+}
+
+/*
+ * Slots above +count+ are marked as well, they may still hold a buffer that
+ * was lent to a stream and has not been handed to Ruby yet.
+ */
+void rbuv_buffer_pool_mark(rbuv_buffer_pool_t *pool) {
+  int i;
+  for (i = 0; i < RBUV_BUFFER_POOL_SIZE; i++) {
+    rb_gc_mark(pool->spares[i]);
+  }
+}
+
+void rbuv_buffer_pool_fill(rbuv_buffer_pool_t *pool) {
+  while (pool->count < RBUV_BUFFER_POOL_SIZE) {
+    pool->spares[pool->count] = rb_str_buf_new(RBUV_BUFFER_SIZE);
+    pool->count++;
+  }
+}
+
+/*
+ * Lends a buffer, it can be called without the GVL.
+ * Returns the String owning +buf+ or +Qnil+ if +buf+ was malloc'd.
+ */
+VALUE rbuv_buffer_pool_get(rbuv_buffer_pool_t *pool, uv_buf_t *buf) {
+  VALUE buffer;
+  if (pool->count > 0) {
+    pool->count--;
+    buffer = pool->spares[pool->count];
+    *buf = uv_buf_init(RSTRING_PTR(buffer), RBUV_BUFFER_SIZE);
+  } else {
+    buffer = Qnil;
+    *buf = uv_buf_init(malloc(RBUV_BUFFER_SIZE), RBUV_BUFFER_SIZE);
+  }
+  return buffer;
+}
+
+/*
+ * Gives back a lent buffer that was not used, it can be called without the
+ * GVL.
+ */
+void rbuv_buffer_pool_put(rbuv_buffer_pool_t *pool, VALUE buffer, const uv_buf_t *buf) {
+  if (buffer == Qnil) {
+    free(buf->base);
+  } else if (pool->count < RBUV_BUFFER_POOL_SIZE) {
+    pool->spares[pool->count] = buffer;
+    pool->count++;
+  }
+}
+
+/*
+ * Turns the first +len+ bytes of a lent buffer into a String.
+ *
+ * Large reads hand the pooled String itself to Ruby. Small ones are cheaper to
+ * copy than to replace a 64k buffer, so they are copied and the buffer is put
+ * back into the pool.
+ */
+VALUE rbuv_buffer_pool_take(rbuv_buffer_pool_t *pool, VALUE buffer, const uv_buf_t *buf, size_t len) {
+  VALUE str;
+  if (buffer == Qnil) {
+    str = rb_str_new(buf->base, len);
+    free(buf->base);
+  } else if (len <= RBUV_BUFFER_COPY_LIMIT) {
+    str = rb_str_new(buf->base, len);
+    rbuv_buffer_pool_put(pool, buffer, buf);
+  } else {
+    str = buffer;
+    rb_str_set_len(str, len);
+    rb_str_resize(str, len);
+    rbuv_buffer_pool_fill(pool);
+  }
+  return str;
+}
+
+int rbuv_buffer_is_io_buffer(VALUE value) {
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_WRITING
+  return RTEST(rb_obj_is_kind_of(value, rb_cIOBuffer));
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Gets the memory of a String or an IO::Buffer, it must have been checked
+ * before.
+ */
+void rbuv_buffer_get_bytes(VALUE value, const char **base, size_t *len) {
+  if (TYPE(value) == T_STRING) {
+    *base = RSTRING_PTR(value);
+    *len = RSTRING_LEN(value);
+  } else {
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_WRITING
+    const void *ptr;
+    rb_io_buffer_get_bytes_for_reading(value, &ptr, len);
+    *base = ptr;
+#else
+    rb_bug("rbuv_buffer_get_bytes: not a String");
+#endif
+  }
+}
+
+/*
+ * A stream can read into a buffer given by the caller instead of the pool.
+ * The buffer is locked while the stream uses it, so Ruby code can look at it
+ * but cannot resize it or free its memory under libuv.
+ */
+rbuv_read_into_t *rbuv_read_into_new(VALUE buffer) {
+  rbuv_read_into_t *read_into;
+  char *base;
+  size_t capa;
+
+  if (TYPE(buffer) == T_STRING) {
+    rb_str_modify(buffer);
+    capa = rb_str_capacity(buffer);
+    if (capa == 0) {
+      rb_raise(rb_eArgError, "the buffer has no capacity");
+    }
+    rb_str_locktmp(buffer);
+    base = RSTRING_PTR(buffer);
+  } else if (rbuv_buffer_is_io_buffer(buffer)) {
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_WRITING
+    void *ptr;
+    rb_io_buffer_get_bytes_for_writing(buffer, &ptr, &capa);
+    if (capa == 0) {
+      rb_raise(rb_eArgError, "the buffer has no capacity");
+    }
+    rb_io_buffer_lock(buffer);
+    base = ptr;
+#endif
+  } else {
+    rb_raise(rb_eTypeError, "not valid value, should be a String or an IO::Buffer");
+    return NULL;
+  }
+
+  read_into = malloc(sizeof(*read_into));
+  read_into->buffer = buffer;
+  read_into->base = base;
+  read_into->capa = capa;
+  read_into->len = 0;
+  read_into->queued = 0;
+  read_into->paused = 0;
+  return read_into;
+}
+
+/*
+ * Makes a String buffer as long as the data read into it.
+ */
+void rbuv_read_into_set_len(rbuv_read_into_t *read_into, size_t len) {
+  if (TYPE(read_into->buffer) == T_STRING) {
+    rb_str_unlocktmp(read_into->buffer);
+    rb_str_set_len(read_into->buffer, len);
+    rb_str_locktmp(read_into->buffer);
+  }
+}
+
+/*
+ * Gets a String buffer ready for the next reads once the data was yielded.
+ * Ruby code may have shared its memory with String#dup, writing into it would
+ * change the copy as well, so it gets its own memory again.
+ */
+void rbuv_read_into_reset(rbuv_read_into_t *read_into) {
+  VALUE buffer = read_into->buffer;
+  if (TYPE(buffer) == T_STRING) {
+    rb_str_unlocktmp(buffer);
+    rb_str_modify_expand(buffer, read_into->capa - RSTRING_LEN(buffer));
+    read_into->base = RSTRING_PTR(buffer);
+    rb_str_locktmp(buffer);
+  }
+}
+
+/*
+ * Unlocks the buffer and frees +read_into+, it needs the GVL.
+ */
+void rbuv_read_into_release(rbuv_read_into_t *read_into) {
+  if (TYPE(read_into->buffer) == T_STRING) {
+    rb_str_unlocktmp(read_into->buffer);
+  } else {
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_WRITING
+    rb_io_buffer_unlock(read_into->buffer);
+#endif
+  }
+  free(read_into);
+}
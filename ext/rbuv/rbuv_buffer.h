@@ -0,0 +1,49 @@
+#ifndef RBUV_BUFFER_H_
+#define RBUV_BUFFER_H_
+
+#include <ruby.h>
+#include <uv.h>
+#ifdef HAVE_RUBY_IO_BUFFER_H
+# include <ruby/io/buffer.h>
+#endif
+
+/* Capacity of every pooled read buffer */
+#define RBUV_BUFFER_SIZE 65536
+/* Number of spare buffers kept by each loop */
+#define RBUV_BUFFER_POOL_SIZE 8
+/* Reads up to this size are copied and the buffer goes back to the pool */
+#define RBUV_BUFFER_COPY_LIMIT 4096
+
+struct rbuv_buffer_pool_s {
+  VALUE spares[RBUV_BUFFER_POOL_SIZE];
+  int count;
+};
+typedef struct rbuv_buffer_pool_s rbuv_buffer_pool_t;
+
+/* A String or IO::Buffer owned by the caller that a stream reads into */
+struct rbuv_read_into_s {
+  VALUE buffer;
+  char *base;
+  size_t capa;
+  size_t len;  /* bytes read and not yielded yet */
+  int queued;  /* a callback is queued to yield them */
+  int paused;  /* reading stopped because the buffer is full */
+};
+typedef struct rbuv_read_into_s rbuv_read_into_t;
+
+void rbuv_buffer_pool_init(rbuv_buffer_pool_t *pool);
+void rbuv_buffer_pool_mark(rbuv_buffer_pool_t *pool);
+void rbuv_buffer_pool_fill(rbuv_buffer_pool_t *pool);
+VALUE rbuv_buffer_pool_get(rbuv_buffer_pool_t *pool, uv_buf_t *buf);
+void rbuv_buffer_pool_put(rbuv_buffer_pool_t *pool, VALUE buffer, const uv_buf_t *buf);
+VALUE rbuv_buffer_pool_take(rbuv_buffer_pool_t *pool, VALUE buffer, const uv_buf_t *buf, size_t len);
+
+int rbuv_buffer_is_io_buffer(VALUE value);
+void rbuv_buffer_get_bytes(VALUE value, const char **base, size_t *len);
+
+rbuv_read_into_t *rbuv_read_into_new(VALUE buffer);
+void rbuv_read_into_set_len(rbuv_read_into_t *read_into, size_t len);
+void rbuv_read_into_reset(rbuv_read_into_t *read_into);
+void rbuv_read_into_release(rbuv_read_into_t *read_into);
+
+#endif  /* RBUV_BUFFER_H_ */
@@ -3,20 +3,40 @@
 struct rbuv_check_s {
   uv_check_t *uv_handle;
   VALUE cb_on_close;
+  uv_check_t uv_check;
   VALUE cb_on_check;
 };
 typedef struct rbuv_check_s rbuv_check_t;
 
 VALUE cRbuvCheck;
 
+struct rbuv_check_on_check_arg_s {
+  uv_check_t *uv_check;
+};
+typedef struct rbuv_check_on_check_arg_s rbuv_check_on_check_arg_t;
+
 /* Allocator / Mark / Deallocator */
 static VALUE rbuv_check_alloc(VALUE klass);
 static void rbuv_check_mark(rbuv_check_t *rbuv_check);
 static void rbuv_check_free(rbuv_check_t *rbuv_check);
+static void rbuv_check_compact(rbuv_check_t *rbuv_check);
+static size_t rbuv_check_memsize(const rbuv_check_t *rbuv_check);
+
+static const rb_data_type_t rbuv_check_type = {
+  .wrap_struct_name = "rbuv_check",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_check_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_check_free,
+    .dsize = (size_t (*)(const void *))rbuv_check_memsize,
+    RBUV_DCOMPACT(rbuv_check_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_check_on_check(uv_check_t *uv_check);
-static void rbuv_check_on_check_no_gvl(uv_check_t *uv_check);
+static void rbuv_check_on_check_no_gvl(rbuv_check_on_check_arg_t *arg);
 
 VALUE rbuv_check_alloc(VALUE klass) {
   rbuv_check_t *rbuv_check;
@@ -24,14 +44,14 @@ VALUE rbuv_check_alloc(VALUE klass) {
   rbuv_check = malloc(sizeof(*rbuv_check));
   rbuv_handle_alloc((rbuv_handle_t *)rbuv_check);
   rbuv_check->cb_on_check = Qnil;
-  return Data_Wrap_Struct(klass, rbuv_check_mark, rbuv_check_free, rbuv_check);
+  return TypedData_Wrap_Struct(klass, &rbuv_check_type, rbuv_check);
 }
 
 void rbuv_check_mark(rbuv_check_t *rbuv_check) {
   assert(rbuv_check);
   RBUV_DEBUG_LOG_DETAIL("rbuv_check: %p, uv_handle: %p", rbuv_check, rbuv_check->uv_handle);
   rbuv_handle_mark((rbuv_handle_t *)rbuv_check);
-  rb_gc_mark(rbuv_check->cb_on_check);
+  rb_gc_mark_movable(rbuv_check->cb_on_check);
 }
 
 void rbuv_check_free(rbuv_check_t *rbuv_check) {
@@ -39,6 +59,15 @@ void rbuv_check_free(rbuv_check_t *rbuv_check) {
   rbuv_handle_free((rbuv_handle_t *)rbuv_check);
 }
 
+static void rbuv_check_compact(rbuv_check_t *rbuv_check) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_check);
+  RBUV_GC_UPDATE(rbuv_check->cb_on_check);
+}
+
+static size_t rbuv_check_memsize(const rbuv_check_t *rbuv_check) {
+  return sizeof(*rbuv_check);
+}
+
 /*
  * @overload initialize(loop=nil)
  *   Creates a new check handle.
@@ -58,17 +87,14 @@ VALUE rbuv_check_initialize(int argc, VALUE *argv, VALUE self) {
     loop = rbuv_loop_s_default(cRbuvLoop);
   }
 
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  Data_Get_Struct(self, rbuv_check_t, rbuv_check);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_check_t, &rbuv_check_type, rbuv_check);
 
-  rbuv_check->uv_handle = malloc(sizeof(*rbuv_check->uv_handle));
-  uv_ret = uv_check_init(rbuv_loop->uv_handle, rbuv_check->uv_handle);
+  uv_ret = uv_check_init(rbuv_loop->uv_handle, &rbuv_check->uv_check);
   if (uv_ret < 0) {
-    rbuv_check->uv_handle->data = NULL;
-    free(rbuv_check->uv_handle);
-    rbuv_check->uv_handle = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   } else {
+    rbuv_check->uv_handle = &rbuv_check->uv_check;
     rbuv_check->uv_handle->data = (void *)self;
     return self;
   }
@@ -115,21 +141,30 @@ static VALUE rbuv_check_stop(VALUE self) {
 }
 
 void rbuv_check_on_check(uv_check_t *uv_check) {
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_check_on_check_no_gvl, uv_check);
+  rbuv_check_on_check_arg_t arg = { .uv_check = uv_check };
+  rbuv_loop_defer(uv_check->loop, (VALUE)uv_check->data,
+                  (rbuv_loop_deferred_cb)rbuv_check_on_check_no_gvl, &arg, sizeof(arg));
 }
 
-void rbuv_check_on_check_no_gvl(uv_check_t *uv_check) {
+void rbuv_check_on_check_no_gvl(rbuv_check_on_check_arg_t *arg) {
+  uv_check_t *uv_check = arg->uv_check;
   VALUE check;
   VALUE error;
   rbuv_check_t *rbuv_check;
 
+  // a callback earlier in the batch may have stopped or closed it
+  if (!uv_is_active((uv_handle_t *)uv_check)) {
+    return;
+  }
   check = (VALUE)uv_check->data;
   Data_Get_Handle_Struct(check, struct rbuv_check_s, rbuv_check);
   error = Qnil;
-  rb_funcall(rbuv_check->cb_on_check, id_call, 2, check, error);
+  rbuv_call(rbuv_check->cb_on_check, 2, check, error);
 }
 
 void Init_rbuv_check() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_check_t, uv_check);
+
   cRbuvCheck = rb_define_class_under(mRbuv, "Check", cRbuvHandle);
   rb_define_alloc_func(cRbuvCheck, rbuv_check_alloc);
 
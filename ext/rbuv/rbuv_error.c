@@ -1,7 +1,184 @@
 #include "rbuv_error.h"
 
+/*
+ * Document-class: Rbuv::Error
+ *
+ * The errors reported by libuv are instances of a subclass named after the
+ * libuv error, like +Rbuv::Error::ECONNRESET+ or +Rbuv::Error::EPIPE+. Their
+ * +Errno+ constant is the libuv error code.
+ */
+
 VALUE eRbuvError;
 
+enum rbuv_error_index_e {
+#define XX(code, _) RBUV_ERROR_ ## code,
+  UV_ERRNO_MAP(XX)
+#undef XX
+  RBUV_ERROR_COUNT
+};
+
+enum rbuv_error_mode_e {
+  RBUV_ERROR_MODE_NEW = 0,
+  RBUV_ERROR_MODE_FROZEN,
+  RBUV_ERROR_MODE_SYMBOL
+};
+
+static int rbuv_error_mode = RBUV_ERROR_MODE_NEW;
+static ID id_new;
+static ID id_frozen;
+static ID id_symbol;
+
+static VALUE rbuv_error_classes[RBUV_ERROR_COUNT];
+static VALUE rbuv_error_symbols[RBUV_ERROR_COUNT];
+/* The frozen instances, built on first use */
+static VALUE rbuv_error_frozen[RBUV_ERROR_COUNT];
+static VALUE rbuv_error_frozen_eof = Qnil;
+
+static int rbuv_error_index(int uv_err) {
+  switch (uv_err) {
+#define XX(code, _) case UV_ ## code: return RBUV_ERROR_ ## code;
+  UV_ERRNO_MAP(XX)
+#undef XX
+  default: return -1;
+  }
+}
+
+static VALUE rbuv_error_new_frozen(VALUE klass, const char *message) {
+  VALUE error = rb_exc_new2(klass, message);
+  rb_obj_freeze(error);
+  return error;
+}
+
+/*
+ * The Rbuv::Error subclass of +uv_err+, Rbuv::Error itself when it is not a
+ * libuv error.
+ */
+VALUE rbuv_error_class(int uv_err) {
+  int i = rbuv_error_index(uv_err);
+  return i < 0 ? eRbuvError : rbuv_error_classes[i];
+}
+
+/*
+ * The error yielded to a callback for +uv_err+. Depending on Rbuv.error_mode
+ * it is a new exception, a frozen one shared by every callback or a Symbol,
+ * the last two do not allocate.
+ */
+VALUE rbuv_error_new(int uv_err) {
+  int i;
+
+  if (rbuv_error_mode == RBUV_ERROR_MODE_NEW) {
+    return rb_exc_new2(rbuv_error_class(uv_err), uv_strerror(uv_err));
+  }
+  i = rbuv_error_index(uv_err);
+  if (i < 0) {
+    i = RBUV_ERROR_UNKNOWN;
+  }
+  if (rbuv_error_mode == RBUV_ERROR_MODE_SYMBOL) {
+    return rbuv_error_symbols[i];
+  }
+  if (rbuv_error_frozen[i] == Qnil) {
+    rbuv_error_frozen[i] = rbuv_error_new_frozen(rbuv_error_classes[i],
+                                                 uv_strerror(uv_err));
+  }
+  return rbuv_error_frozen[i];
+}
+
+/*
+ * The error yielded to a read callback at EOF, an EOFError unless
+ * Rbuv.error_mode is +:symbol+.
+ */
+VALUE rbuv_error_eof() {
+  switch (rbuv_error_mode) {
+  case RBUV_ERROR_MODE_SYMBOL:
+    return rbuv_error_symbols[RBUV_ERROR_EOF];
+  case RBUV_ERROR_MODE_FROZEN:
+    if (rbuv_error_frozen_eof == Qnil) {
+      rbuv_error_frozen_eof = rbuv_error_new_frozen(rb_eEOFError, "end of file reached");
+    }
+    return rbuv_error_frozen_eof;
+  default:
+    return rb_exc_new2(rb_eEOFError, "end of file reached");
+  }
+}
+
+/*
+ * Raises a new instance of the Rbuv::Error subclass of +uv_err+, whatever
+ * Rbuv.error_mode is.
+ */
+void rbuv_error_raise(int uv_err) {
+  rb_exc_raise(rb_exc_new2(rbuv_error_class(uv_err), uv_strerror(uv_err)));
+}
+
+/*
+ * How errors are given to the callbacks.
+ *
+ * @see error_mode=
+ * @return [Symbol] +:new+, +:frozen+ or +:symbol+
+ */
+static VALUE rbuv_error_s_get_mode(VALUE self) {
+  switch (rbuv_error_mode) {
+  case RBUV_ERROR_MODE_FROZEN:
+    return ID2SYM(id_frozen);
+  case RBUV_ERROR_MODE_SYMBOL:
+    return ID2SYM(id_symbol);
+  default:
+    return ID2SYM(id_new);
+  }
+}
+
+/*
+ * @overload error_mode=(mode)
+ *   Sets how errors are given to the callbacks. Creating an exception for
+ *   every failed write or reset connection makes garbage, the other modes do
+ *   not allocate. Errors raised by methods are always new exceptions.
+ *
+ *   @param mode [Symbol]
+ *     - +:new+ (the default), a new exception for every error.
+ *     - +:frozen+, a frozen exception of the same class, shared by every
+ *       callback. It cannot be raised as is, use +raise error.dup+.
+ *     - +:symbol+, the name of the libuv error, like +:ECONNRESET+, or
+ *       +:EOF+ at the end of a stream.
+ */
+static VALUE rbuv_error_s_set_mode(VALUE self, VALUE mode) {
+  ID id = SYMBOL_P(mode) ? SYM2ID(mode) : 0;
+
+  if (id == id_new) {
+    rbuv_error_mode = RBUV_ERROR_MODE_NEW;
+  } else if (id == id_frozen) {
+    rbuv_error_mode = RBUV_ERROR_MODE_FROZEN;
+  } else if (id == id_symbol) {
+    rbuv_error_mode = RBUV_ERROR_MODE_SYMBOL;
+  } else {
+    rb_raise(rb_eArgError, "unknown error mode, should be :new, :frozen or :symbol");
+  }
+  return mode;
+}
+
 void Init_rbuv_error() {
+  int i;
+
   eRbuvError = rb_define_class_under(mRbuv, "Error", rb_eStandardError);
+
+  i = 0;
+#define XX(code, _) \
+  rbuv_error_classes[i] = rb_define_class_under(eRbuvError, #code, eRbuvError); \
+  rb_define_const(rbuv_error_classes[i], "Errno", INT2FIX(UV_ ## code)); \
+  rbuv_error_symbols[i] = ID2SYM(rb_intern(#code)); \
+  i++;
+  UV_ERRNO_MAP(XX)
+#undef XX
+
+  for (i = 0; i < RBUV_ERROR_COUNT; i++) {
+    rbuv_error_frozen[i] = Qnil;
+    rb_global_variable(&rbuv_error_classes[i]);
+    rb_global_variable(&rbuv_error_frozen[i]);
+  }
+  rb_global_variable(&rbuv_error_frozen_eof);
+
+  id_new = rb_intern("new");
+  id_frozen = rb_intern("frozen");
+  id_symbol = rb_intern("symbol");
+
+  rb_define_singleton_method(mRbuv, "error_mode", rbuv_error_s_get_mode, 0);
+  rb_define_singleton_method(mRbuv, "error_mode=", rbuv_error_s_set_mode, 1);
 }
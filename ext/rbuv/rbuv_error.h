@@ -7,4 +7,9 @@ extern VALUE eRbuvError;
 
 void Init_rbuv_error();
 
+VALUE rbuv_error_class(int uv_err);
+VALUE rbuv_error_new(int uv_err);
+VALUE rbuv_error_eof();
+NORETURN(void rbuv_error_raise(int uv_err));
+
 #endif  /* RBUV_ERROR_H_ */
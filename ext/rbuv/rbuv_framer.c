@@ -0,0 +1,208 @@
+#include "rbuv_framer.h"
+
+/*
+ * Streams reading with Rbuv::Stream#read_frames read straight into the buffer
+ * of a framer. Everything read until the Ruby callback runs is split at once,
+ * so only whole frames are turned into Strings and a burst of small messages
+ * is yielded as a single Array.
+ */
+
+static const char *rbuv_framer_find(const char *buf, size_t len,
+                                    const char *delimiter, size_t delimiter_len);
+static size_t rbuv_framer_read_prefix(rbuv_framer_t *framer, const char *buf);
+
+rbuv_framer_t *rbuv_framer_new(VALUE options) {
+  rbuv_framer_t *framer;
+  VALUE delimiter;
+  VALUE length_prefix;
+  VALUE endian;
+  VALUE max_frame_size;
+  int prefix_len;
+
+  delimiter = rb_hash_aref(options, ID2SYM(rb_intern("delimiter")));
+  length_prefix = rb_hash_aref(options, ID2SYM(rb_intern("length_prefix")));
+  endian = rb_hash_aref(options, ID2SYM(rb_intern("endian")));
+  max_frame_size = rb_hash_aref(options, ID2SYM(rb_intern("max_frame_size")));
+
+  if (NIL_P(delimiter) == NIL_P(length_prefix)) {
+    rb_raise(rb_eArgError, "either delimiter or length_prefix must be given");
+  }
+  if (!NIL_P(delimiter)) {
+    StringValue(delimiter);
+    if (RSTRING_LEN(delimiter) == 0) {
+      rb_raise(rb_eArgError, "the delimiter is empty");
+    }
+    prefix_len = 0;
+  } else {
+    prefix_len = NUM2INT(length_prefix);
+    if (prefix_len != 1 && prefix_len != 2 && prefix_len != 4) {
+      rb_raise(rb_eArgError, "length_prefix should be 1, 2 or 4");
+    }
+  }
+  if (!NIL_P(endian) &&
+      endian != ID2SYM(rb_intern("big")) && endian != ID2SYM(rb_intern("little"))) {
+    rb_raise(rb_eArgError, "endian should be :big or :little");
+  }
+  if (!NIL_P(max_frame_size) && NUM2SIZET(max_frame_size) == 0) {
+    rb_raise(rb_eArgError, "max_frame_size should be positive");
+  }
+
+  framer = malloc(sizeof(*framer));
+  if (!NIL_P(delimiter)) {
+    framer->type = RBUV_FRAMER_DELIMITER;
+    framer->delimiter_len = RSTRING_LEN(delimiter);
+    framer->delimiter = malloc(framer->delimiter_len);
+    memcpy(framer->delimiter, RSTRING_PTR(delimiter), framer->delimiter_len);
+  } else {
+    framer->type = RBUV_FRAMER_LENGTH_PREFIX;
+    framer->delimiter = NULL;
+    framer->delimiter_len = 0;
+  }
+  framer->prefix_len = prefix_len;
+  framer->big_endian = endian != ID2SYM(rb_intern("little"));
+  framer->max_frame_size = NIL_P(max_frame_size) ? RBUV_FRAMER_MAX_FRAME_SIZE : NUM2SIZET(max_frame_size);
+  framer->buf = NULL;
+  framer->len = 0;
+  framer->capa = 0;
+  framer->scanned = 0;
+  framer->queued = 0;
+  return framer;
+}
+
+void rbuv_framer_free(rbuv_framer_t *framer) {
+  if (framer != NULL) {
+    free(framer->delimiter);
+    free(framer->buf);
+    free(framer);
+  }
+}
+
+size_t rbuv_framer_memsize(const rbuv_framer_t *framer) {
+  if (framer == NULL) {
+    return 0;
+  }
+  return sizeof(*framer) + framer->delimiter_len + framer->capa;
+}
+
+/*
+ * Gives the room for the next read after the buffered data, it can be called
+ * without the GVL.
+ */
+void rbuv_framer_alloc(rbuv_framer_t *framer, uv_buf_t *buf) {
+  if (framer->capa - framer->len < RBUV_FRAMER_READ_SIZE) {
+    framer->capa = framer->capa * 2 > framer->len + RBUV_FRAMER_READ_SIZE ?
+                   framer->capa * 2 : framer->len + RBUV_FRAMER_READ_SIZE;
+    framer->buf = realloc(framer->buf, framer->capa);
+  }
+  *buf = uv_buf_init(framer->buf + framer->len,
+                     (unsigned int)(framer->capa - framer->len));
+}
+
+/*
+ * Pushes every whole frame of the buffer to +frames+ and keeps the partial one
+ * at its start. Returns -1 if a frame is larger than max_frame_size.
+ */
+int rbuv_framer_take(rbuv_framer_t *framer, VALUE frames) {
+  const char *found;
+  size_t off;
+  size_t frame_len;
+  size_t frame_off;
+  int ret;
+
+  off = 0;
+  ret = 0;
+  for (;;) {
+    if (framer->type == RBUV_FRAMER_DELIMITER) {
+      found = rbuv_framer_find(framer->buf + framer->scanned,
+                               framer->len - framer->scanned,
+                               framer->delimiter, framer->delimiter_len);
+      if (found == NULL) {
+        // a delimiter may start in the last bytes and end in the next read
+        if (framer->len - off >= framer->delimiter_len) {
+          framer->scanned = framer->len - framer->delimiter_len + 1;
+        }
+        if (framer->len - off > framer->max_frame_size) {
+          ret = -1;
+        }
+        break;
+      }
+      frame_off = off;
+      frame_len = found - (framer->buf + off);
+      if (frame_len > framer->max_frame_size) {
+        ret = -1;
+        break;
+      }
+      off = frame_off + frame_len + framer->delimiter_len;
+      framer->scanned = off;
+    } else {
+      if (framer->len - off < (size_t)framer->prefix_len) {
+        break;
+      }
+      frame_len = rbuv_framer_read_prefix(framer, framer->buf + off);
+      if (frame_len > framer->max_frame_size) {
+        ret = -1;
+        break;
+      }
+      if (framer->len - off - framer->prefix_len < frame_len) {
+        break;
+      }
+      frame_off = off + framer->prefix_len;
+      off = frame_off + frame_len;
+    }
+    rb_ary_push(frames, rb_str_new(framer->buf + frame_off, frame_len));
+  }
+
+  if (off > 0) {
+    memmove(framer->buf, framer->buf + off, framer->len - off);
+    framer->len -= off;
+    framer->scanned = framer->scanned > off ? framer->scanned - off : 0;
+  }
+  return ret;
+}
+
+/*
+ * Returns the data after the last delimiter, or +nil+ if there is none.
+ */
+VALUE rbuv_framer_rest(rbuv_framer_t *framer) {
+  VALUE rest;
+  if (framer->type != RBUV_FRAMER_DELIMITER || framer->len == 0) {
+    return Qnil;
+  }
+  rest = rb_str_new(framer->buf, framer->len);
+  framer->len = 0;
+  framer->scanned = 0;
+  return rest;
+}
+
+const char *rbuv_framer_find(const char *buf, size_t len,
+                             const char *delimiter, size_t delimiter_len) {
+  const char *end = buf + len;
+  const char *p = buf;
+
+  while (end - p >= (ptrdiff_t)delimiter_len) {
+    p = memchr(p, delimiter[0], end - p - delimiter_len + 1);
+    if (p == NULL) {
+      return NULL;
+    }
+    if (memcmp(p, delimiter, delimiter_len) == 0) {
+      return p;
+    }
+    p++;
+  }
+  return NULL;
+}
+
+size_t rbuv_framer_read_prefix(rbuv_framer_t *framer, const char *buf) {
+  const unsigned char *p = (const unsigned char *)buf;
+  size_t len = 0;
+  int i;
+
+  for (i = 0; i < framer->prefix_len; i++) {
+    if (framer->big_endian) {
+      len = (len << 8) | p[i];
+    } else {
+      len |= (size_t)p[i] << (8 * i);
+    }
+  }
+  return len;
+}
@@ -0,0 +1,40 @@
+#ifndef RBUV_FRAMER_H_
+#define RBUV_FRAMER_H_
+
+#include <ruby.h>
+#include <uv.h>
+
+/* Room given to every read */
+#define RBUV_FRAMER_READ_SIZE 65536
+/* Default limit of a single frame */
+#define RBUV_FRAMER_MAX_FRAME_SIZE (1024 * 1024)
+
+enum rbuv_framer_type_e {
+  RBUV_FRAMER_DELIMITER = 0,
+  RBUV_FRAMER_LENGTH_PREFIX
+};
+
+/* Splits the data read by a stream into frames */
+struct rbuv_framer_s {
+  int type;
+  char *delimiter;
+  size_t delimiter_len;
+  int prefix_len;
+  int big_endian;
+  size_t max_frame_size;
+  char *buf;
+  size_t len;
+  size_t capa;
+  size_t scanned; /* no delimiter starts before this offset */
+  int queued;     /* a callback is queued to yield the frames */
+};
+typedef struct rbuv_framer_s rbuv_framer_t;
+
+rbuv_framer_t *rbuv_framer_new(VALUE options);
+void rbuv_framer_free(rbuv_framer_t *framer);
+size_t rbuv_framer_memsize(const rbuv_framer_t *framer);
+void rbuv_framer_alloc(rbuv_framer_t *framer, uv_buf_t *buf);
+int rbuv_framer_take(rbuv_framer_t *framer, VALUE frames);
+VALUE rbuv_framer_rest(rbuv_framer_t *framer);
+
+#endif  /* RBUV_FRAMER_H_ */
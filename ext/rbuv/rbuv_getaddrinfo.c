@@ -10,10 +10,22 @@ VALUE cRbuvGetaddrinfoRequest;
 static void rbuv_getaddrinfo_on_getaddrinfo(uv_getaddrinfo_t* req, int status, struct addrinfo* res);
 static void rbuv_getaddrinfo_on_getaddrinfo_no_gvl(rbuv_getaddrinfo_on_getaddrinfo_arg_t* arg);
 
+static const rb_data_type_t rbuv_getaddrinfo_type = {
+  .wrap_struct_name = "rbuv_getaddrinfo",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_getaddrinfo_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_getaddrinfo_free,
+    .dsize = (size_t (*)(const void *))rbuv_getaddrinfo_memsize,
+    RBUV_DCOMPACT(rbuv_getaddrinfo_compact)
+  },
+  .parent = &rbuv_request_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
 
 void rbuv_getaddrinfo_mark(rbuv_getaddrinfo_t* rbuv_getaddrinfo) {
   rbuv_request_mark((rbuv_request_t *)rbuv_getaddrinfo);
-  rb_gc_mark(rbuv_getaddrinfo->cb_on_getaddrinfo);
+  rb_gc_mark_movable(rbuv_getaddrinfo->cb_on_getaddrinfo);
   if (rbuv_getaddrinfo->uv_req != NULL) {
     rb_gc_mark((VALUE)rbuv_getaddrinfo->uv_req->loop->data);
   }
@@ -23,13 +35,25 @@ void rbuv_getaddrinfo_free(rbuv_getaddrinfo_t* rbuv_getaddrinfo) {
   rbuv_request_free((rbuv_request_t *)rbuv_getaddrinfo);
 }
 
+void rbuv_getaddrinfo_compact(rbuv_getaddrinfo_t* rbuv_getaddrinfo) {
+  RBUV_GC_UPDATE(rbuv_getaddrinfo->cb_on_getaddrinfo);
+}
+
+size_t rbuv_getaddrinfo_memsize(const rbuv_getaddrinfo_t* rbuv_getaddrinfo) {
+  size_t size = sizeof(*rbuv_getaddrinfo);
+  if (rbuv_getaddrinfo->uv_req != NULL) {
+    size += sizeof(*rbuv_getaddrinfo->uv_req);
+  }
+  return size;
+}
+
 VALUE rbuv_getaddrinfo_alloc(VALUE klass) {
   rbuv_getaddrinfo_t* rbuv_getaddrinfo;
   rbuv_getaddrinfo = malloc(sizeof(rbuv_getaddrinfo_t));
   rbuv_getaddrinfo->uv_req = NULL;
   rbuv_getaddrinfo->cb_on_getaddrinfo = Qnil;
-  return Data_Wrap_Struct(klass, rbuv_getaddrinfo_mark, rbuv_getaddrinfo_free,
-                          rbuv_getaddrinfo);
+  rbuv_request_link_init(&rbuv_getaddrinfo->link);
+  return TypedData_Wrap_Struct(klass, &rbuv_getaddrinfo_type, rbuv_getaddrinfo);
 }
 
 static VALUE rbuv_getaddrinfo_initialize(int argc, VALUE *argv, VALUE self) {
@@ -46,8 +70,8 @@ static VALUE rbuv_getaddrinfo_initialize(int argc, VALUE *argv, VALUE self) {
   }
   node = nodename == Qnil ? NULL : StringValueCStr(nodename);
   service = srvname == Qnil ? NULL : StringValueCStr(srvname);
-  Data_Get_Struct(self, rbuv_getaddrinfo_t, rbuv_getaddrinfo);
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_getaddrinfo_t, &rbuv_getaddrinfo_type, rbuv_getaddrinfo);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
 
 
   rbuv_getaddrinfo->uv_req = malloc(sizeof(*rbuv_getaddrinfo->uv_req));
@@ -55,18 +79,18 @@ static VALUE rbuv_getaddrinfo_initialize(int argc, VALUE *argv, VALUE self) {
   if (uv_ret < 0) {
     free(rbuv_getaddrinfo->uv_req);
     rbuv_getaddrinfo->uv_req = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   } else {
     rbuv_getaddrinfo->uv_req->data = (void *)self;
     rbuv_getaddrinfo->cb_on_getaddrinfo = rb_block_proc();
-    rbuv_loop_register_request(loop, self);
+    rbuv_loop_register_request(loop, &rbuv_getaddrinfo->link, self);
   }
   return self;
 }
 
 static VALUE rbuv_getaddrinfo_get_loop(VALUE self) {
   rbuv_getaddrinfo_t *rbuv_getaddrinfo;
-  Data_Get_Struct(self, rbuv_getaddrinfo_t, rbuv_getaddrinfo);
+  TypedData_Get_Struct(self, rbuv_getaddrinfo_t, &rbuv_getaddrinfo_type, rbuv_getaddrinfo);
   if (rbuv_getaddrinfo->uv_req == NULL) {
     return Qnil;
   } else {
@@ -79,13 +103,15 @@ static void rbuv_getaddrinfo_on_getaddrinfo(uv_getaddrinfo_t* uv_req, int status
     .status = status,
     .res = res
   };
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_getaddrinfo_on_getaddrinfo_no_gvl, &arg);
+  rbuv_loop_defer(uv_req->loop, (VALUE)uv_req->data,
+                  (rbuv_loop_deferred_cb)rbuv_getaddrinfo_on_getaddrinfo_no_gvl,
+                  &arg, sizeof(arg));
 }
 
 static VALUE rbuv_getaddrinfo_on_getaddrinfo_no_gvl2(VALUE args) {
   rbuv_getaddrinfo_on_getaddrinfo_arg_t* arg = (rbuv_getaddrinfo_on_getaddrinfo_arg_t*)args;
   if (arg->status < 0) {
-    rb_raise(eRbuvError, "%s", uv_strerror(arg->status));
+    rbuv_error_raise(arg->status);
     return Qnil;
   } else {
     struct addrinfo *ptr;
@@ -120,13 +146,13 @@ static void rbuv_getaddrinfo_on_getaddrinfo_no_gvl(rbuv_getaddrinfo_on_getaddrin
   rbuv_getaddrinfo_t *rbuv_getaddrinfo;
   VALUE request = (VALUE)arg->uv_req->data;
 
-  Data_Get_Struct(request, rbuv_getaddrinfo_t, rbuv_getaddrinfo);
+  TypedData_Get_Struct(request, rbuv_getaddrinfo_t, &rbuv_getaddrinfo_type, rbuv_getaddrinfo);
 
   cb_on_getaddrinfo = rbuv_getaddrinfo->cb_on_getaddrinfo;
   rbuv_getaddrinfo->cb_on_getaddrinfo = Qnil;
   rbuv_run_callback(cb_on_getaddrinfo, rbuv_getaddrinfo_on_getaddrinfo_no_gvl2, (VALUE)arg);
   uv_freeaddrinfo(arg->res);
-  rbuv_loop_unregister_request((VALUE)arg->uv_req->loop->data, request);
+  rbuv_loop_unregister_request((VALUE)arg->uv_req->loop->data, &rbuv_getaddrinfo->link);
   free(rbuv_getaddrinfo->uv_req);
   rbuv_getaddrinfo->uv_req = NULL;
 }
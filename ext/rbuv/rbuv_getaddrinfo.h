@@ -6,12 +6,15 @@
 typedef struct {
   uv_getaddrinfo_t *uv_req;
   VALUE cb_on_getaddrinfo;
+  rbuv_request_link_t link; /* in the requests of the loop */
 } rbuv_getaddrinfo_t;
 
 extern VALUE cRbuvGetaddrinfoRequest;
 
 void rbuv_getaddrinfo_mark(rbuv_getaddrinfo_t* rbuv_getaddrinfo);
 void rbuv_getaddrinfo_free(rbuv_getaddrinfo_t* rbuv_getaddrinfo);
+void rbuv_getaddrinfo_compact(rbuv_getaddrinfo_t* rbuv_getaddrinfo);
+size_t rbuv_getaddrinfo_memsize(const rbuv_getaddrinfo_t* rbuv_getaddrinfo);
 void Init_rbuv_getaddrinfo();
 
 #endif  /* RBUV_GETADDRINFO_H_ */
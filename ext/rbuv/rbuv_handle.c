@@ -16,8 +16,13 @@ typedef struct rbuv_handle_on_close_arg_s rbuv_handle_on_close_arg_t;
 
 VALUE cRbuvHandle;
 
+/* The parent of the types of all the handles */
+const rb_data_type_t rbuv_handle_type = {
+  .wrap_struct_name = "rbuv_handle",
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
 /* Private methods */
-static void rbuv_handle_on_close(uv_handle_t *uv_handle);
 static void rbuv_handle_on_close_no_gvl(rbuv_handle_on_close_arg_t *arg);
 
 /*
@@ -34,9 +39,8 @@ void rbuv_handle_unregister_loop(rbuv_handle_t *rbuv_handle) {
     } else {
       rb_warn("The GC freed Rbuv::Loop before the Rbuv::Handle#close is called. Consider using Rbuv::Loop#dispose\n");
       uv_close(rbuv_handle->uv_handle, NULL);
-      rbuv_handle->uv_handle = NULL;
-      free(rbuv_handle->uv_handle);
     }
+    rbuv_handle->uv_handle = NULL;
   }
 }
 
@@ -46,39 +50,40 @@ void rbuv_handle_alloc(rbuv_handle_t *rbuv_handle) {
 }
 
 void rbuv_handle_mark(rbuv_handle_t *rbuv_handle) {
-  rb_gc_mark(rbuv_handle->cb_on_close);
+  rb_gc_mark_movable(rbuv_handle->cb_on_close);
   if (rbuv_handle->uv_handle != NULL) {
     rb_gc_mark((VALUE) rbuv_handle->uv_handle->loop->data);
   }
 }
 
+void rbuv_handle_compact(rbuv_handle_t *rbuv_handle) {
+  RBUV_GC_UPDATE(rbuv_handle->cb_on_close);
+}
+
 /*
  * This is called when the Ruby CG is freeing a Rbuv::Handle
+ *
+ * An open handle is marked by its loop, so it is only freed here when its loop
+ * is being freed by the same GC run. libuv may still use the embedded uv
+ * handle until the loop is closed, so the handle is closed and the struct is
+ * freed by the close callback instead.
  */
 void rbuv_handle_free(rbuv_handle_t *rbuv_handle) {
   RBUV_DEBUG_LOG_DETAIL("rbuv_handle: %p, uv_handle: %p", rbuv_handle, rbuv_handle->uv_handle);
 
   if (rbuv_handle->uv_handle != NULL) {
-    VALUE loop = (VALUE)rbuv_handle->uv_handle->loop->data;
-    if ((TYPE(loop) != T_NONE) && (loop != Qnil)) {
-      if (rbuv_handle->uv_handle != NULL) {
-        if (uv_is_closing(rbuv_handle->uv_handle)) {
-          rb_warn("The GC freed the Rbuv::Handle before #close completed.Consider using Rbuv::Loop#dispose\n");
-        } else {
-          rb_warn("The GC freed the Rbuv::Handle before #close is called.Consider using Rbuv::Loop#dispose\n");
-          uv_close(rbuv_handle->uv_handle, NULL);
-        }
-      }
+    rbuv_handle->uv_handle->data = NULL;
+    if (!uv_is_closing(rbuv_handle->uv_handle)) {
+      uv_close(rbuv_handle->uv_handle, rbuv_handle_on_close);
     }
-
-    free(rbuv_handle->uv_handle);
+    return;
   }
   free(rbuv_handle);
 }
 
 static VALUE rbuv_handle_get_loop(VALUE self) {
   rbuv_handle_t *rbuv_handle;
-  Data_Get_Struct(self, rbuv_handle_t, rbuv_handle);
+  TypedData_Get_Struct(self, rbuv_handle_t, &rbuv_handle_type, rbuv_handle);
   if (rbuv_handle->uv_handle == NULL) {
     return Qnil;
   }
@@ -160,7 +165,7 @@ static VALUE rbuv_handle_close(VALUE self) {
 static VALUE rbuv_handle_is_closed(VALUE self) {
   rbuv_handle_t *rbuv_handle;
 
-  Data_Get_Struct(self, rbuv_handle_t, rbuv_handle);
+  TypedData_Get_Struct(self, rbuv_handle_t, &rbuv_handle_type, rbuv_handle);
 
   return (rbuv_handle->uv_handle == NULL) ? Qtrue : Qfalse;
 }
@@ -191,9 +196,38 @@ static VALUE rbuv_handle_is_closing(VALUE self) {
   return uv_is_closing(rbuv_handle->uv_handle) ? Qtrue : Qfalse;
 }
 
+/*
+ * The platform dependent file descriptor of this handle, it still belongs to
+ * the handle.
+ *
+ * @return [Number] the file descriptor
+ * @raise [Rbuv::Error::EBADF] if the handle has no file descriptor yet, like
+ *   a {Rbuv::Tcp} which is neither bound nor connected
+ * @raise [Rbuv::Error::EINVAL] if this kind of handle has none
+ */
+static VALUE rbuv_handle_fileno(VALUE self) {
+  rbuv_handle_t *rbuv_handle;
+  uv_os_fd_t fd;
+
+  Data_Get_Handle_Struct(self, rbuv_handle_t, rbuv_handle);
+  RBUV_CHECK_UV_RETURN(uv_fileno(rbuv_handle->uv_handle, &fd));
+#ifdef _WIN32
+  return SIZET2NUM((size_t)fd);
+#else
+  return INT2NUM(fd);
+#endif
+}
+
 void rbuv_handle_on_close(uv_handle_t *uv_handle) {
   rbuv_handle_on_close_arg_t arg = { .uv_handle = uv_handle };
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_handle_on_close_no_gvl, &arg);
+  if (uv_handle->data == NULL) {
+    // the Ruby object is gone, see rbuv_handle_free
+    free(RBUV_HANDLE_OF(uv_handle));
+    return;
+  }
+  rbuv_loop_defer(uv_handle->loop, (VALUE)uv_handle->data,
+                  (rbuv_loop_deferred_cb)rbuv_handle_on_close_no_gvl,
+                  &arg, sizeof(arg));
 }
 
 void rbuv_handle_on_close_no_gvl(rbuv_handle_on_close_arg_t *arg) {
@@ -209,7 +243,10 @@ void rbuv_handle_on_close_no_gvl(rbuv_handle_on_close_arg_t *arg) {
                         uv_handle, RSTRING_PTR(rb_inspect(handle)));
 
   Data_Get_Handle_Struct(handle, rbuv_handle_t, rbuv_handle);
-  free(rbuv_handle->uv_handle);
+  if (uv_handle->type == UV_TCP || uv_handle->type == UV_NAMED_PIPE ||
+      uv_handle->type == UV_TTY) {
+    rbuv_stream_closed((rbuv_stream_t *)rbuv_handle);
+  }
   rbuv_handle->uv_handle = NULL;
 
   on_close = rbuv_handle->cb_on_close;
@@ -220,7 +257,7 @@ void rbuv_handle_on_close_no_gvl(rbuv_handle_on_close_arg_t *arg) {
                         RSTRING_PTR(rb_inspect(on_close)));
 
   if (RTEST(on_close)) {
-    rb_funcall(on_close, id_call, 1, handle);
+    rbuv_call(on_close, 1, handle);
   }
 }
 
@@ -237,4 +274,5 @@ void Init_rbuv_handle() {
   rb_define_method(cRbuvHandle, "active?", rbuv_handle_is_active, 0);
   rb_define_method(cRbuvHandle, "closing?", rbuv_handle_is_closing, 0);
   rb_define_method(cRbuvHandle, "closed?", rbuv_handle_is_closed, 0);
+  rb_define_method(cRbuvHandle, "fileno", rbuv_handle_fileno, 0);
 }
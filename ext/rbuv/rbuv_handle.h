@@ -2,6 +2,11 @@
 #define RBUV_HANDLE_H_
 
 #include "rbuv.h"
+
+/*
+ * Every handle struct starts with these fields and embeds its uv handle right
+ * after them, +uv_handle+ points to it until the handle is closed.
+ */
 struct rbuv_handle_s {
   uv_handle_t *uv_handle;
   VALUE cb_on_close;
@@ -9,13 +14,23 @@ struct rbuv_handle_s {
 
 typedef struct rbuv_handle_s rbuv_handle_t;
 
+/* The handle struct embedding +uv_handle+ */
+#define RBUV_HANDLE_OF(uv_handle) \
+  ((void *)((char *)(uv_handle) - sizeof(rbuv_handle_t)))
+/* Checks that +member+, the embedded uv handle, is where RBUV_HANDLE_OF expects */
+#define RBUV_HANDLE_CHECK_LAYOUT(type, member) \
+  assert(RBUV_OFFSETOF(type, member) == sizeof(rbuv_handle_t))
+
 extern VALUE cRbuvHandle;
+extern const rb_data_type_t rbuv_handle_type;
 
 void Init_rbuv_handle();
 
 void rbuv_handle_unregister_loop(rbuv_handle_t *rbuv_handle);
 void rbuv_handle_alloc(rbuv_handle_t *rbuv_handle);
 void rbuv_handle_mark(rbuv_handle_t *rbuv_handle);
+void rbuv_handle_compact(rbuv_handle_t *rbuv_handle);
 void rbuv_handle_free(rbuv_handle_t *rbuv_handle);
+void rbuv_handle_on_close(uv_handle_t *uv_handle);
 
 #endif  /* RBUV_HANDLE_H_ */
@@ -3,20 +3,40 @@
 struct rbuv_idle_s {
   uv_idle_t *uv_handle;
   VALUE cb_on_close;
+  uv_idle_t uv_idle;
   VALUE cb_on_idle;
 };
 typedef struct rbuv_idle_s rbuv_idle_t;
 
 VALUE cRbuvIdle;
 
+struct rbuv_idle_on_idle_arg_s {
+  uv_idle_t *uv_idle;
+};
+typedef struct rbuv_idle_on_idle_arg_s rbuv_idle_on_idle_arg_t;
+
 /* Allocator / Mark / Deallocator */
 static VALUE rbuv_idle_alloc(VALUE klass);
 static void rbuv_idle_mark(rbuv_idle_t *rbuv_idle);
 static void rbuv_idle_free(rbuv_idle_t *rbuv_idle);
+static void rbuv_idle_compact(rbuv_idle_t *rbuv_idle);
+static size_t rbuv_idle_memsize(const rbuv_idle_t *rbuv_idle);
+
+static const rb_data_type_t rbuv_idle_type = {
+  .wrap_struct_name = "rbuv_idle",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_idle_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_idle_free,
+    .dsize = (size_t (*)(const void *))rbuv_idle_memsize,
+    RBUV_DCOMPACT(rbuv_idle_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_idle_on_idle(uv_idle_t *uv_idle);
-static void rbuv_idle_on_idle_no_gvl(uv_idle_t *uv_idle);
+static void rbuv_idle_on_idle_no_gvl(rbuv_idle_on_idle_arg_t *arg);
 
 VALUE rbuv_idle_alloc(VALUE klass) {
   rbuv_idle_t *rbuv_idle;
@@ -24,14 +44,14 @@ VALUE rbuv_idle_alloc(VALUE klass) {
   rbuv_idle = malloc(sizeof(*rbuv_idle));
   rbuv_handle_alloc((rbuv_handle_t *)rbuv_idle);
   rbuv_idle->cb_on_idle = Qnil;
-  return Data_Wrap_Struct(klass, rbuv_idle_mark, rbuv_idle_free, rbuv_idle);
+  return TypedData_Wrap_Struct(klass, &rbuv_idle_type, rbuv_idle);
 }
 
 void rbuv_idle_mark(rbuv_idle_t *rbuv_idle) {
   assert(rbuv_idle);
   RBUV_DEBUG_LOG_DETAIL("rbuv_idle: %p, uv_handle: %p", rbuv_idle, rbuv_idle->uv_handle);
   rbuv_handle_mark((rbuv_handle_t *)rbuv_idle);
-  rb_gc_mark(rbuv_idle->cb_on_idle);
+  rb_gc_mark_movable(rbuv_idle->cb_on_idle);
 }
 
 void rbuv_idle_free(rbuv_idle_t *rbuv_idle) {
@@ -39,6 +59,15 @@ void rbuv_idle_free(rbuv_idle_t *rbuv_idle) {
   rbuv_handle_free((rbuv_handle_t *)rbuv_idle);
 }
 
+static void rbuv_idle_compact(rbuv_idle_t *rbuv_idle) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_idle);
+  RBUV_GC_UPDATE(rbuv_idle->cb_on_idle);
+}
+
+static size_t rbuv_idle_memsize(const rbuv_idle_t *rbuv_idle) {
+  return sizeof(*rbuv_idle);
+}
+
 /*
  * @overload initialize(loop=nil)
  *   Creates a new idle handle.
@@ -58,17 +87,14 @@ VALUE rbuv_idle_initialize(int argc, VALUE *argv, VALUE self) {
     loop = rbuv_loop_s_default(cRbuvLoop);
   }
 
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  Data_Get_Struct(self, rbuv_idle_t, rbuv_idle);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_idle_t, &rbuv_idle_type, rbuv_idle);
 
-  rbuv_idle->uv_handle = malloc(sizeof(*rbuv_idle->uv_handle));
-  uv_ret = uv_idle_init(rbuv_loop->uv_handle, rbuv_idle->uv_handle);
+  uv_ret = uv_idle_init(rbuv_loop->uv_handle, &rbuv_idle->uv_idle);
   if (uv_ret < 0) {
-    rbuv_idle->uv_handle->data = NULL;
-    free(rbuv_idle->uv_handle);
-    rbuv_idle->uv_handle = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   } else {
+    rbuv_idle->uv_handle = &rbuv_idle->uv_idle;
     rbuv_idle->uv_handle->data = (void *)self;
     return self;
   }
@@ -115,21 +141,32 @@ static VALUE rbuv_idle_stop(VALUE self) {
 }
 
 void rbuv_idle_on_idle(uv_idle_t *uv_idle) {
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_idle_on_idle_no_gvl, uv_idle);
+  rbuv_idle_on_idle_arg_t arg = { .uv_idle = uv_idle };
+  rbuv_loop_defer(uv_idle->loop, (VALUE)uv_idle->data,
+                  (rbuv_loop_deferred_cb)rbuv_idle_on_idle_no_gvl, &arg, sizeof(arg));
+  // idle callbacks may start prepare handles which should run on this iteration
+  rbuv_loop_flush(uv_idle->loop);
 }
 
-void rbuv_idle_on_idle_no_gvl(uv_idle_t *uv_idle) {
+void rbuv_idle_on_idle_no_gvl(rbuv_idle_on_idle_arg_t *arg) {
+  uv_idle_t *uv_idle = arg->uv_idle;
   VALUE idle;
   VALUE error;
   rbuv_idle_t *rbuv_idle;
 
+  // a callback earlier in the batch may have stopped or closed it
+  if (!uv_is_active((uv_handle_t *)uv_idle)) {
+    return;
+  }
   idle = (VALUE)uv_idle->data;
   Data_Get_Handle_Struct(idle, struct rbuv_idle_s, rbuv_idle);
   error = Qnil;
-  rb_funcall(rbuv_idle->cb_on_idle, id_call, 2, idle, error);
+  rbuv_call(rbuv_idle->cb_on_idle, 2, idle, error);
 }
 
 void Init_rbuv_idle() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_idle_t, uv_idle);
+
   cRbuvIdle = rb_define_class_under(mRbuv, "Idle", cRbuvHandle);
   rb_define_alloc_func(cRbuvIdle, rbuv_idle_alloc);
 
@@ -12,6 +12,15 @@
  *   The libuv internal count of active and referenced handles.
  *   @return the count of active and referenced handles.
  *
+ * @!attribute [r] stats
+ *   libuv callbacks are queued without the GVL and run in batches, the GVL is
+ *   taken once per batch (before and after polling for i/o).
+ *   @return [Hash] +:drains+ the number of batches run, +:events+ the number
+ *     of callbacks run, +:last_batch+ and +:max_batch+ the size of the last
+ *     and of the largest batch. +:write_pool_hits+ and +:write_pool_misses+
+ *     count the block-less writes which reused a completed one and those
+ *     which had to allocate.
+ *
  * @!attribute [r] default
  *   @!scope class
  *   @return [Rbuv::Loop] the default loop
@@ -37,11 +46,33 @@ ID RBUV_RUN_NOWAIT;
 static VALUE rbuv_loop_alloc(VALUE klass);
 static void rbuv_loop_mark(rbuv_loop_t *rbuv_loop);
 static void rbuv_loop_free(rbuv_loop_t *rbuv_loop);
+static void rbuv_loop_compact(rbuv_loop_t *rbuv_loop);
+static size_t rbuv_loop_memsize(const rbuv_loop_t *rbuv_loop);
+
+/*
+ * Freeing a loop closes it and warns about the handles left open, which cannot
+ * be done while the GC sweeps, so it is not freed immediately.
+ */
+const rb_data_type_t rbuv_loop_type = {
+  .wrap_struct_name = "rbuv_loop",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_loop_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_loop_free,
+    .dsize = (size_t (*)(const void *))rbuv_loop_memsize,
+    RBUV_DCOMPACT(rbuv_loop_compact)
+  },
+};
 
 /* Private methods */
 static void rbuv_walk_ary_push_cb(uv_handle_t* uv_handle, void* arg);
 static void rbuv_walk_unregister_cb(uv_handle_t* uv_handle, void* arg);
 static void rbuv_walk_gc_mark_cb(uv_handle_t *uv_handle, void *arg);
+static void rbuv_loop_setup(rbuv_loop_t *rbuv_loop);
+static void rbuv_loop_on_prepare(uv_prepare_t *uv_prepare);
+static void rbuv_loop_on_check(uv_check_t *uv_check);
+static void rbuv_loop_drain_with_gvl(rbuv_loop_t *rbuv_loop);
+static size_t rbuv_loop_drain(rbuv_loop_t *rbuv_loop);
+static size_t rbuv_loop_flush_corked_streams(rbuv_loop_t *rbuv_loop);
 static VALUE _rbuv_loop_run(VALUE self);
 static void _rbuv_loop_run_no_gvl(rbuv_loop_run_arg_t *arg);
 static VALUE rbuv_loop_get_handles2(rbuv_loop_t *rbuv_loop);
@@ -58,14 +89,13 @@ static VALUE rbuv_loop_alloc(VALUE klass) {
     free(rbuv_loop->uv_handle);
     rbuv_loop->uv_handle = NULL;
     free(rbuv_loop);
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
     return Qnil;
   }
   rbuv_loop->is_default = 0;
-  rbuv_loop->run_mode = RBUV_RUN_NOT_RUNNING;
-  rbuv_loop->requests = rb_ary_new();
+  rbuv_loop_setup(rbuv_loop);
 
-  loop = Data_Wrap_Struct(klass, rbuv_loop_mark, rbuv_loop_free, rbuv_loop);
+  loop = TypedData_Wrap_Struct(klass, &rbuv_loop_type, rbuv_loop);
   rbuv_loop->uv_handle->data = (void *)loop;
 
   RBUV_DEBUG_LOG_DETAIL("rbuv_loop: %p, uv_handle: %p, loop: %s",
@@ -76,18 +106,31 @@ static VALUE rbuv_loop_alloc(VALUE klass) {
 }
 
 static void rbuv_loop_mark(rbuv_loop_t *rbuv_loop) {
+  size_t i;
   assert(rbuv_loop);
   RBUV_DEBUG_LOG_DETAIL("rbuv_loop: %p, uv_handle: %p, self: %lx",
                         rbuv_loop, rbuv_loop->uv_handle,
                         (VALUE)rbuv_loop->uv_handle->data);
+  // libuv keeps the loop object in uv_loop->data, it must not move
+  rb_gc_mark((VALUE)rbuv_loop->uv_handle->data);
   uv_walk(rbuv_loop->uv_handle, rbuv_walk_gc_mark_cb, NULL);
-  rb_gc_mark(rbuv_loop->requests);
+  rbuv_request_list_mark(rbuv_loop->requests);
+  rb_gc_mark_movable(rbuv_loop->corked_streams);
+  rbuv_buffer_pool_mark(&rbuv_loop->read_buffers);
+
+  uv_mutex_lock(&rbuv_loop->deferred_mutex);
+  for (i = rbuv_loop->deferred_head; i < rbuv_loop->deferred_len; i++) {
+    rb_gc_mark(rbuv_loop->deferred[i].keep);
+  }
+  uv_mutex_unlock(&rbuv_loop->deferred_mutex);
 }
 
 static void rbuv_loop_free(rbuv_loop_t *rbuv_loop) {
   RBUV_DEBUG_LOG_DETAIL("rbuv_loop: %p, uv_handle: %p", rbuv_loop, rbuv_loop->uv_handle);
 
   uv_walk(rbuv_loop->uv_handle, rbuv_walk_unregister_cb, NULL);
+  uv_close((uv_handle_t *)&rbuv_loop->uv_prepare, NULL);
+  uv_close((uv_handle_t *)&rbuv_loop->uv_check, NULL);
   if (rbuv_loop->is_default == 0) {
     uv_loop_close(rbuv_loop->uv_handle);
     free(rbuv_loop->uv_handle);
@@ -95,9 +138,71 @@ static void rbuv_loop_free(rbuv_loop_t *rbuv_loop) {
     uv_loop_close(rbuv_loop->uv_handle);
   }
 
+  uv_mutex_destroy(&rbuv_loop->deferred_mutex);
+  free(rbuv_loop->deferred);
+  rbuv_write_free_spares(rbuv_loop);
   free(rbuv_loop);
 }
 
+static void rbuv_loop_compact(rbuv_loop_t *rbuv_loop) {
+  RBUV_GC_UPDATE(rbuv_loop->corked_streams);
+}
+
+/*
+ * The pooled read buffers are Strings, their memory is reported by them.
+ */
+static size_t rbuv_loop_memsize(const rbuv_loop_t *rbuv_loop) {
+  size_t size = sizeof(*rbuv_loop);
+  rbuv_write_t *rbuv_write;
+
+  if (!rbuv_loop->is_default) {
+    size += sizeof(*rbuv_loop->uv_handle);
+  }
+  size += rbuv_loop->deferred_capa * sizeof(*rbuv_loop->deferred);
+  for (rbuv_write = rbuv_loop->spare_writes; rbuv_write != NULL; rbuv_write = rbuv_write->next) {
+    size += rbuv_write_memsize(rbuv_write);
+  }
+  return size;
+}
+
+/*
+ * Shared by Rbuv::Loop.new and Rbuv::Loop.default, +uv_handle+ must be
+ * initialized.
+ */
+static void rbuv_loop_setup(rbuv_loop_t *rbuv_loop) {
+  rbuv_loop->run_mode = RBUV_RUN_NOT_RUNNING;
+  rbuv_loop->stop_requested = 0;
+  rbuv_loop->requests = NULL;
+  rbuv_loop->corked_streams = rb_ary_new();
+  rbuv_loop->corked_count = 0;
+  rbuv_buffer_pool_init(&rbuv_loop->read_buffers);
+  rbuv_loop->spare_writes = NULL;
+  rbuv_loop->spare_writes_count = 0;
+
+  rbuv_loop->deferred = NULL;
+  rbuv_loop->deferred_head = 0;
+  rbuv_loop->deferred_len = 0;
+  rbuv_loop->deferred_capa = 0;
+  rbuv_loop->stats_drains = 0;
+  rbuv_loop->stats_events = 0;
+  rbuv_loop->stats_last_batch = 0;
+  rbuv_loop->stats_max_batch = 0;
+  rbuv_loop->stats_write_pool_hits = 0;
+  rbuv_loop->stats_write_pool_misses = 0;
+  uv_mutex_init(&rbuv_loop->deferred_mutex);
+
+  /* Internal handles have no Ruby object, their data is NULL */
+  uv_prepare_init(rbuv_loop->uv_handle, &rbuv_loop->uv_prepare);
+  rbuv_loop->uv_prepare.data = NULL;
+  uv_prepare_start(&rbuv_loop->uv_prepare, rbuv_loop_on_prepare);
+  uv_unref((uv_handle_t *)&rbuv_loop->uv_prepare);
+
+  uv_check_init(rbuv_loop->uv_handle, &rbuv_loop->uv_check);
+  rbuv_loop->uv_check.data = NULL;
+  uv_check_start(&rbuv_loop->uv_check, rbuv_loop_on_check);
+  uv_unref((uv_handle_t *)&rbuv_loop->uv_check);
+}
+
 VALUE rbuv_loop_s_default(VALUE klass) {
   ID _default = rb_intern("@default");
   VALUE loop = rb_ivar_get(klass, _default);
@@ -107,10 +212,9 @@ VALUE rbuv_loop_s_default(VALUE klass) {
     rbuv_loop = malloc(sizeof(*rbuv_loop));
     rbuv_loop->uv_handle = uv_default_loop();
     rbuv_loop->is_default = 1;
-    rbuv_loop->run_mode = RBUV_RUN_NOT_RUNNING;
-    rbuv_loop->requests = rb_ary_new();
+    rbuv_loop_setup(rbuv_loop);
 
-    loop = Data_Wrap_Struct(klass, rbuv_loop_mark, rbuv_loop_free, rbuv_loop);
+    loop = TypedData_Wrap_Struct(klass, &rbuv_loop_type, rbuv_loop);
     rbuv_loop->uv_handle->data = (void *)loop;
 
     RBUV_DEBUG_LOG_DETAIL("rbuv_loop: %p, uv_handle: %p, loop: %s",
@@ -124,7 +228,7 @@ VALUE rbuv_loop_s_default(VALUE klass) {
 
 static VALUE _rbuv_loop_after_run(VALUE self) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   rbuv_loop->run_mode = RBUV_RUN_NOT_RUNNING;
   return self;
 }
@@ -157,7 +261,7 @@ static VALUE rbuv_loop_run(int argc, VALUE *argv, VALUE self) {
     run_mode_id = SYM2ID(run_mode);
   }
 
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   if (rbuv_loop->run_mode != RBUV_RUN_NOT_RUNNING) {
     rb_raise(eRbuvError, "This %s loop is already running", rb_obj_classname(self));
   }
@@ -179,15 +283,33 @@ static VALUE rbuv_loop_run(int argc, VALUE *argv, VALUE self) {
 static VALUE rbuv_loop_stop(VALUE self) {
   rbuv_loop_t *rbuv_loop;
 
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
 
   uv_stop(rbuv_loop->uv_handle);
+  rbuv_loop->stop_requested = 1;
+  return self;
+}
+
+/*
+ * Reinitializes the kernel state of the loop in a child process, it must be
+ * called after +fork+ before the child uses the loop. Handles started before
+ * the fork are shared with the parent, the child should close those it does
+ * not need.
+ *
+ * @see Rbuv::Prefork
+ * @return [self] itself
+ */
+static VALUE rbuv_loop_after_fork(VALUE self) {
+  rbuv_loop_t *rbuv_loop;
+
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  RBUV_CHECK_UV_RETURN(uv_loop_fork(rbuv_loop->uv_handle));
   return self;
 }
 
 static VALUE rbuv_loop_get_handles(VALUE self) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   return rbuv_loop_get_handles2(rbuv_loop);
 }
 
@@ -199,35 +321,56 @@ static VALUE rbuv_loop_get_handles2(rbuv_loop_t *rbuv_loop) {
 
 static VALUE rbuv_loop_get_requests(VALUE self) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
-  return rb_ary_dup(rbuv_loop->requests);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  return rbuv_request_list_to_a(rbuv_loop->requests);
+}
+
+static VALUE rbuv_loop_get_stats(VALUE self) {
+  rbuv_loop_t *rbuv_loop;
+  VALUE stats;
+
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  stats = rb_hash_new();
+  rb_hash_aset(stats, ID2SYM(rb_intern("drains")),
+               ULL2NUM(rbuv_loop->stats_drains));
+  rb_hash_aset(stats, ID2SYM(rb_intern("events")),
+               ULL2NUM(rbuv_loop->stats_events));
+  rb_hash_aset(stats, ID2SYM(rb_intern("last_batch")),
+               ULL2NUM(rbuv_loop->stats_last_batch));
+  rb_hash_aset(stats, ID2SYM(rb_intern("max_batch")),
+               ULL2NUM(rbuv_loop->stats_max_batch));
+  rb_hash_aset(stats, ID2SYM(rb_intern("write_pool_hits")),
+               ULL2NUM(rbuv_loop->stats_write_pool_hits));
+  rb_hash_aset(stats, ID2SYM(rb_intern("write_pool_misses")),
+               ULL2NUM(rbuv_loop->stats_write_pool_misses));
+  return stats;
 }
 
 static VALUE rbuv_loop_get_ref_count(VALUE self) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   return UINT2NUM(rbuv_loop->uv_handle->active_handles);
 }
 
 static VALUE rbuv_loop_inspect(VALUE self) {
   rbuv_loop_t *rbuv_loop;
   const char *cname = rb_obj_classname(self);
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   return rb_sprintf("#<%s:%p @handles=%s @requests=%s>", cname, (void*)self,
                     RSTRING_PTR(rb_inspect(rbuv_loop_get_handles2(rbuv_loop))),
-                    RSTRING_PTR(rb_inspect(rbuv_loop->requests)));
+                    RSTRING_PTR(rb_inspect(rbuv_request_list_to_a(rbuv_loop->requests))));
 }
 
 static VALUE rbuv_loop_now(VALUE self) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   uint64_t now = uv_now(rbuv_loop->uv_handle);
   return UINT2NUM(now);
 }
 
 static VALUE rbuv_loop_update_time(VALUE self) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   uv_update_time(rbuv_loop->uv_handle);
   return self;
 }
@@ -236,21 +379,23 @@ static VALUE rbuv_loop_update_time(VALUE self) {
 void rbuv_walk_ary_push_cb(uv_handle_t* uv_handle, void* arg) {
   VALUE array = (VALUE)arg;
   VALUE handle = (VALUE)uv_handle->data;
-  rb_ary_push(array, handle);
+  if (uv_handle->data != NULL) {
+    rb_ary_push(array, handle);
+  }
 }
 
 void rbuv_walk_unregister_cb(uv_handle_t* uv_handle, void* arg) {
-  // dont call if the object have already been GC'd
-  VALUE handle = (VALUE)uv_handle->data;
-  if (TYPE(handle) != T_NONE) {
-    rbuv_handle_t *rbuv_handle = (rbuv_handle_t *)DATA_PTR(handle);
-    rbuv_handle_unregister_loop(rbuv_handle);
+  // handles freed by the GC already cleared their data
+  if (uv_handle->data != NULL) {
+    rbuv_handle_unregister_loop(RBUV_HANDLE_OF(uv_handle));
   }
 }
 
 void rbuv_walk_gc_mark_cb(uv_handle_t *uv_handle, void *arg) {
   VALUE handle = (VALUE)uv_handle->data;
-  rb_gc_mark(handle);
+  if (uv_handle->data != NULL) {
+    rb_gc_mark(handle);
+  }
 }
 
 VALUE _rbuv_loop_run(VALUE self) {
@@ -258,7 +403,7 @@ VALUE _rbuv_loop_run(VALUE self) {
   rbuv_loop_run_arg_t arg;
   uv_run_mode mode;
 
-  Data_Get_Struct(self, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
   arg.loop = rbuv_loop->uv_handle;
   if (rbuv_loop->run_mode == RBUV_RUN_DEFAULT) {
     arg.mode = UV_RUN_DEFAULT;
@@ -269,13 +414,22 @@ VALUE _rbuv_loop_run(VALUE self) {
   } else {
     arg.mode = UV_RUN_DEFAULT; // TODO: raise error? better implementation?
   }
+  rbuv_loop->stop_requested = 0;
+  /*
+   * Callbacks queued after the last check phase (close callbacks for
+   * instance) are run here. They may start new handles, so the default mode
+   * keeps running while that happens.
+   */
+  do {
 #ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
-  rb_thread_call_without_gvl((rbuv_rb_blocking_function_t)_rbuv_loop_run_no_gvl,
-                             &arg, RUBY_UBF_IO, 0);
+    rb_thread_call_without_gvl((rbuv_rb_blocking_function_t)_rbuv_loop_run_no_gvl,
+                               &arg, RUBY_UBF_IO, 0);
 #else
-  rb_thread_blocking_region((rb_blocking_function_t *)_rbuv_loop_run_no_gvl,
-                            &arg, RUBY_UBF_IO, 0);
+    rb_thread_blocking_region((rb_blocking_function_t *)_rbuv_loop_run_no_gvl,
+                              &arg, RUBY_UBF_IO, 0);
 #endif
+  } while (rbuv_loop_drain(rbuv_loop) > 0 && arg.mode == UV_RUN_DEFAULT &&
+           !rbuv_loop->stop_requested && uv_loop_alive(rbuv_loop->uv_handle));
   return self;
 }
 
@@ -283,15 +437,129 @@ void _rbuv_loop_run_no_gvl(rbuv_loop_run_arg_t *arg) {
   uv_run(arg->loop, arg->mode);
 }
 
-void rbuv_loop_register_request(VALUE loop, VALUE request) {
+/*
+ * Queues +cb+ to be called with the GVL held, it is called from libuv
+ * callbacks which run without it. +size+ bytes of +arg+ are copied.
+ */
+void rbuv_loop_defer(uv_loop_t *uv_loop, VALUE keep, rbuv_loop_deferred_cb cb,
+                     const void *arg, size_t size) {
+  rbuv_loop_t *rbuv_loop = RTYPEDDATA_DATA((VALUE)uv_loop->data);
+  rbuv_deferred_t *deferred;
+
+  assert(size <= RBUV_DEFERRED_ARG_SIZE);
+  uv_mutex_lock(&rbuv_loop->deferred_mutex);
+  if (rbuv_loop->deferred_len == rbuv_loop->deferred_capa) {
+    rbuv_loop->deferred_capa = rbuv_loop->deferred_capa ? rbuv_loop->deferred_capa * 2 : 64;
+    rbuv_loop->deferred = realloc(rbuv_loop->deferred,
+                                  sizeof(*rbuv_loop->deferred) * rbuv_loop->deferred_capa);
+  }
+  deferred = &rbuv_loop->deferred[rbuv_loop->deferred_len];
+  deferred->cb = cb;
+  deferred->keep = keep;
+  memcpy(deferred->arg.bytes, arg, size);
+  rbuv_loop->deferred_len++;
+  uv_mutex_unlock(&rbuv_loop->deferred_mutex);
+}
+
+/*
+ * Runs the queued callbacks right away, for libuv callbacks that must not wait
+ * for the next prepare or check phase.
+ */
+void rbuv_loop_flush(uv_loop_t *uv_loop) {
+  rbuv_loop_drain_with_gvl(RTYPEDDATA_DATA((VALUE)uv_loop->data));
+}
+
+void rbuv_loop_on_prepare(uv_prepare_t *uv_prepare) {
+  rbuv_loop_drain_with_gvl(RBUV_CONTAINTER_OF(uv_prepare, rbuv_loop_t, uv_prepare));
+}
+
+void rbuv_loop_on_check(uv_check_t *uv_check) {
+  rbuv_loop_drain_with_gvl(RBUV_CONTAINTER_OF(uv_check, rbuv_loop_t, uv_check));
+}
+
+void rbuv_loop_drain_with_gvl(rbuv_loop_t *rbuv_loop) {
+  // only the loop thread queues callbacks, no need to lock here
+  if (rbuv_loop->deferred_head != rbuv_loop->deferred_len ||
+      rbuv_loop->corked_count > 0) {
+    rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_loop_drain,
+                            rbuv_loop);
+  }
+}
+
+/*
+ * Runs the queued callbacks in order, then flushes the writes they corked.
+ * If a callback raises the remaining ones stay queued for the next drain.
+ *
+ * Returns the number of callbacks and flushes done.
+ */
+size_t rbuv_loop_drain(rbuv_loop_t *rbuv_loop) {
+  rbuv_deferred_t deferred;
+  size_t batch;
+
+  uv_mutex_lock(&rbuv_loop->deferred_mutex);
+  batch = rbuv_loop->deferred_len - rbuv_loop->deferred_head;
+  uv_mutex_unlock(&rbuv_loop->deferred_mutex);
+  if (batch == 0) {
+    return rbuv_loop_flush_corked_streams(rbuv_loop);
+  }
+
+  rbuv_loop->stats_drains++;
+  rbuv_loop->stats_events += batch;
+  rbuv_loop->stats_last_batch = batch;
+  if (batch > rbuv_loop->stats_max_batch) {
+    rbuv_loop->stats_max_batch = batch;
+  }
+
+  for (;;) {
+    uv_mutex_lock(&rbuv_loop->deferred_mutex);
+    if (rbuv_loop->deferred_head == rbuv_loop->deferred_len) {
+      rbuv_loop->deferred_head = 0;
+      rbuv_loop->deferred_len = 0;
+      uv_mutex_unlock(&rbuv_loop->deferred_mutex);
+      break;
+    }
+    deferred = rbuv_loop->deferred[rbuv_loop->deferred_head];
+    rbuv_loop->deferred_head++;
+    uv_mutex_unlock(&rbuv_loop->deferred_mutex);
+
+    deferred.cb(deferred.arg.bytes);
+    RB_GC_GUARD(deferred.keep);
+  }
+  return batch + rbuv_loop_flush_corked_streams(rbuv_loop);
+}
+
+void rbuv_loop_add_corked_stream(VALUE loop, VALUE stream) {
+  rbuv_loop_t *rbuv_loop;
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  rb_ary_push(rbuv_loop->corked_streams, stream);
+  rbuv_loop->corked_count++;
+}
+
+size_t rbuv_loop_flush_corked_streams(rbuv_loop_t *rbuv_loop) {
+  VALUE streams;
+  long i;
+
+  if (rbuv_loop->corked_count == 0) {
+    return 0;
+  }
+  streams = rbuv_loop->corked_streams;
+  rbuv_loop->corked_streams = rb_ary_new();
+  rbuv_loop->corked_count = 0;
+  for (i = 0; i < RARRAY_LEN(streams); i++) {
+    rbuv_stream_flush_auto_cork(rb_ary_entry(streams, i));
+  }
+  return RARRAY_LEN(streams);
+}
+
+void rbuv_loop_register_request(VALUE loop, rbuv_request_link_t *link, VALUE request) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  rb_ary_push(rbuv_loop->requests, request);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  rbuv_request_link(&rbuv_loop->requests, link, request);
 }
-void rbuv_loop_unregister_request(VALUE loop, VALUE request) {
+void rbuv_loop_unregister_request(VALUE loop, rbuv_request_link_t *link) {
   rbuv_loop_t *rbuv_loop;
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  rbuv_ary_delete_same_object(rbuv_loop->requests, request);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  rbuv_request_unlink(&rbuv_loop->requests, link);
 }
 
 
@@ -305,9 +573,11 @@ void Init_rbuv_loop() {
 
   rb_define_method(cRbuvLoop, "_run", rbuv_loop_run, -1);
   rb_define_method(cRbuvLoop, "stop", rbuv_loop_stop, 0);
+  rb_define_method(cRbuvLoop, "after_fork", rbuv_loop_after_fork, 0);
   rb_define_method(cRbuvLoop, "handles", rbuv_loop_get_handles, 0);
   rb_define_method(cRbuvLoop, "requests", rbuv_loop_get_requests, 0);
   rb_define_method(cRbuvLoop, "ref_count", rbuv_loop_get_ref_count, 0);
+  rb_define_method(cRbuvLoop, "stats", rbuv_loop_get_stats, 0);
   rb_define_method(cRbuvLoop, "inspect", rbuv_loop_inspect, 0);
   rb_define_method(cRbuvLoop, "now", rbuv_loop_now, 0);
   rb_define_method(cRbuvLoop, "update_time", rbuv_loop_update_time, 0);
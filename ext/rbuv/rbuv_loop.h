@@ -3,19 +3,61 @@
 
 #include "rbuv.h"
 
+#define RBUV_DEFERRED_ARG_SIZE 48
+
+typedef void (*rbuv_loop_deferred_cb)(void *arg);
+
+/*
+ * A libuv callback waiting for the GVL, +keep+ is marked until it runs.
+ */
+struct rbuv_deferred_s {
+  rbuv_loop_deferred_cb cb;
+  VALUE keep;
+  union {
+    char bytes[RBUV_DEFERRED_ARG_SIZE];
+    void *align_ptr;
+    double align_double;
+  } arg;
+};
+typedef struct rbuv_deferred_s rbuv_deferred_t;
+
 struct rbuv_loop_s {
   uv_loop_t* uv_handle;
   int is_default;
   ID run_mode;
-  VALUE requests;
+  int stop_requested;
+  struct rbuv_request_link_s *requests;
+  VALUE corked_streams; /* auto corked streams with data to flush */
+  size_t corked_count;
+  rbuv_buffer_pool_t read_buffers;
+  struct rbuv_write_s *spare_writes; /* completed block-less writes */
+  unsigned int spare_writes_count;
+  uv_prepare_t uv_prepare;
+  uv_check_t uv_check;
+  uv_mutex_t deferred_mutex;
+  rbuv_deferred_t *deferred;
+  size_t deferred_head;
+  size_t deferred_len;
+  size_t deferred_capa;
+  uint64_t stats_drains;
+  uint64_t stats_events;
+  uint64_t stats_last_batch;
+  uint64_t stats_max_batch;
+  uint64_t stats_write_pool_hits;
+  uint64_t stats_write_pool_misses;
 };
 typedef struct rbuv_loop_s rbuv_loop_t;
 
 extern VALUE cRbuvLoop;
+extern const rb_data_type_t rbuv_loop_type;
 
 VALUE rbuv_loop_s_default(VALUE klass);
-void rbuv_loop_register_request(VALUE loop, VALUE request);
-void rbuv_loop_unregister_request(VALUE loop, VALUE request);
+void rbuv_loop_register_request(VALUE loop, struct rbuv_request_link_s *link, VALUE request);
+void rbuv_loop_unregister_request(VALUE loop, struct rbuv_request_link_s *link);
+void rbuv_loop_defer(uv_loop_t *uv_loop, VALUE keep, rbuv_loop_deferred_cb cb,
+                     const void *arg, size_t size);
+void rbuv_loop_flush(uv_loop_t *uv_loop);
+void rbuv_loop_add_corked_stream(VALUE loop, VALUE stream);
 void Init_rbuv_loop();
 
 #endif  /* RBUV_LOOP_H_ */
@@ -0,0 +1,281 @@
+#include "rbuv_pipe.h"
+
+struct rbuv_pipe_s {
+  uv_pipe_t *uv_handle;
+  VALUE cb_on_close;
+  union rbuv_stream_uv_u uv;
+  VALUE cb_on_connection;
+  VALUE cb_on_read;
+  struct rbuv_request_link_s *requests; /* pending requests with a block */
+  VALUE read_buffer;
+  VALUE cb_on_error;
+  struct rbuv_write_s *writes;
+  int cork;
+  int cork_queued;
+  char *cork_buf;
+  size_t cork_len;
+  size_t cork_capa;
+  size_t high_watermark;
+  size_t low_watermark;
+  int needs_drain;
+  VALUE cb_on_drain;
+  rbuv_read_into_t *read_into; /* set by read_start(buffer:) */
+  rbuv_framer_t *framer; /* set by read_frames */
+  rbuv_stream_pipe_t *pipe; /* set by pipe_to */
+  int read_handler;
+  unsigned int accept_limit;
+  int handles_counted;
+  unsigned int read_generation;
+  VALUE cb_on_connect;
+  uv_connect_t uv_connect;
+};
+typedef struct rbuv_pipe_s rbuv_pipe_t;
+
+struct rbuv_pipe_on_connect_arg_s {
+  uv_stream_t *uv_handle;
+  int status;
+};
+typedef struct rbuv_pipe_on_connect_arg_s rbuv_pipe_on_connect_arg_t;
+
+VALUE cRbuvPipe;
+
+/* Allocator / Mark / Deallocator */
+static VALUE rbuv_pipe_alloc(VALUE klass);
+static void rbuv_pipe_mark(rbuv_pipe_t *rbuv_pipe);
+static void rbuv_pipe_free(rbuv_pipe_t *rbuv_pipe);
+static void rbuv_pipe_compact(rbuv_pipe_t *rbuv_pipe);
+static size_t rbuv_pipe_memsize(const rbuv_pipe_t *rbuv_pipe);
+
+static const rb_data_type_t rbuv_pipe_type = {
+  .wrap_struct_name = "rbuv_pipe",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_pipe_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_pipe_free,
+    .dsize = (size_t (*)(const void *))rbuv_pipe_memsize,
+    RBUV_DCOMPACT(rbuv_pipe_compact)
+  },
+  .parent = &rbuv_stream_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+/* Private methods */
+static void rbuv_pipe_on_connect(uv_connect_t *uv_connect, int status);
+static void rbuv_pipe_on_connect_no_gvl(rbuv_pipe_on_connect_arg_t *arg);
+
+VALUE rbuv_pipe_alloc(VALUE klass) {
+  rbuv_pipe_t *rbuv_pipe;
+
+  rbuv_pipe = malloc(sizeof(*rbuv_pipe));
+  rbuv_stream_alloc((rbuv_stream_t *)rbuv_pipe);
+  rbuv_pipe->cb_on_connect = Qnil;
+
+  return TypedData_Wrap_Struct(klass, &rbuv_pipe_type, rbuv_pipe);
+}
+
+void rbuv_pipe_mark(rbuv_pipe_t *rbuv_pipe) {
+  assert(rbuv_pipe);
+  RBUV_DEBUG_LOG_DETAIL("rbuv_pipe: %p, uv_handle: %p", rbuv_pipe, rbuv_pipe->uv_handle);
+  rbuv_stream_mark((rbuv_stream_t *)rbuv_pipe);
+  rb_gc_mark_movable(rbuv_pipe->cb_on_connect);
+}
+
+void rbuv_pipe_free(rbuv_pipe_t *rbuv_pipe) {
+  RBUV_DEBUG_LOG_DETAIL("rbuv_pipe: %p, uv_handle: %p", rbuv_pipe, rbuv_pipe->uv_handle);
+
+  rbuv_stream_free((rbuv_stream_t *)rbuv_pipe);
+}
+
+void rbuv_pipe_compact(rbuv_pipe_t *rbuv_pipe) {
+  rbuv_stream_compact((rbuv_stream_t *)rbuv_pipe);
+  RBUV_GC_UPDATE(rbuv_pipe->cb_on_connect);
+}
+
+size_t rbuv_pipe_memsize(const rbuv_pipe_t *rbuv_pipe) {
+  return sizeof(*rbuv_pipe) + rbuv_stream_memsize((const rbuv_stream_t *)rbuv_pipe);
+}
+
+/*
+ * @overload initialize(loop=nil, ipc: false)
+ *   Create a new handle to deal with a pipe, a Unix domain socket or a named
+ *   pipe on Windows.
+ *
+ *   @param loop [Rbuv::Loop, nil] loop object where this handle runs, if it is
+ *     +nil+ then it the runs the handle in the {Rbuv::Loop.default}
+ *   @param ipc [Boolean] whether handles can be passed over this pipe, with
+ *     {Rbuv::Stream#write2} and {Rbuv::Stream#read2_start}
+ *   @return [Rbuv::Pipe]
+ */
+static VALUE rbuv_pipe_initialize(int argc, VALUE *argv, VALUE self) {
+  VALUE loop;
+  VALUE options;
+  int ipc;
+  int uv_ret;
+  rbuv_pipe_t *rbuv_pipe;
+  rbuv_loop_t *rbuv_loop;
+
+  rb_scan_args(argc, argv, "01:", &loop, &options);
+  if (loop == Qnil) {
+    loop = rbuv_loop_s_default(cRbuvLoop);
+  }
+  ipc = !NIL_P(options) && RTEST(rb_hash_aref(options, ID2SYM(rb_intern("ipc"))));
+
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_pipe_t, &rbuv_pipe_type, rbuv_pipe);
+  uv_ret = uv_pipe_init(rbuv_loop->uv_handle, &rbuv_pipe->uv.pipe, ipc);
+  if (uv_ret < 0) {
+    rbuv_error_raise(uv_ret);
+  }
+  rbuv_pipe->uv_handle = &rbuv_pipe->uv.pipe;
+  rbuv_pipe->uv_handle->data = (void *)self;
+  return self;
+}
+
+/*
+ * Check if handles can be passed over this pipe.
+ * @return [Boolean]
+ */
+static VALUE rbuv_pipe_is_ipc(VALUE self) {
+  rbuv_pipe_t *rbuv_pipe;
+  Data_Get_Handle_Struct(self, rbuv_pipe_t, rbuv_pipe);
+  return rbuv_pipe->uv_handle->ipc ? Qtrue : Qfalse;
+}
+
+/* @overload open(fd)
+ * Use an existing file descriptor, like one end of a socketpair shared with a
+ * child process.
+ * @example
+ *   parent, child = UNIXSocket.pair
+ *   child.autoclose = false
+ *   pipe = Rbuv::Pipe.new(ipc: true).open(child.fileno)
+ * @param fd [Number] the file descriptor, the pipe closes it when it is
+ *   closed
+ * @return [self] itself
+ */
+static VALUE rbuv_pipe_open(VALUE self, VALUE fd) {
+  rbuv_pipe_t *rbuv_pipe;
+  Data_Get_Handle_Struct(self, rbuv_pipe_t, rbuv_pipe);
+  RBUV_CHECK_UV_RETURN(uv_pipe_open(rbuv_pipe->uv_handle, NUM2INT(fd)));
+  return self;
+}
+
+/* @overload bind(name)
+ * Bind this pipe to a file path (Unix) or a name (Windows).
+ * @param name [String] the path or name to bind to
+ * @return [self] itself
+ */
+static VALUE rbuv_pipe_bind(VALUE self, VALUE name) {
+  rbuv_pipe_t *rbuv_pipe;
+  Data_Get_Handle_Struct(self, rbuv_pipe_t, rbuv_pipe);
+  RBUV_CHECK_UV_RETURN(uv_pipe_bind(rbuv_pipe->uv_handle, StringValueCStr(name)));
+  return self;
+}
+
+/* @overload connect(name)
+ * Connect this pipe to a file path (Unix) or a name (Windows).
+ * @param name [String] the path or name to connect to
+ * @yield callback
+ * @yieldparam pipe [self]
+ * @yieldparam error [Rbuv::Error, nil]
+ * @return [self] itself
+ */
+static VALUE rbuv_pipe_connect(VALUE self, VALUE name) {
+  VALUE block;
+  rbuv_pipe_t *rbuv_pipe;
+
+  rb_need_block();
+  block = rb_block_proc();
+
+  Data_Get_Handle_Struct(self, rbuv_pipe_t, rbuv_pipe);
+  rbuv_pipe->cb_on_connect = block;
+  uv_pipe_connect(&rbuv_pipe->uv_connect, rbuv_pipe->uv_handle,
+                  StringValueCStr(name), rbuv_pipe_on_connect);
+  return self;
+}
+
+/*
+ * Accept a connection to a pipe listening with {#listen}.
+ *
+ * @overload accept
+ *   @return [Rbuv::Pipe] a new {Rbuv::Pipe} object associated with the
+ *     accepted connection
+ * @overload accept(client)
+ *   @param (see Rbuv::Stream#accept)
+ *   @return (see Rbuv::Stream#accept)
+ */
+static VALUE rbuv_pipe_accept(int argc, VALUE *argv, VALUE self) {
+  VALUE client;
+  rb_scan_args(argc, argv, "01", &client);
+  if (client == Qnil) {
+    rbuv_pipe_t *rbuv_pipe;
+    VALUE loop;
+
+    Data_Get_Handle_Struct(self, rbuv_pipe_t, rbuv_pipe);
+    loop = (VALUE)rbuv_pipe->uv_handle->loop->data;
+    client = rb_class_new_instance(1, &loop, rb_class_of(self));
+    rb_call_super(1, &client);
+    return client;
+  } else {
+    return rb_call_super(argc, argv);
+  }
+}
+
+void rbuv_pipe_on_connect(uv_connect_t *uv_connect, int status) {
+  rbuv_pipe_on_connect_arg_t arg = {
+    .uv_handle = uv_connect->handle,
+    .status = status
+  };
+  rbuv_loop_defer(arg.uv_handle->loop, (VALUE)arg.uv_handle->data,
+                  (rbuv_loop_deferred_cb)rbuv_pipe_on_connect_no_gvl,
+                  &arg, sizeof(arg));
+}
+
+void rbuv_pipe_on_connect_no_gvl(rbuv_pipe_on_connect_arg_t *arg) {
+  uv_stream_t *uv_stream = arg->uv_handle;
+  int status = arg->status;
+
+  rbuv_pipe_t *rbuv_pipe;
+  VALUE pipe;
+  VALUE on_connect;
+  VALUE error;
+
+  RBUV_DEBUG_LOG("uv_stream: %p, status: %d", uv_stream, status);
+
+  pipe = (VALUE)uv_stream->data;
+  Data_Get_Handle_Struct(pipe, rbuv_pipe_t, rbuv_pipe);
+  on_connect = rbuv_pipe->cb_on_connect;
+  rbuv_pipe->cb_on_connect = Qnil;
+
+  if (status < 0) {
+    error = rbuv_error_new(status);
+  } else {
+    error = Qnil;
+  }
+  rbuv_call(on_connect, 2, pipe, error);
+}
+
+void Init_rbuv_pipe() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_pipe_t, uv);
+
+  cRbuvPipe = rb_define_class_under(mRbuv, "Pipe", cRbuvStream);
+  rb_define_alloc_func(cRbuvPipe, rbuv_pipe_alloc);
+
+  rb_define_method(cRbuvPipe, "initialize", rbuv_pipe_initialize, -1);
+  rb_define_method(cRbuvPipe, "ipc?", rbuv_pipe_is_ipc, 0);
+  rb_define_method(cRbuvPipe, "open", rbuv_pipe_open, 1);
+  rb_define_method(cRbuvPipe, "bind", rbuv_pipe_bind, 1);
+  rb_define_method(cRbuvPipe, "connect", rbuv_pipe_connect, 1);
+  rb_define_method(cRbuvPipe, "accept", rbuv_pipe_accept, -1);
+}
+
+/* This have to be declared after Init_* so it can replace YARD bad assumption
+ * for parent class beeing RbuvStream not Rbuv::Stream.
+ * Also it need some text after document-class statement otherwise YARD won't
+ * parse it
+ */
+
+/*
+ * Document-class: Rbuv::Pipe < Rbuv::Stream
+ *
+ * A pipe is a Unix domain socket or a named pipe on Windows. IPC pipes pass
+ * handles between processes, see {Rbuv::Stream#write2}.
+ */
@@ -0,0 +1,10 @@
+#ifndef RBUV_PIPE_H_
+#define RBUV_PIPE_H_
+
+#include "rbuv.h"
+
+extern VALUE cRbuvPipe;
+
+void Init_rbuv_pipe();
+
+#endif  /* RBUV_PIPE_H_ */
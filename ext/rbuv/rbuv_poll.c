@@ -5,6 +5,7 @@ VALUE cRbuvPoll;
 struct rbuv_poll_s {
   uv_poll_t *uv_handle;
   VALUE cb_on_close;
+  uv_poll_t uv_poll;
   VALUE cb_on_available;
 };
 typedef struct rbuv_poll_s rbuv_poll_t;
@@ -21,6 +22,20 @@ typedef struct rbuv_poll_on_available_arg_s rbuv_poll_on_available_arg_t;
 static VALUE rbuv_poll_alloc(VALUE klass);
 static void rbuv_poll_mark(rbuv_poll_t *rbuv_poll);
 static void rbuv_poll_free(rbuv_poll_t *rbuv_poll);
+static void rbuv_poll_compact(rbuv_poll_t *rbuv_poll);
+static size_t rbuv_poll_memsize(const rbuv_poll_t *rbuv_poll);
+
+static const rb_data_type_t rbuv_poll_type = {
+  .wrap_struct_name = "rbuv_poll",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_poll_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_poll_free,
+    .dsize = (size_t (*)(const void *))rbuv_poll_memsize,
+    RBUV_DCOMPACT(rbuv_poll_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_poll_on_available(uv_poll_t *uv_poll, int status, int events);
@@ -32,13 +47,13 @@ VALUE rbuv_poll_alloc(VALUE klass) {
   rbuv_poll = malloc(sizeof(*rbuv_poll));
   rbuv_handle_alloc((rbuv_handle_t *)rbuv_poll);
   rbuv_poll->cb_on_available = Qnil;
-  return Data_Wrap_Struct(klass, rbuv_poll_mark, rbuv_poll_free, rbuv_poll);
+  return TypedData_Wrap_Struct(klass, &rbuv_poll_type, rbuv_poll);
 }
 
 void rbuv_poll_mark(rbuv_poll_t *rbuv_poll) {
   assert(rbuv_poll);
   rbuv_handle_mark((rbuv_handle_t *)rbuv_poll);
-  rb_gc_mark(rbuv_poll->cb_on_available);
+  rb_gc_mark_movable(rbuv_poll->cb_on_available);
 }
 
 void rbuv_poll_free(rbuv_poll_t *rbuv_poll) {
@@ -48,6 +63,15 @@ void rbuv_poll_free(rbuv_poll_t *rbuv_poll) {
   rbuv_handle_free((rbuv_handle_t *)rbuv_poll);
 }
 
+static void rbuv_poll_compact(rbuv_poll_t *rbuv_poll) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_poll);
+  RBUV_GC_UPDATE(rbuv_poll->cb_on_available);
+}
+
+static size_t rbuv_poll_memsize(const rbuv_poll_t *rbuv_poll) {
+  return sizeof(*rbuv_poll);
+}
+
 /*
  * Creates a new poll watcher
  * @overload initialize(loop, fd)
@@ -75,15 +99,13 @@ static VALUE rbuv_poll_initialize(int argc, VALUE *argv, VALUE self) {
   if (loop == Qnil) {
     loop = rbuv_loop_s_default(cRbuvLoop);
   }
-  Data_Get_Struct(self, rbuv_poll_t, rbuv_poll);
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  rbuv_poll->uv_handle = malloc(sizeof(*rbuv_poll->uv_handle));
-  uv_ret = uv_poll_init(rbuv_loop->uv_handle, rbuv_poll->uv_handle, FIX2INT(fd));
+  TypedData_Get_Struct(self, rbuv_poll_t, &rbuv_poll_type, rbuv_poll);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  uv_ret = uv_poll_init(rbuv_loop->uv_handle, &rbuv_poll->uv_poll, FIX2INT(fd));
   if (uv_ret < 0) {
-    free(rbuv_poll->uv_handle);
-    rbuv_poll->uv_handle = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   }
+  rbuv_poll->uv_handle = &rbuv_poll->uv_poll;
   rbuv_poll->uv_handle->data = (void *)self;
 
   return self;
@@ -141,8 +163,9 @@ void rbuv_poll_on_available(uv_poll_t *uv_poll, int status, int events) {
     .uv_poll = uv_poll,
     .status = status,
     .events = events };
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)
-    rbuv_poll_on_available_no_gvl, &reg);
+  rbuv_loop_defer(uv_poll->loop, (VALUE)uv_poll->data,
+                  (rbuv_loop_deferred_cb)rbuv_poll_on_available_no_gvl,
+                  &reg, sizeof(reg));
 }
 
 void rbuv_poll_on_available_no_gvl(rbuv_poll_on_available_arg_t *arg) {
@@ -154,20 +177,28 @@ void rbuv_poll_on_available_no_gvl(rbuv_poll_on_available_arg_t *arg) {
   VALUE error;
   rbuv_poll_t *rbuv_poll;
 
+  // a callback earlier in the batch may have stopped or closed it, an error
+  // has stopped it already
+  if (uv_is_closing((uv_handle_t *)uv_poll) ||
+      (status == 0 && !uv_is_active((uv_handle_t *)uv_poll))) {
+    return;
+  }
   poll = (VALUE)uv_poll->data;
   events = INT2FIX(arg->events);
   Data_Get_Handle_Struct(poll, struct rbuv_poll_s, rbuv_poll);
   if (status < 0) {
     RBUV_DEBUG_LOG_DETAIL("uv_poll: %p, status: %d, error: %s", uv_poll,
                           status, uv_strerror(status));
-    error = rb_exc_new2(eRbuvError, uv_strerror(status));
+    error = rbuv_error_new(status);
   } else {
     error = Qnil;
   }
-  rb_funcall(rbuv_poll->cb_on_available, id_call, 3, poll, events, error);
+  rbuv_call(rbuv_poll->cb_on_available, 3, poll, events, error);
 }
 
 void Init_rbuv_poll() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_poll_t, uv_poll);
+
   cRbuvPoll = rb_define_class_under(mRbuv, "Poll", cRbuvHandle);
   rb_define_alloc_func(cRbuvPoll, rbuv_poll_alloc);
 
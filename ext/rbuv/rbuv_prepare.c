@@ -3,20 +3,40 @@
 struct rbuv_prepare_s {
   uv_prepare_t *uv_handle;
   VALUE cb_on_close;
+  uv_prepare_t uv_prepare;
   VALUE cb_on_prepare;
 };
 typedef struct rbuv_prepare_s rbuv_prepare_t;
 
 VALUE cRbuvPrepare;
 
+struct rbuv_prepare_on_prepare_arg_s {
+  uv_prepare_t *uv_prepare;
+};
+typedef struct rbuv_prepare_on_prepare_arg_s rbuv_prepare_on_prepare_arg_t;
+
 /* Allocator / Mark / Deallocator */
 static VALUE rbuv_prepare_alloc(VALUE klass);
 static void rbuv_prepare_mark(rbuv_prepare_t *rbuv_prepare);
 static void rbuv_prepare_free(rbuv_prepare_t *rbuv_prepare);
+static void rbuv_prepare_compact(rbuv_prepare_t *rbuv_prepare);
+static size_t rbuv_prepare_memsize(const rbuv_prepare_t *rbuv_prepare);
+
+static const rb_data_type_t rbuv_prepare_type = {
+  .wrap_struct_name = "rbuv_prepare",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_prepare_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_prepare_free,
+    .dsize = (size_t (*)(const void *))rbuv_prepare_memsize,
+    RBUV_DCOMPACT(rbuv_prepare_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_prepare_on_prepare(uv_prepare_t *uv_prepare);
-static void rbuv_prepare_on_prepare_no_gvl(uv_prepare_t *uv_prepare);
+static void rbuv_prepare_on_prepare_no_gvl(rbuv_prepare_on_prepare_arg_t *arg);
 
 VALUE rbuv_prepare_alloc(VALUE klass) {
   rbuv_prepare_t *rbuv_prepare;
@@ -25,8 +45,7 @@ VALUE rbuv_prepare_alloc(VALUE klass) {
   rbuv_handle_alloc((rbuv_handle_t *)rbuv_prepare);
   rbuv_prepare->cb_on_prepare = Qnil;
 
-  return Data_Wrap_Struct(klass, rbuv_prepare_mark, rbuv_prepare_free,
-                          rbuv_prepare);
+  return TypedData_Wrap_Struct(klass, &rbuv_prepare_type, rbuv_prepare);
 }
 
 void rbuv_prepare_mark(rbuv_prepare_t *rbuv_prepare) {
@@ -34,7 +53,7 @@ void rbuv_prepare_mark(rbuv_prepare_t *rbuv_prepare) {
   RBUV_DEBUG_LOG_DETAIL("rbuv_prepare: %p, uv_handle: %p",
                         rbuv_prepare, rbuv_prepare->uv_handle);
   rbuv_handle_mark((rbuv_handle_t *)rbuv_prepare);
-  rb_gc_mark(rbuv_prepare->cb_on_prepare);
+  rb_gc_mark_movable(rbuv_prepare->cb_on_prepare);
 }
 
 void rbuv_prepare_free(rbuv_prepare_t *rbuv_prepare) {
@@ -42,6 +61,15 @@ void rbuv_prepare_free(rbuv_prepare_t *rbuv_prepare) {
   rbuv_handle_free((rbuv_handle_t *)rbuv_prepare);
 }
 
+static void rbuv_prepare_compact(rbuv_prepare_t *rbuv_prepare) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_prepare);
+  RBUV_GC_UPDATE(rbuv_prepare->cb_on_prepare);
+}
+
+static size_t rbuv_prepare_memsize(const rbuv_prepare_t *rbuv_prepare) {
+  return sizeof(*rbuv_prepare);
+}
+
 /* @overload initialize(loop=nil)
  *   Creates a new prepare handle.
  *
@@ -60,16 +88,14 @@ static VALUE rbuv_prepare_initialize(int argc, VALUE *argv, VALUE self) {
     loop = rbuv_loop_s_default(cRbuvLoop);
   }
 
-  Data_Get_Struct(self, rbuv_prepare_t, rbuv_prepare);
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_prepare_t, &rbuv_prepare_type, rbuv_prepare);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
 
-  rbuv_prepare->uv_handle = malloc(sizeof(*rbuv_prepare->uv_handle));
-  uv_ret = uv_prepare_init(rbuv_loop->uv_handle, rbuv_prepare->uv_handle);
+  uv_ret = uv_prepare_init(rbuv_loop->uv_handle, &rbuv_prepare->uv_prepare);
   if (uv_ret < 0) {
-    free(rbuv_prepare->uv_handle);
-    rbuv_prepare->uv_handle = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   }
+  rbuv_prepare->uv_handle = &rbuv_prepare->uv_prepare;
   rbuv_prepare->uv_handle->data = (void *)self;
 
   return self;
@@ -119,22 +145,30 @@ static VALUE rbuv_prepare_stop(VALUE self) {
 }
 
 void rbuv_prepare_on_prepare(uv_prepare_t *uv_prepare) {
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)
-    rbuv_prepare_on_prepare_no_gvl, uv_prepare);
+  rbuv_prepare_on_prepare_arg_t arg = { .uv_prepare = uv_prepare };
+  rbuv_loop_defer(uv_prepare->loop, (VALUE)uv_prepare->data,
+                  (rbuv_loop_deferred_cb)rbuv_prepare_on_prepare_no_gvl, &arg, sizeof(arg));
 }
 
-void rbuv_prepare_on_prepare_no_gvl(uv_prepare_t *uv_prepare) {
+void rbuv_prepare_on_prepare_no_gvl(rbuv_prepare_on_prepare_arg_t *arg) {
+  uv_prepare_t *uv_prepare = arg->uv_prepare;
   VALUE prepare;
   VALUE error;
   rbuv_prepare_t *rbuv_prepare;
 
+  // a callback earlier in the batch may have stopped or closed it
+  if (!uv_is_active((uv_handle_t *)uv_prepare)) {
+    return;
+  }
   prepare = (VALUE)uv_prepare->data;
   Data_Get_Handle_Struct(prepare, struct rbuv_prepare_s, rbuv_prepare);
   error = Qnil;
-  rb_funcall(rbuv_prepare->cb_on_prepare, id_call, 2, prepare, error);
+  rbuv_call(rbuv_prepare->cb_on_prepare, 2, prepare, error);
 }
 
 void Init_rbuv_prepare() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_prepare_t, uv_prepare);
+
   cRbuvPrepare = rb_define_class_under(mRbuv, "Prepare", cRbuvHandle);
   rb_define_alloc_func(cRbuvPrepare, rbuv_prepare_alloc);
   rb_define_method(cRbuvPrepare, "initialize", rbuv_prepare_initialize, -1);
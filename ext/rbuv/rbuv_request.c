@@ -8,6 +8,12 @@
 
 VALUE cRbuvRequest;
 
+/* The parent of the types of all the requests */
+const rb_data_type_t rbuv_request_type = {
+  .wrap_struct_name = "rbuv_request",
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
 void rbuv_request_mark(rbuv_request_t *rbuv_request) {
 }
 
@@ -23,6 +29,57 @@ void rbuv_request_free(rbuv_request_t *rbuv_request) {
   free(rbuv_request);
 }
 
+void rbuv_request_link_init(rbuv_request_link_t *link) {
+  link->request = Qnil;
+  link->prev = NULL;
+  link->next = NULL;
+}
+
+void rbuv_request_link(rbuv_request_link_t **list, rbuv_request_link_t *link, VALUE request) {
+  link->request = request;
+  link->prev = NULL;
+  link->next = *list;
+  if (*list != NULL) {
+    (*list)->prev = link;
+  }
+  *list = link;
+}
+
+/*
+ * Unlinking a request which is not linked does nothing.
+ */
+void rbuv_request_unlink(rbuv_request_link_t **list, rbuv_request_link_t *link) {
+  if (link->request == Qnil) {
+    return;
+  }
+  if (link->prev != NULL) {
+    link->prev->next = link->next;
+  } else {
+    *list = link->next;
+  }
+  if (link->next != NULL) {
+    link->next->prev = link->prev;
+  }
+  rbuv_request_link_init(link);
+}
+
+void rbuv_request_list_mark(rbuv_request_link_t *list) {
+  for (; list != NULL; list = list->next) {
+    rb_gc_mark(list->request);
+  }
+}
+
+/*
+ * Returns the linked requests, oldest first.
+ */
+VALUE rbuv_request_list_to_a(rbuv_request_link_t *list) {
+  VALUE requests = rb_ary_new();
+  for (; list != NULL; list = list->next) {
+    rb_ary_push(requests, list->request);
+  }
+  return rb_ary_reverse(requests);
+}
+
 /*
  * Cancel a pending request. Fails if the request is executing or has finished executing.
  *
@@ -32,7 +89,7 @@ void rbuv_request_free(rbuv_request_t *rbuv_request) {
 static VALUE rbuv_request_cancel(VALUE self) {
   rbuv_request_t *rbuv_request;
 
-  Data_Get_Struct(self, rbuv_request_t, rbuv_request);
+  TypedData_Get_Struct(self, rbuv_request_t, &rbuv_request_type, rbuv_request);
   if (rbuv_request->uv_req == NULL) {
     rb_raise(eRbuvError, "This %s request is closed", rb_obj_classname(self));
   } else {
@@ -1,7 +1,23 @@
 #ifndef RBUV_REQUEST_H_
 #define RBUV_REQUEST_H_
 
+#include <ruby.h>
+
+/*
+ * Links a pending request to the stream or the loop it belongs to, which
+ * marks it. Linking and unlinking are O(1).
+ *
+ * Defined before rbuv.h is included, the requests embed it.
+ */
+typedef struct rbuv_request_link_s rbuv_request_link_t;
+struct rbuv_request_link_s {
+  VALUE request; /* Qnil when not linked */
+  rbuv_request_link_t *prev;
+  rbuv_request_link_t *next;
+};
+
 #include "rbuv.h"
+
 struct rbuv_request_s {
   uv_req_t *uv_req;
 };
@@ -9,10 +25,17 @@ struct rbuv_request_s {
 typedef struct rbuv_request_s rbuv_request_t;
 
 extern VALUE cRbuvRequest;
+extern const rb_data_type_t rbuv_request_type;
 
 void Init_rbuv_request();
 
 void rbuv_request_mark(rbuv_request_t *rbuv_request);
 void rbuv_request_free(rbuv_request_t *rbuv_request);
 
+void rbuv_request_link_init(rbuv_request_link_t *link);
+void rbuv_request_link(rbuv_request_link_t **list, rbuv_request_link_t *link, VALUE request);
+void rbuv_request_unlink(rbuv_request_link_t **list, rbuv_request_link_t *link);
+void rbuv_request_list_mark(rbuv_request_link_t *list);
+VALUE rbuv_request_list_to_a(rbuv_request_link_t *list);
+
 #endif  /* RBUV_REQUEST_H_ */
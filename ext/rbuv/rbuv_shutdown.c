@@ -2,21 +2,41 @@
 
 VALUE cRbuvStreamShutdownRequest;
 
+const rb_data_type_t rbuv_shutdown_type = {
+  .wrap_struct_name = "rbuv_shutdown",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_shutdown_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_shutdown_free,
+    .dsize = (size_t (*)(const void *))rbuv_shutdown_memsize,
+    RBUV_DCOMPACT(rbuv_shutdown_compact)
+  },
+  .parent = &rbuv_request_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
 void rbuv_shutdown_mark(rbuv_shutdown_t* rbuv_shutdown) {
   rbuv_request_mark((rbuv_request_t *)rbuv_shutdown);
-  rb_gc_mark(rbuv_shutdown->cb_on_shutdown);
+  rb_gc_mark_movable(rbuv_shutdown->cb_on_shutdown);
   if (rbuv_shutdown->uv_req != NULL) {
     rb_gc_mark((VALUE)rbuv_shutdown->uv_req->handle->data);
   }
 }
 
 void rbuv_shutdown_free(rbuv_shutdown_t* rbuv_shutdown) {
-  rbuv_request_free((rbuv_request_t *)rbuv_shutdown);
+  free(rbuv_shutdown);
+}
+
+void rbuv_shutdown_compact(rbuv_shutdown_t* rbuv_shutdown) {
+  RBUV_GC_UPDATE(rbuv_shutdown->cb_on_shutdown);
+}
+
+size_t rbuv_shutdown_memsize(const rbuv_shutdown_t* rbuv_shutdown) {
+  return sizeof(*rbuv_shutdown);
 }
 
 static VALUE rbuv_shutdown_get_handle(VALUE self) {
   rbuv_shutdown_t *rbuv_shutdown;
-  Data_Get_Struct(self, rbuv_shutdown_t, rbuv_shutdown);
+  TypedData_Get_Struct(self, rbuv_shutdown_t, &rbuv_shutdown_type, rbuv_shutdown);
   if (rbuv_shutdown->uv_req == NULL) {
     return Qnil;
   } else {
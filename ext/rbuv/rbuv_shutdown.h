@@ -4,14 +4,19 @@
 #include "rbuv.h"
 
 typedef struct {
-  uv_shutdown_t *uv_req;
+  uv_shutdown_t *uv_req; /* points to uv_shutdown while it is pending */
   VALUE cb_on_shutdown;
+  rbuv_request_link_t link; /* in the requests of the stream */
+  uv_shutdown_t uv_shutdown;
 } rbuv_shutdown_t;
 
 extern VALUE cRbuvStreamShutdownRequest;
+extern const rb_data_type_t rbuv_shutdown_type;
 
 void rbuv_shutdown_mark(rbuv_shutdown_t* rbuv_shutdown);
 void rbuv_shutdown_free(rbuv_shutdown_t* rbuv_shutdown);
+void rbuv_shutdown_compact(rbuv_shutdown_t* rbuv_shutdown);
+size_t rbuv_shutdown_memsize(const rbuv_shutdown_t* rbuv_shutdown);
 void Init_rbuv_shutdown();
 
 #endif  /* RBUV_SHUTDOWN_H_ */
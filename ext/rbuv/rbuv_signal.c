@@ -3,6 +3,7 @@
 struct rbuv_signal_s {
   uv_signal_t *uv_handle;
   VALUE cb_on_close;
+  uv_signal_t uv_signal;
   VALUE cb_on_signal;
 };
 typedef struct rbuv_signal_s rbuv_signal_t;
@@ -19,6 +20,20 @@ VALUE cRbuvSignal;
 static VALUE rbuv_signal_alloc(VALUE klass);
 static void rbuv_signal_mark(rbuv_signal_t *rbuv_signal);
 static void rbuv_signal_free(rbuv_signal_t *rbuv_signal);
+static void rbuv_signal_compact(rbuv_signal_t *rbuv_signal);
+static size_t rbuv_signal_memsize(const rbuv_signal_t *rbuv_signal);
+
+static const rb_data_type_t rbuv_signal_type = {
+  .wrap_struct_name = "rbuv_signal",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_signal_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_signal_free,
+    .dsize = (size_t (*)(const void *))rbuv_signal_memsize,
+    RBUV_DCOMPACT(rbuv_signal_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_signal_on_signal(uv_signal_t *uv_signal, int signum);
@@ -31,14 +46,14 @@ VALUE rbuv_signal_alloc(VALUE klass) {
   rbuv_handle_alloc((rbuv_handle_t *)rbuv_signal);
   rbuv_signal->cb_on_signal = Qnil;
 
-  return Data_Wrap_Struct(klass, rbuv_signal_mark, rbuv_signal_free, rbuv_signal);
+  return TypedData_Wrap_Struct(klass, &rbuv_signal_type, rbuv_signal);
 }
 
 void rbuv_signal_mark(rbuv_signal_t *rbuv_signal) {
   assert(rbuv_signal);
   RBUV_DEBUG_LOG_DETAIL("rbuv_signal: %p, uv_handle: %p", rbuv_signal, rbuv_signal->uv_handle);
   rbuv_handle_mark((rbuv_handle_t *)rbuv_signal);
-  rb_gc_mark(rbuv_signal->cb_on_signal);
+  rb_gc_mark_movable(rbuv_signal->cb_on_signal);
 }
 
 void rbuv_signal_free(rbuv_signal_t *rbuv_signal) {
@@ -46,6 +61,15 @@ void rbuv_signal_free(rbuv_signal_t *rbuv_signal) {
   rbuv_handle_free((rbuv_handle_t *)rbuv_signal);
 }
 
+static void rbuv_signal_compact(rbuv_signal_t *rbuv_signal) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_signal);
+  RBUV_GC_UPDATE(rbuv_signal->cb_on_signal);
+}
+
+static size_t rbuv_signal_memsize(const rbuv_signal_t *rbuv_signal) {
+  return sizeof(*rbuv_signal);
+}
+
 /* @overload initialize(loop=nil)
  *   Creates a new handle to watch for signals.
  *
@@ -64,15 +88,13 @@ static VALUE rbuv_signal_initialize(int argc, VALUE *argv, VALUE self) {
     loop = rbuv_loop_s_default(cRbuvLoop);
   }
 
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  Data_Get_Struct(self, rbuv_signal_t, rbuv_signal);
-  rbuv_signal->uv_handle = malloc(sizeof(*rbuv_signal->uv_handle));
-  uv_ret = uv_signal_init(rbuv_loop->uv_handle, rbuv_signal->uv_handle);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_signal_t, &rbuv_signal_type, rbuv_signal);
+  uv_ret = uv_signal_init(rbuv_loop->uv_handle, &rbuv_signal->uv_signal);
   if (uv_ret < 0) {
-    free(rbuv_signal->uv_handle);
-    rbuv_signal->uv_handle = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   }
+  rbuv_signal->uv_handle = &rbuv_signal->uv_signal;
   rbuv_signal->uv_handle->data = (void *)self;
 
   RBUV_DEBUG_LOG_DETAIL("rbuv_signal: %p, uv_handle: %p, signal: %s",
@@ -132,8 +154,9 @@ void rbuv_signal_on_signal(uv_signal_t *uv_signal, int signum) {
     .uv_signal = uv_signal,
     .signum = signum
   };
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)
-    rbuv_signal_on_signal_no_gvl, &reg);
+  rbuv_loop_defer(uv_signal->loop, (VALUE)uv_signal->data,
+                  (rbuv_loop_deferred_cb)rbuv_signal_on_signal_no_gvl,
+                  &reg, sizeof(reg));
 }
 
 void rbuv_signal_on_signal_no_gvl(rbuv_signal_on_signal_arg_t *arg) {
@@ -143,13 +166,19 @@ void rbuv_signal_on_signal_no_gvl(rbuv_signal_on_signal_arg_t *arg) {
   VALUE signal;
   rbuv_signal_t *rbuv_signal;
 
+  // a callback earlier in the batch may have stopped or closed it
+  if (!uv_is_active((uv_handle_t *)uv_signal)) {
+    return;
+  }
   signal = (VALUE)uv_signal->data;
   Data_Get_Handle_Struct(signal, struct rbuv_signal_s, rbuv_signal);
 
-  rb_funcall(rbuv_signal->cb_on_signal, id_call, 2, signal, INT2FIX(signum));
+  rbuv_call(rbuv_signal->cb_on_signal, 2, signal, INT2FIX(signum));
 }
 
 void Init_rbuv_signal() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_signal_t, uv_signal);
+
   cRbuvSignal = rb_define_class_under(mRbuv, "Signal", cRbuvHandle);
   rb_define_alloc_func(cRbuvSignal, rbuv_signal_alloc);
 
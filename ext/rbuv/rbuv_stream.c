@@ -1,13 +1,11 @@
 #include "rbuv_stream.h"
 
-struct rbuv_stream_s {
-  uv_stream_t *uv_handle;
-  VALUE cb_on_close;
-  VALUE cb_on_connection;
-  VALUE cb_on_read;
-  VALUE requests;
-};
-typedef struct rbuv_stream_s rbuv_stream_t;
+#ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
 
 typedef struct {
   uv_stream_t *uv_stream;
@@ -22,7 +20,10 @@ typedef struct {
 typedef struct {
   uv_stream_t *uv_stream;
   ssize_t nread;
-  char *base;
+  uv_buf_t buf;
+  VALUE buffer;
+  int handles; /* handles received with the data, for read2_start */
+  unsigned int generation; /* the read_generation of the stream */
 } rbuv_stream_on_read_arg_t;
 
 typedef struct {
@@ -30,18 +31,170 @@ typedef struct {
   int status;
 } rbuv_stream_on_write_arg_t;
 
+typedef struct {
+  uv_stream_t *uv_stream;
+  rbuv_stream_pipe_t *pipe;
+  int status;
+} rbuv_stream_on_pipe_end_arg_t;
+
+/* A read buffer which is written to the target of a pipe as it is */
+typedef struct {
+  uv_write_t uv_write;
+  rbuv_stream_pipe_t *pipe;
+  char data[RBUV_PIPE_CHUNK_SIZE];
+} rbuv_stream_pipe_chunk_t;
+
 VALUE cRbuvStream;
 
+static ID id_on_data;
+static ID id_on_eof;
+static ID id_on_error;
+
+/* The parent of the types of all the streams */
+const rb_data_type_t rbuv_stream_type = {
+  .wrap_struct_name = "rbuv_stream",
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
 /* Private methods */
 static void rbuv_alloc_buffer(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
 static void rbuv_stream_on_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t* buf);
 static void rbuv_stream_on_read_no_gvl(rbuv_stream_on_read_arg_t *arg);
+static void rbuv_alloc_read_into(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
+static void rbuv_stream_on_read_into(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t* buf);
+static void rbuv_stream_on_read_into_no_gvl(rbuv_stream_on_read_arg_t *arg);
+static void rbuv_alloc_frames(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
+static void rbuv_stream_on_read_frames(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t* buf);
+static void rbuv_stream_on_read_frames_no_gvl(rbuv_stream_on_read_arg_t *arg);
+static void rbuv_alloc_pipe_chunk(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
+static void rbuv_stream_on_pipe_read(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t* buf);
+static void rbuv_stream_on_pipe_write(uv_write_t *uv_req, int status);
+static void rbuv_stream_pipe_end(uv_stream_t *uv_stream, rbuv_stream_pipe_t *pipe, int status);
+static void rbuv_stream_on_pipe_end_no_gvl(rbuv_stream_on_pipe_end_arg_t *arg);
+static void rbuv_stream_pipe_release(rbuv_stream_pipe_t *pipe);
+static void rbuv_stream_release_reader(rbuv_stream_t *rbuv_stream);
+static VALUE rbuv_stream_read_error(ssize_t nread);
+static VALUE rbuv_stream_read_callback(int argc, VALUE *argv, VALUE *options, int *read_handler);
+static void rbuv_stream_dispatch_read(rbuv_stream_t *rbuv_stream, VALUE data,
+                                      ssize_t status, VALUE error);
+static VALUE rbuv_stream_accept_handles(rbuv_stream_t *rbuv_stream, int count);
+static int rbuv_stream_read_is_current(rbuv_stream_t *rbuv_stream,
+                                       rbuv_stream_on_read_arg_t *arg);
 static void rbuv_stream_on_write(uv_write_t *req, int status);
 static void rbuv_stream_on_write_no_gvl(rbuv_stream_on_write_arg_t *arg);
 static void rbuv_stream_on_connection(uv_stream_t *uv_stream, int status);
 static void rbuv_stream_on_connection_no_gvl(rbuv_stream_on_connection_arg_t *arg);
+static VALUE rbuv_stream_accept_batch(VALUE stream, rbuv_stream_t *rbuv_server,
+                                      VALUE *error);
+static int rbuv_stream_accept_pending(VALUE stream, rbuv_stream_t *rbuv_server,
+                                      VALUE *client);
 static void rbuv_stream_on_shutdown(uv_shutdown_t *uv_req, int status);
 static void rbuv_stream_on_shutdown_no_gvl(rbuv_stream_on_shutdown_arg_t *uv_stream);
+static rbuv_buffer_pool_t *rbuv_stream_get_read_buffers(uv_stream_t *uv_stream);
+static unsigned int rbuv_stream_check_data(VALUE data);
+static VALUE rbuv_stream_queue_write(rbuv_stream_t *rbuv_stream, VALUE data,
+                                     VALUE send_handle, uv_stream_t *uv_send_handle,
+                                     unsigned int nbufs, size_t offset,
+                                     VALUE cb_on_write);
+static void rbuv_stream_track_write(rbuv_stream_t *rbuv_stream, rbuv_write_t *rbuv_write);
+static void rbuv_stream_forget_write(rbuv_stream_t *rbuv_stream, rbuv_write_t *rbuv_write);
+static void rbuv_stream_report_error(VALUE stream, int status);
+static void rbuv_stream_cork_append(VALUE stream, rbuv_stream_t *rbuv_stream,
+                                    VALUE data, unsigned int nbufs);
+static int rbuv_stream_flush_cork(rbuv_stream_t *rbuv_stream);
+static void rbuv_stream_flush_cork_or_raise(rbuv_stream_t *rbuv_stream);
+static size_t rbuv_stream_queued(rbuv_stream_t *rbuv_stream);
+static void rbuv_stream_check_high_watermark(rbuv_stream_t *rbuv_stream);
+static void rbuv_stream_check_low_watermark(VALUE stream, rbuv_stream_t *rbuv_stream);
+
+void rbuv_stream_alloc(rbuv_stream_t *rbuv_stream) {
+  rbuv_handle_alloc((rbuv_handle_t *)rbuv_stream);
+  rbuv_stream->cb_on_connection = Qnil;
+  rbuv_stream->cb_on_read = Qnil;
+  rbuv_stream->requests = NULL;
+  rbuv_stream->read_buffer = Qnil;
+  rbuv_stream->cb_on_error = Qnil;
+  rbuv_stream->writes = NULL;
+  rbuv_stream->cork = RBUV_CORK_OFF;
+  rbuv_stream->cork_queued = 0;
+  rbuv_stream->cork_buf = NULL;
+  rbuv_stream->cork_len = 0;
+  rbuv_stream->cork_capa = 0;
+  rbuv_stream->high_watermark = RBUV_WRITE_HIGH_WATERMARK;
+  rbuv_stream->low_watermark = RBUV_WRITE_LOW_WATERMARK;
+  rbuv_stream->needs_drain = 0;
+  rbuv_stream->cb_on_drain = Qnil;
+  rbuv_stream->read_into = NULL;
+  rbuv_stream->framer = NULL;
+  rbuv_stream->pipe = NULL;
+  rbuv_stream->read_handler = 0;
+  rbuv_stream->accept_limit = 0;
+  rbuv_stream->handles_counted = 0;
+  rbuv_stream->read_generation = 0;
+}
+
+void rbuv_stream_mark(rbuv_stream_t *rbuv_stream) {
+  rbuv_write_t *rbuv_write;
+
+  rbuv_handle_mark((rbuv_handle_t *)rbuv_stream);
+  rb_gc_mark_movable(rbuv_stream->cb_on_connection);
+  rb_gc_mark_movable(rbuv_stream->cb_on_read);
+  rbuv_request_list_mark(rbuv_stream->requests);
+  rb_gc_mark(rbuv_stream->read_buffer);
+  rb_gc_mark_movable(rbuv_stream->cb_on_error);
+  rb_gc_mark_movable(rbuv_stream->cb_on_drain);
+  if (rbuv_stream->read_into != NULL) {
+    rb_gc_mark(rbuv_stream->read_into->buffer);
+  }
+  if (rbuv_stream->pipe != NULL) {
+    rb_gc_mark(rbuv_stream->pipe->target);
+  }
+  for (rbuv_write = rbuv_stream->writes; rbuv_write != NULL; rbuv_write = rbuv_write->next) {
+    rbuv_write_mark_data(rbuv_write);
+  }
+}
+
+void rbuv_stream_compact(rbuv_stream_t *rbuv_stream) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_stream);
+  RBUV_GC_UPDATE(rbuv_stream->cb_on_connection);
+  RBUV_GC_UPDATE(rbuv_stream->cb_on_read);
+  RBUV_GC_UPDATE(rbuv_stream->cb_on_error);
+  RBUV_GC_UPDATE(rbuv_stream->cb_on_drain);
+}
+
+/*
+ * The memory a stream uses besides its struct: the cork buffer, the pending
+ * block-less writes and what read_start(buffer:), read_frames or pipe_to use.
+ */
+size_t rbuv_stream_memsize(const rbuv_stream_t *rbuv_stream) {
+  size_t size = rbuv_stream->cork_capa;
+  rbuv_write_t *rbuv_write;
+
+  for (rbuv_write = rbuv_stream->writes; rbuv_write != NULL; rbuv_write = rbuv_write->next) {
+    size += rbuv_write_memsize(rbuv_write);
+  }
+  if (rbuv_stream->read_into != NULL) {
+    size += sizeof(*rbuv_stream->read_into);
+  }
+  size += rbuv_framer_memsize(rbuv_stream->framer);
+  if (rbuv_stream->pipe != NULL) {
+    size += sizeof(*rbuv_stream->pipe) +
+            rbuv_stream->pipe->writes * sizeof(rbuv_stream_pipe_chunk_t);
+  }
+  return size;
+}
+
+void rbuv_stream_free(rbuv_stream_t *rbuv_stream) {
+  rbuv_write_copy_free(rbuv_stream->cork_buf, rbuv_stream->cork_capa);
+  // the buffer may be gone already, it cannot be unlocked from here
+  free(rbuv_stream->read_into);
+  rbuv_framer_free(rbuv_stream->framer);
+  if (rbuv_stream->pipe != NULL) {
+    rbuv_stream_pipe_release(rbuv_stream->pipe);
+  }
+  rbuv_handle_free((rbuv_handle_t *)rbuv_stream);
+}
 
 /* @overload listen(backlog)
  *   Listen for incomining connections
@@ -51,14 +204,77 @@ static void rbuv_stream_on_shutdown_no_gvl(rbuv_stream_on_shutdown_arg_t *uv_str
  *   @yieldparam stream [self]
  *   @yieldparam error [Rbuv::Error, nil]
  *   @return [self] itself
+ * @overload listen(backlog, batch:)
+ *   Listen for incomining connections and accept them in batches: every
+ *   connection pending when the block is due is accepted into a new stream of
+ *   the same class, they are all yielded at once.
+ *
+ *   @example
+ *     server.listen(128, batch: 64) do |clients, error|
+ *       clients.each { |client| client.read_start(Connection.new(client)) }
+ *     end
+ *   @param backlog [Number]
+ *   @param batch [true, Integer] +true+ to accept every pending connection,
+ *     or the most connections accepted per loop iteration. The others are
+ *     accepted on the next iterations, so that other handles get their turn.
+ *   @yield callback
+ *   @yieldparam clients [Array<Rbuv::Stream>, nil] the accepted streams or
+ *     +nil+ if the operation has not succeded
+ *   @yieldparam error [Rbuv::Error, nil]
+ *   @return [self] itself
+ * @overload listen(backlog, fastopen:)
+ *   Listen for incoming connections on a {Rbuv::Tcp} which accepts TCP Fast
+ *   Open: clients which connected before get a cookie and send their first
+ *   data in the SYN, see {Rbuv::Tcp#connect}. Can be combined with +batch:+.
+ *
+ *   @note On Linux the +net.ipv4.tcp_fastopen+ sysctl must have bit 2 set
+ *     for servers, bit 1 for clients.
+ *   @param backlog [Number]
+ *   @param fastopen [true, Integer] +true+ or the most connections waiting
+ *     for their handshake to finish, +true+ means +backlog+
+ *   @raise [Rbuv::Error::ENOTSUP] if the platform does not support it
+ *   @raise [Rbuv::Error::EINVAL] if the stream is not a {Rbuv::Tcp}
+ *   @raise [Rbuv::Error::EBADF] if the stream is not bound yet
+ *   @yield (see #listen)
+ *   @return [self] itself
  */
-static VALUE rbuv_stream_listen(VALUE self, VALUE backlog) {
+static VALUE rbuv_stream_listen(int argc, VALUE *argv, VALUE self) {
+  VALUE backlog;
+  VALUE options;
+  VALUE batch;
+  VALUE fastopen;
   rbuv_stream_t *rbuv_server;
   int uv_backlog;
+  unsigned int accept_limit;
+  int fastopen_qlen;
+
+  rb_scan_args(argc, argv, "1:", &backlog, &options);
+  batch = NIL_P(options) ? Qnil : rb_hash_aref(options, ID2SYM(rb_intern("batch")));
+  fastopen = NIL_P(options) ? Qnil : rb_hash_aref(options, ID2SYM(rb_intern("fastopen")));
+  if (batch == Qtrue) {
+    accept_limit = RBUV_ACCEPT_UNLIMITED;
+  } else if (!RTEST(batch)) {
+    accept_limit = 0;
+  } else {
+    accept_limit = NUM2UINT(batch);
+    if (accept_limit == 0) {
+      rb_raise(rb_eArgError, "batch must be positive");
+    }
+  }
 
   rb_need_block();
   Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_server);
   uv_backlog = FIX2INT(backlog);
+  // the options are all applied before listening, a failure leaves the
+  // stream as it was
+  if (RTEST(fastopen)) {
+    if (rbuv_server->uv_handle->type != UV_TCP) {
+      rbuv_error_raise(UV_EINVAL);
+    }
+    fastopen_qlen = fastopen == Qtrue ? uv_backlog : NUM2INT(fastopen);
+    RBUV_CHECK_UV_RETURN(rbuv_tcp_fastopen_listen((uv_tcp_t *)rbuv_server->uv_handle,
+                                                  fastopen_qlen));
+  }
 
   RBUV_DEBUG_LOG_DETAIL("self: %s, backlog: %d, rbuv_server: %p, "
                         "uv_handle: %p, rbuv_stream_on_connection: %p",
@@ -69,6 +285,7 @@ static VALUE rbuv_stream_listen(VALUE self, VALUE backlog) {
                         rbuv_stream_on_connection);
   RBUV_CHECK_UV_RETURN(uv_listen(rbuv_server->uv_handle, uv_backlog, rbuv_stream_on_connection));
   rbuv_server->cb_on_connection = rb_block_proc();
+  rbuv_server->accept_limit = accept_limit;
 
   return self;
 }
@@ -139,21 +356,21 @@ static VALUE rbuv_stream_shutdown(VALUE self) {
 
   rb_need_block();
   Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  rbuv_stream_flush_cork_or_raise(rbuv_stream);
 
   rbuv_shutdown = malloc(sizeof(*rbuv_shutdown));
-  rbuv_shutdown->uv_req = malloc(sizeof(*rbuv_shutdown->uv_req));
+  rbuv_shutdown->uv_req = &rbuv_shutdown->uv_shutdown;
   rbuv_shutdown->cb_on_shutdown = rb_block_proc();
+  rbuv_request_link_init(&rbuv_shutdown->link);
   uv_ret = uv_shutdown(rbuv_shutdown->uv_req, rbuv_stream->uv_handle, rbuv_stream_on_shutdown);
   if (uv_ret < 0) {
-    free(rbuv_shutdown->uv_req);
-    rbuv_shutdown->uv_req = NULL;
     free(rbuv_shutdown);
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
     return Qnil;
   } else {
-    VALUE request = Data_Wrap_Struct(cRbuvStreamShutdownRequest, rbuv_shutdown_mark, rbuv_shutdown_free, rbuv_shutdown);
+    VALUE request = TypedData_Wrap_Struct(cRbuvStreamShutdownRequest, &rbuv_shutdown_type, rbuv_shutdown);
     rbuv_shutdown->uv_req->data = (void *)request;
-    rb_ary_push(rbuv_stream->requests, request);
+    rbuv_request_link(&rbuv_stream->requests, &rbuv_shutdown->link, request);
     return request;
   }
 }
@@ -161,16 +378,99 @@ static VALUE rbuv_stream_shutdown(VALUE self) {
 /*
  * Read data from an incoming stream.
  *
- * @yield The block will be called made several times until there is no more
- *   data to read or {#read_stop} is called. When we've reached EOF, +error+
- *   will be set to an instance of +EOFError+.
- * @yieldparam data [String, nil] the readed data or +nil+ if the operation has
+ * @overload read_start
+ *   @yield The block will be called made several times until there is no more
+ *     data to read or {#read_stop} is called. When we've reached EOF, +error+
+ *     will be set to an instance of +EOFError+.
+ *   @yieldparam data [String, nil] the readed data or +nil+ if the operation
+ *     has not succeded
+ *   @yieldparam error [Rbuv::Error, EOFError, nil] an Error or +nil+ if the
+ *     operation has succeded
+ * @overload read_start(buffer: buffer)
+ *   Read straight into +buffer+ instead of allocating a String for each read.
+ *   The data is always at the start of +buffer+ and stays there until the
+ *   block returns, then the next read overwrites it. A String buffer is as
+ *   long as the data when the block is called. The buffer is locked until
+ *   {#read_stop} is called, EOF is reached or the stream is closed. Reading
+ *   pauses whenever the buffer is full.
+ *   @example
+ *     buffer = String.new(capacity: 65536)
+ *     stream.read_start(buffer: buffer) do |nread, error|
+ *       parser << buffer if nread
+ *     end
+ *   @param buffer [String, IO::Buffer] a mutable buffer with some capacity
+ *   @yieldparam nread [Number, nil] how many bytes were read into +buffer+ or
+ *     +nil+ if the operation has not succeded
+ *   @yieldparam error [Rbuv::Error, EOFError, nil] an Error or +nil+ if the
+ *     operation has succeded
+ * @overload read_start(handler, buffer: nil)
+ *   Give the reads to the methods of +handler+ instead of a block, the methods
+ *   are called without going through a Proc.
+ *   @example
+ *     class Connection
+ *       def on_data(data) @parser << data end
+ *       def on_eof; @stream.close end
+ *       def on_error(error) @stream.close end
+ *     end
+ *     stream.read_start(connection)
+ *   @param handler [#on_data] +on_data(data)+ receives what the block would
+ *     get as +data+ or +nread+, +on_eof+ and +on_error(error)+ are called
+ *     when +handler+ responds to them
+ *   @param buffer [String, IO::Buffer, nil] as above
+ * @return [self] itself
+ */
+static VALUE rbuv_stream_read_start(int argc, VALUE *argv, VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+  VALUE options;
+  VALUE buffer;
+  VALUE callback;
+  int read_handler;
+  rbuv_read_into_t *read_into;
+
+  callback = rbuv_stream_read_callback(argc, argv, &options, &read_handler);
+  buffer = NIL_P(options) ? Qnil : rb_hash_aref(options, ID2SYM(rb_intern("buffer")));
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  read_into = buffer == Qnil ? NULL : rbuv_read_into_new(buffer);
+  uv_read_stop(rbuv_stream->uv_handle);
+  rbuv_stream_release_reader(rbuv_stream);
+  rbuv_stream->cb_on_read = callback;
+  rbuv_stream->read_handler = read_handler;
+
+  if (read_into != NULL) {
+    rbuv_stream->read_into = read_into;
+    uv_read_start(rbuv_stream->uv_handle, rbuv_alloc_read_into, rbuv_stream_on_read_into);
+  } else {
+    rbuv_buffer_pool_fill(rbuv_stream_get_read_buffers(rbuv_stream->uv_handle));
+    uv_read_start(rbuv_stream->uv_handle, rbuv_alloc_buffer, rbuv_stream_on_read);
+  }
+
+  return self;
+}
+
+/*
+ * Read data and handles from an IPC {Rbuv::Pipe}, the handles sent by
+ * {#write2} at the other end.
+ *
+ * @example A worker serving the connections handed by its parent
+ *   channel.read2_start do |data, handles, error|
+ *     if error
+ *       channel.close
+ *     else
+ *       handles.each { |client| client.read_start(Connection.new(client)) }
+ *     end
+ *   end
+ * @yield Calls the block with the data read and the handles received with it
+ * @yieldparam data [String, nil] the data read or +nil+ if the operation has
  *   not succeded
+ * @yieldparam handles [Array<Rbuv::Tcp, Rbuv::Pipe>, nil] the handles
+ *   received, they are associated with the loop of this pipe
  * @yieldparam error [Rbuv::Error, EOFError, nil] an Error or +nil+ if the
  *   operation has succeded
+ * @raise [Rbuv::Error::EINVAL] if this stream is not an IPC pipe
  * @return [self] itself
  */
-static VALUE rbuv_stream_read_start(VALUE self) {
+static VALUE rbuv_stream_read2_start(VALUE self) {
   rbuv_stream_t *rbuv_stream;
   VALUE block;
 
@@ -178,13 +478,142 @@ static VALUE rbuv_stream_read_start(VALUE self) {
   block = rb_block_proc();
 
   Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  if (rbuv_stream->uv_handle->type != UV_NAMED_PIPE ||
+      !((uv_pipe_t *)rbuv_stream->uv_handle)->ipc) {
+    rbuv_error_raise(UV_EINVAL);
+  }
+  uv_read_stop(rbuv_stream->uv_handle);
+  rbuv_stream_release_reader(rbuv_stream);
   rbuv_stream->cb_on_read = block;
+  rbuv_stream->read_handler = RBUV_READ_HANDLES;
 
+  rbuv_buffer_pool_fill(rbuv_stream_get_read_buffers(rbuv_stream->uv_handle));
   uv_read_start(rbuv_stream->uv_handle, rbuv_alloc_buffer, rbuv_stream_on_read);
 
   return self;
 }
 
+/*
+ * Read messages from an incoming stream.
+ *
+ * The data is buffered in C and split into frames, only whole frames are
+ * yielded. All the frames read since the last call are yielded together.
+ *
+ * @overload read_frames(delimiter:, max_frame_size: 1048576)
+ *   Frames end with +delimiter+, which is not part of them. When EOF is
+ *   reached, the data after the last delimiter is yielded as a last frame.
+ *   @example
+ *     stream.read_frames(delimiter: "\r\n") do |lines, error|
+ *       lines.each { |line| handle_command(line) } if lines
+ *     end
+ * @overload read_frames(length_prefix:, endian: :big, max_frame_size: 1048576)
+ *   Frames start with their length as an unsigned integer of +length_prefix+
+ *   bytes, which is not part of them.
+ *   @param length_prefix [1, 2, 4] the size of the length
+ *   @param endian [:big, :little] the byte order of the length
+ * @param delimiter [String] the data separating frames
+ * @param max_frame_size [Number] a larger frame is yielded as an
+ *   +Rbuv::Error::EMSGSIZE+ error and reading stops
+ * @yield The block will be called made several times until there is no more
+ *   data to read or {#read_stop} is called. When we've reached EOF, +error+
+ *   will be set to an instance of +EOFError+.
+ * @overload read_frames(handler, **options)
+ *   Give the frames to a handler as {#read_start} does.
+ * @yieldparam frames [Array<String>, nil] the frames read or +nil+ if the
+ *   operation has not succeded
+ * @yieldparam error [Rbuv::Error, EOFError, nil] an Error or +nil+ if the
+ *   operation has succeded
+ * @return [self] itself
+ */
+static VALUE rbuv_stream_read_frames(int argc, VALUE *argv, VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+  VALUE options;
+  VALUE callback;
+  int read_handler;
+  rbuv_framer_t *framer;
+
+  callback = rbuv_stream_read_callback(argc, argv, &options, &read_handler);
+  if (NIL_P(options)) {
+    rb_raise(rb_eArgError, "either delimiter or length_prefix must be given");
+  }
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  framer = rbuv_framer_new(options);
+  uv_read_stop(rbuv_stream->uv_handle);
+  rbuv_stream_release_reader(rbuv_stream);
+  rbuv_stream->cb_on_read = callback;
+  rbuv_stream->read_handler = read_handler;
+  rbuv_stream->framer = framer;
+  uv_read_start(rbuv_stream->uv_handle, rbuv_alloc_frames, rbuv_stream_on_read_frames);
+
+  return self;
+}
+
+/*
+ * Forward everything read from this stream to +target+.
+ *
+ * The data never reaches Ruby: every chunk read is written to +target+ from
+ * the same memory, in C. Reading pauses while more than +high_water+ bytes
+ * wait to be written to +target+ and resumes when half of them are written.
+ * Like a write without a block, the data is written in order with the other
+ * writes to +target+.
+ *
+ * When EOF is reached the chunks read may still be queued to +target+, use
+ * {#shutdown} on +target+ rather than {#close} so they are written. Calling
+ * {#read_stop}, {#read_start} or {#read_frames} stops forwarding.
+ *
+ * @example A TCP proxy
+ *   client.pipe_to(upstream) { |error| upstream.shutdown }
+ *   upstream.pipe_to(client) { |error| client.shutdown }
+ * @overload pipe_to(target, high_water: 65536)
+ *   @param target [Rbuv::Stream] the stream the data is written to
+ *   @param high_water [Number] how many bytes can wait to be written to
+ *     +target+ before reading pauses
+ *   @yield The block is called once, when EOF is reached or either stream
+ *     fails.
+ *   @yieldparam error [Rbuv::Error, nil] the error or +nil+ at EOF
+ *   @return [self] itself
+ */
+static VALUE rbuv_stream_pipe_to(int argc, VALUE *argv, VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+  rbuv_stream_t *rbuv_target;
+  VALUE target;
+  VALUE options;
+  VALUE high_water;
+  VALUE block;
+  size_t high_water_size;
+  rbuv_stream_pipe_t *pipe;
+
+  rb_scan_args(argc, argv, "1:&", &target, &options, &block);
+  if (!RTEST(rb_obj_is_kind_of(target, cRbuvStream))) {
+    rb_raise(rb_eTypeError, "not valid value, should be a Rbuv::Stream");
+  }
+  high_water = NIL_P(options) ? Qnil : rb_hash_aref(options, ID2SYM(rb_intern("high_water")));
+  high_water_size = NIL_P(high_water) ? RBUV_WRITE_HIGH_WATERMARK : NUM2SIZET(high_water);
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  Data_Get_Handle_Struct(target, rbuv_stream_t, rbuv_target);
+  // data corked before the pipe is written first
+  rbuv_stream_flush_cork_or_raise(rbuv_target);
+
+  pipe = malloc(sizeof(*pipe));
+  pipe->source = rbuv_stream->uv_handle;
+  pipe->target = target;
+  pipe->high_water = high_water_size;
+  pipe->paused = 0;
+  pipe->stopped = 0;
+  pipe->writes = 0;
+
+  uv_read_stop(rbuv_stream->uv_handle);
+  rbuv_stream_release_reader(rbuv_stream);
+  rbuv_stream->cb_on_read = block;
+  rbuv_stream->read_handler = 0;
+  rbuv_stream->pipe = pipe;
+  uv_read_start(rbuv_stream->uv_handle, rbuv_alloc_pipe_chunk, rbuv_stream_on_pipe_read);
+
+  return self;
+}
+
 /* Stop reading data
  * @return [self] itself
  */
@@ -194,33 +623,41 @@ static VALUE rbuv_stream_read_stop(VALUE self) {
   Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
 
   uv_read_stop(rbuv_stream->uv_handle);
+  rbuv_stream_release_reader(rbuv_stream);
 
   return self;
 }
 
 /* @overload write(data)
  *   Write data to stream. Buffers are written in order.
+ *
+ *   An Array of Strings is written with a single request, the kernel sees
+ *   them as one vectored write.
  *   @example
  *     stream.write("12") do |error| ... end
  *     stream.write("34") do |error|
  *       # if no error has happend
  *       # "1234" has been written to this stream
  *     end
+ *     stream.write(["HTTP/1.1 200 OK\r\n", headers, body]) do |error| ... end
+ *   @param data [String, IO::Buffer, Array<String, IO::Buffer>] the data to write
  *   @yield The block is called when the write operation has finished
  *   @yieldparam error [Rbuv::Error, nil] an error if the operation has failed,
  *     otherwise +nil+
  *   @return [Rbuv::Stream::WriteRequest] itself
+ *
+ * @overload write(data)
+ *   Write data to stream without a callback. No Ruby object is allocated,
+ *   frozen Strings are written from their own memory and other Strings are
+ *   copied. Errors are passed to the {#on_error} block.
+ *   @param data [String, IO::Buffer, Array<String, IO::Buffer>] the data to write
+ *   @return [self] itself
  */
 VALUE rbuv_stream_write(VALUE self, VALUE data) {
   rbuv_stream_t *rbuv_stream;
-  rbuv_write_t *rbuv_write;
-  int uv_ret;
+  unsigned int nbufs;
 
-  if (TYPE(data) != T_STRING) {
-    rb_raise(rb_eTypeError, "not valid value, should be a String");
-    return Qnil;
-  }
-  rb_need_block();
+  nbufs = rbuv_stream_check_data(data);
 
   Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
 
@@ -229,217 +666,1312 @@ VALUE rbuv_stream_write(VALUE self, VALUE data) {
                         rbuv_stream,
                         rbuv_stream->uv_handle);
 
-  rbuv_write = malloc(sizeof(*rbuv_write));
-  rbuv_write->uv_req = malloc(sizeof(*rbuv_write->uv_req));
-  rbuv_write->uv_buf = uv_buf_init((char *)malloc(sizeof(char) * RSTRING_LEN(data)), (unsigned int)RSTRING_LEN(data));
-  rbuv_write->cb_on_write = rb_block_proc();
-  memcpy(rbuv_write->uv_buf.base, RSTRING_PTR(data), RSTRING_LEN(data));
-  uv_ret = uv_write(rbuv_write->uv_req, rbuv_stream->uv_handle, &rbuv_write->uv_buf, 1, rbuv_stream_on_write);
-  if (uv_ret < 0) {
-    free(rbuv_write->uv_buf.base);
-    rbuv_write->uv_buf.base = NULL;
-    free(rbuv_write->uv_req);
-    rbuv_write->uv_req = NULL;
-    free(rbuv_write);
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
-    return Qnil;
-  } else {
-    VALUE request = Data_Wrap_Struct(cRbuvStreamWriteRequest, rbuv_write_mark, rbuv_write_free, rbuv_write);
-    rbuv_write->uv_req->data = (void *)request;
-    rb_ary_push(rbuv_stream->requests, request);
+  if (rb_block_given_p()) {
+    VALUE request;
+    rbuv_stream_flush_cork_or_raise(rbuv_stream);
+    request = rbuv_stream_queue_write(rbuv_stream, data, Qnil, NULL, nbufs, 0, rb_block_proc());
+    rbuv_stream_check_high_watermark(rbuv_stream);
     return request;
+  } else if (rbuv_stream->cork != RBUV_CORK_OFF) {
+    rbuv_stream_cork_append(self, rbuv_stream, data, nbufs);
+  } else {
+    rbuv_stream_queue_write(rbuv_stream, data, Qnil, NULL, nbufs, 0, Qnil);
   }
+  rbuv_stream_check_high_watermark(rbuv_stream);
+  return self;
 }
 
-void rbuv_stream_on_connection(uv_stream_t *uv_stream, int status) {
-  rbuv_stream_on_connection_arg_t arg = {
-    .uv_stream = uv_stream,
-    .status = status
-  };
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)
-                          rbuv_stream_on_connection_no_gvl, &arg);
-}
-
-void rbuv_stream_on_connection_no_gvl(rbuv_stream_on_connection_arg_t *arg) {
-  uv_stream_t *uv_stream = arg->uv_stream;
-  int status = arg->status;
-  VALUE stream;
+/* @overload write2(data, handle)
+ *   Write data to an IPC pipe along with a handle, the process at the other
+ *   end receives a copy of the handle with {#read2_start}. Corked data is
+ *   written first.
+ *   @example Hand an accepted connection to a worker
+ *     server.listen(128) do
+ *       client = server.accept
+ *       worker.write2("c", client) { client.close }
+ *     end
+ *   @param data [String, IO::Buffer, Array<String, IO::Buffer>] the data to
+ *     write, it can not be empty
+ *   @param handle [Rbuv::Tcp, Rbuv::Pipe] the handle to send, it must stay
+ *     open until the block is called
+ *   @yield (see #write)
+ *   @yieldparam (see #write)
+ *   @return [Rbuv::Stream::WriteRequest, self] a request when a block is
+ *     given, otherwise itself
+ */
+static VALUE rbuv_stream_write2(VALUE self, VALUE data, VALUE handle) {
   rbuv_stream_t *rbuv_stream;
-  VALUE on_connection;
-  VALUE error;
-
-  RBUV_DEBUG_LOG("uv_stream: %p, status: %d", uv_stream, status);
-
-  stream = (VALUE)uv_stream->data;
-  Data_Get_Handle_Struct(stream, rbuv_stream_t, rbuv_stream);
-  on_connection = rbuv_stream->cb_on_connection;
-
-  RBUV_DEBUG_LOG_DETAIL("stream: %s, on_connection: %s",
-                        RSTRING_PTR(rb_inspect(stream)),
-                        RSTRING_PTR(rb_inspect(on_connection)));
+  rbuv_stream_t *rbuv_handle;
+  unsigned int nbufs;
+  VALUE request;
 
-  if (status < 0) {
-    RBUV_DEBUG_LOG_DETAIL("uv_stream: %p, status: %d, error: %s", uv_stream, status,
-                          uv_strerror(status));
-    error = rb_exc_new2(eRbuvError, uv_strerror(status));
-  } else {
-    error = Qnil;
+  nbufs = rbuv_stream_check_data(data);
+  if (!RTEST(rb_obj_is_kind_of(handle, cRbuvStream))) {
+    rb_raise(rb_eTypeError, "not valid value, should be a Rbuv::Stream");
   }
-  rb_funcall(on_connection, id_call, 2, stream, error);
-}
+  Data_Get_Handle_Struct(handle, rbuv_stream_t, rbuv_handle);
 
-void rbuv_alloc_buffer(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
-  buf->base = malloc(suggested_size);
-  buf->len = suggested_size;
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  rbuv_stream_flush_cork_or_raise(rbuv_stream);
+  request = rbuv_stream_queue_write(rbuv_stream, data, handle, rbuv_handle->uv_handle,
+                                    nbufs, 0, rb_block_given_p() ? rb_block_proc() : Qnil);
+  rbuv_stream_check_high_watermark(rbuv_stream);
+  return request == Qnil ? self : request;
 }
 
-void rbuv_stream_on_read(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t *buf) {
-  if (nread == 0) {
-    if (buf->base != NULL) {
-      free(buf->base);
-    }
-    return;
-  } else {
-    rbuv_stream_on_read_arg_t arg;
-    arg.uv_stream = uv_stream;
-    arg.nread = nread;
+/*
+ * The size of the send buffer the kernel uses for the socket.
+ * @note Linux reports twice the size set with {#send_buffer_size=}.
+ * @return [Number]
+ */
+static VALUE rbuv_stream_get_send_buffer_size(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+  int value = 0;
 
-    if (nread < 0) {
-      if (buf->base != NULL) {
-        free(buf->base);
-      }
-      arg.base = NULL;
-    } else {
-      // Here uvrb uses realloc. not sure about that
-      // buf->base = realloc(buf->base, nread);
-      // should we reassign buf->len = nread?
-      arg.base = buf->base;
-    }
-    rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)
-      rbuv_stream_on_read_no_gvl, &arg);
-  }
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  RBUV_CHECK_UV_RETURN(uv_send_buffer_size((uv_handle_t *)rbuv_stream->uv_handle, &value));
+  return INT2NUM(value);
 }
 
-void rbuv_stream_on_read_no_gvl(rbuv_stream_on_read_arg_t *arg) {
-  uv_stream_t *uv_stream = arg->uv_stream;
-  ssize_t nread = arg->nread;
-  char *base = arg->base;
+/*
+ * @overload send_buffer_size=(size)
+ *   Sets the size of the send buffer the kernel uses for the socket.
+ *   @param size [Number]
+ */
+static VALUE rbuv_stream_set_send_buffer_size(VALUE self, VALUE size) {
+  rbuv_stream_t *rbuv_stream;
+  int value = NUM2INT(size);
 
-  VALUE stream;
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  RBUV_CHECK_UV_RETURN(uv_send_buffer_size((uv_handle_t *)rbuv_stream->uv_handle, &value));
+  return size;
+}
+
+/*
+ * The size of the receive buffer the kernel uses for the socket.
+ * @note Linux reports twice the size set with {#recv_buffer_size=}.
+ * @return [Number]
+ */
+static VALUE rbuv_stream_get_recv_buffer_size(VALUE self) {
   rbuv_stream_t *rbuv_stream;
-  VALUE on_read;
-  VALUE error;
-  VALUE data;
+  int value = 0;
 
-  RBUV_DEBUG_LOG("uv_stream: %p, nread: %lu", uv_stream, nread);
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  RBUV_CHECK_UV_RETURN(uv_recv_buffer_size((uv_handle_t *)rbuv_stream->uv_handle, &value));
+  return INT2NUM(value);
+}
 
-  stream = (VALUE)uv_stream->data;
-  Data_Get_Handle_Struct(stream, rbuv_stream_t, rbuv_stream);
-  on_read = rbuv_stream->cb_on_read;
-  RBUV_DEBUG_LOG_DETAIL("stream: %s, on_read: %s",
-                        RSTRING_PTR(rb_inspect(stream)),
-                        RSTRING_PTR(rb_inspect(on_read)));
+/*
+ * @overload recv_buffer_size=(size)
+ *   Sets the size of the receive buffer the kernel uses for the socket.
+ *   @param size [Number]
+ */
+static VALUE rbuv_stream_set_recv_buffer_size(VALUE self, VALUE size) {
+  rbuv_stream_t *rbuv_stream;
+  int value = NUM2INT(size);
 
-  if (nread < 0) {
-    if (nread == UV_EOF) {
-      error = rb_exc_new2(rb_eEOFError, "end of file reached");
-    } else {
-      error = rb_exc_new2(eRbuvError, uv_strerror(nread));
-    }
-    data = Qnil;
-  } else {
-    error = Qnil;
-    data = rb_str_new(base, nread);
-  }
-  rb_funcall(on_read, id_call, 2, data, error);
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  RBUV_CHECK_UV_RETURN(uv_recv_buffer_size((uv_handle_t *)rbuv_stream->uv_handle, &value));
+  return size;
 }
 
-void rbuv_stream_on_write(uv_write_t *uv_req, int status) {
-  rbuv_stream_on_write_arg_t arg = {.uv_req = uv_req, .status = status};
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_stream_on_write_no_gvl, &arg);
+/*
+ * The number of bytes waiting to be written, including corked data.
+ * @return [Number]
+ */
+static VALUE rbuv_stream_get_write_queue_size(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  return SIZET2NUM(rbuv_stream_queued(rbuv_stream));
 }
 
-void rbuv_stream_on_write_no_gvl(rbuv_stream_on_write_arg_t *arg) {
-  rbuv_write_t *rbuv_write;
+/*
+ * @overload set_write_watermarks(high, low)
+ *   Once more than +high+ bytes are waiting to be written the stream is no
+ *   longer {#writable_without_blocking?}, the {#on_drain} block is called when
+ *   that goes down to +low+ bytes. The defaults are 64 KiB and 16 KiB.
+ *   @param high [Number]
+ *   @param low [Number]
+ *   @return [self] itself
+ *   @raise [ArgumentError] if +low+ is greater than +high+
+ */
+static VALUE rbuv_stream_set_write_watermarks(VALUE self, VALUE high, VALUE low) {
   rbuv_stream_t *rbuv_stream;
-  VALUE request;
-  VALUE stream;
-  VALUE error;
+  size_t uv_high = NUM2SIZET(high);
+  size_t uv_low = NUM2SIZET(low);
 
-  request = (VALUE) arg->uv_req->data;
-  Data_Get_Struct(request, rbuv_write_t, rbuv_write);
-  if (rbuv_write->uv_buf.base != NULL) {
-    free(rbuv_write->uv_buf.base);
-    rbuv_write->uv_buf.base = NULL;
-  }
-  if (rbuv_write->uv_req != NULL) {
-    free(rbuv_write->uv_req);
-    rbuv_write->uv_req = NULL;
+  if (uv_low > uv_high) {
+    rb_raise(rb_eArgError, "low watermark is greater than the high watermark");
   }
-  stream = (VALUE) arg->uv_req->handle->data;
-  Data_Get_Struct(stream, rbuv_stream_t, rbuv_stream);
-  rbuv_ary_delete_same_object(rbuv_stream->requests, request);
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  rbuv_stream->high_watermark = uv_high;
+  rbuv_stream->low_watermark = uv_low;
+  return self;
+}
 
-  if (arg->status < 0) {
-    error = rb_exc_new2(eRbuvError, uv_strerror(arg->status));
-  } else {
-    error = Qnil;
-  }
-  // RBUV_DEBUG_LOG_DETAIL("cb_on_write: %s, cbs_on_write: %s, error: %s",
-  //                     RSTRING_PTR(rb_inspect(cb_on_write)),
-  //                     RSTRING_PTR(rb_inspect(rbuv_stream->cbs_on_write)),
-  //                     RSTRING_PTR(rb_inspect(error)));
+/*
+ * The high and low write watermarks.
+ * @return [Array<Number>] +[high, low]+
+ */
+static VALUE rbuv_stream_get_write_watermarks(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
 
-  rb_funcall(rbuv_write->cb_on_write, id_call, 1, error);
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  return rb_assoc_new(SIZET2NUM(rbuv_stream->high_watermark),
+                      SIZET2NUM(rbuv_stream->low_watermark));
 }
 
-void rbuv_stream_on_shutdown(uv_shutdown_t *uv_req, int status) {
-  rbuv_stream_on_shutdown_arg_t arg = {
-    .uv_req = uv_req,
-    .status = status
-  };
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)rbuv_stream_on_shutdown_no_gvl, &arg);
+/*
+ * Check if less than the high watermark is waiting to be written, producers
+ * should wait for {#on_drain} otherwise.
+ * @return [Boolean]
+ */
+static VALUE rbuv_stream_is_writable_without_blocking(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  return rbuv_stream_queued(rbuv_stream) < rbuv_stream->high_watermark ? Qtrue : Qfalse;
 }
 
-void rbuv_stream_on_shutdown_no_gvl(rbuv_stream_on_shutdown_arg_t *arg) {
+/* @overload on_drain
+ *   Sets the block called when the data waiting to be written goes down to
+ *   the low watermark, after it went over the high watermark.
+ *   @yield
+ *   @yieldparam stream [self]
+ *   @return [self] itself
+ */
+static VALUE rbuv_stream_on_drain(VALUE self) {
   rbuv_stream_t *rbuv_stream;
-  rbuv_shutdown_t *rbuv_shutdown;
-  VALUE request;
-  VALUE stream;
+  VALUE block;
+
+  rb_need_block();
+  block = rb_block_proc();
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  rbuv_stream->cb_on_drain = block;
+
+  return self;
+}
+
+size_t rbuv_stream_queued(rbuv_stream_t *rbuv_stream) {
+  return rbuv_stream->uv_handle->write_queue_size + rbuv_stream->cork_len;
+}
+
+void rbuv_stream_check_high_watermark(rbuv_stream_t *rbuv_stream) {
+  if (rbuv_stream_queued(rbuv_stream) >= rbuv_stream->high_watermark) {
+    rbuv_stream->needs_drain = 1;
+  }
+}
+
+void rbuv_stream_check_low_watermark(VALUE stream, rbuv_stream_t *rbuv_stream) {
+  if (rbuv_stream->needs_drain && rbuv_stream->uv_handle != NULL &&
+      rbuv_stream_queued(rbuv_stream) <= rbuv_stream->low_watermark) {
+    rbuv_stream->needs_drain = 0;
+    if (RTEST(rbuv_stream->cb_on_drain)) {
+      rbuv_call(rbuv_stream->cb_on_drain, 1, stream);
+    }
+  }
+}
+
+/*
+ * Buffer the following writes without a block until {#uncork} is called or
+ * 64 KiB are buffered, then write them at once.
+ * @return [self] itself
+ */
+static VALUE rbuv_stream_cork(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  if (rbuv_stream->cork == RBUV_CORK_OFF) {
+    rbuv_stream->cork = RBUV_CORK_MANUAL;
+  }
+  return self;
+}
+
+/*
+ * Write the buffered data and stop buffering, this also turns off
+ * {#auto_cork=}.
+ * @return [self] itself
+ * @raise [Rbuv::Error] if the write fails
+ */
+static VALUE rbuv_stream_uncork(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  rbuv_stream->cork = RBUV_CORK_OFF;
+  rbuv_stream_flush_cork_or_raise(rbuv_stream);
+  return self;
+}
+
+/*
+ * @overload auto_cork=(auto_cork)
+ *   When enabled, writes without a block are buffered and the loop writes
+ *   them at once after running the current batch of callbacks, or as soon as
+ *   64 KiB are buffered. Errors are passed to the {#on_error} block.
+ *   @param auto_cork [Boolean]
+ *   @return [Boolean] auto_cork
+ */
+static VALUE rbuv_stream_set_auto_cork(VALUE self, VALUE auto_cork) {
+  rbuv_stream_t *rbuv_stream;
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  if (RTEST(auto_cork)) {
+    rbuv_stream->cork = RBUV_CORK_AUTO;
+  } else if (rbuv_stream->cork == RBUV_CORK_AUTO) {
+    rbuv_stream->cork = RBUV_CORK_OFF;
+    rbuv_stream_flush_cork_or_raise(rbuv_stream);
+  }
+  return auto_cork;
+}
+
+/*
+ * Check if writes are buffered until the end of the current batch of
+ * callbacks.
+ * @return [Boolean]
+ */
+static VALUE rbuv_stream_is_auto_cork(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  return rbuv_stream->cork == RBUV_CORK_AUTO ? Qtrue : Qfalse;
+}
+
+/*
+ * Appends +data+ to the cork buffer, a full buffer is written right away.
+ */
+void rbuv_stream_cork_append(VALUE stream, rbuv_stream_t *rbuv_stream,
+                             VALUE data, unsigned int nbufs) {
+  unsigned int i;
+  size_t len;
+  const char *base;
+  size_t str_len;
+
+  len = 0;
+  for (i = 0; i < nbufs; i++) {
+    rbuv_buffer_get_bytes(RBUV_WRITE_DATA_ENTRY(data, i), &base, &str_len);
+    len += str_len;
+  }
+  if (rbuv_stream->cork_len + len > rbuv_stream->cork_capa) {
+    size_t cork_capa = rbuv_stream->cork_capa > 0 ? rbuv_stream->cork_capa * 2 : 4096;
+    if (cork_capa < rbuv_stream->cork_len + len) {
+      cork_capa = rbuv_stream->cork_len + len;
+    }
+    rbuv_stream->cork_buf = rbuv_write_copy_resize(rbuv_stream->cork_buf,
+                                                   rbuv_stream->cork_capa, cork_capa);
+    rbuv_stream->cork_capa = cork_capa;
+  }
+  for (i = 0; i < nbufs; i++) {
+    rbuv_buffer_get_bytes(RBUV_WRITE_DATA_ENTRY(data, i), &base, &str_len);
+    memcpy(rbuv_stream->cork_buf + rbuv_stream->cork_len, base, str_len);
+    rbuv_stream->cork_len += str_len;
+  }
+
+  if (rbuv_stream->cork_len >= RBUV_CORK_SIZE) {
+    rbuv_stream_flush_cork_or_raise(rbuv_stream);
+  } else if (rbuv_stream->cork == RBUV_CORK_AUTO && !rbuv_stream->cork_queued) {
+    rbuv_stream->cork_queued = 1;
+    rbuv_loop_add_corked_stream((VALUE)rbuv_stream->uv_handle->loop->data, stream);
+  }
+}
+
+/*
+ * Writes the cork buffer with a block-less write which takes its ownership.
+ */
+int rbuv_stream_flush_cork(rbuv_stream_t *rbuv_stream) {
+  rbuv_write_t *rbuv_write;
+  uv_buf_t uv_buf;
+  int uv_ret;
+
+  if (rbuv_stream->cork_len == 0) {
+    return 0;
+  }
+  rbuv_write = rbuv_write_get(rbuv_stream->uv_handle->loop);
+  rbuv_write->uv_write.data = NULL;
+  rbuv_write_copy_free(rbuv_write->copy, rbuv_write->copy_capa);
+  rbuv_write->copy = rbuv_stream->cork_buf;
+  rbuv_write->copy_capa = rbuv_stream->cork_capa;
+  uv_buf = uv_buf_init(rbuv_stream->cork_buf, (unsigned int)rbuv_stream->cork_len);
+  rbuv_stream->cork_buf = NULL;
+  rbuv_stream->cork_len = 0;
+  rbuv_stream->cork_capa = 0;
+  rbuv_stream_track_write(rbuv_stream, rbuv_write);
+
+  rbuv_write->uv_req = &rbuv_write->uv_write;
+  uv_ret = uv_write(rbuv_write->uv_req, rbuv_stream->uv_handle, &uv_buf, 1,
+                    rbuv_stream_on_write);
+  if (uv_ret < 0) {
+    rbuv_write->uv_req = NULL;
+    rbuv_stream_forget_write(rbuv_stream, rbuv_write);
+  }
+  return uv_ret;
+}
+
+void rbuv_stream_flush_cork_or_raise(rbuv_stream_t *rbuv_stream) {
+  int uv_ret = rbuv_stream_flush_cork(rbuv_stream);
+  RBUV_CHECK_UV_RETURN(uv_ret);
+}
+
+/*
+ * Called by the loop once the callbacks of a batch have run.
+ */
+void rbuv_stream_flush_auto_cork(VALUE stream) {
+  rbuv_stream_t *rbuv_stream;
+  int uv_ret;
+
+  TypedData_Get_Struct(stream, rbuv_stream_t, &rbuv_stream_type, rbuv_stream);
+  rbuv_stream->cork_queued = 0;
+  if (rbuv_stream->uv_handle == NULL) {
+    rbuv_stream->cork_len = 0;
+    return;
+  }
+  uv_ret = rbuv_stream_flush_cork(rbuv_stream);
+  if (uv_ret < 0) {
+    rbuv_stream_report_error(stream, uv_ret);
+  }
+}
+
+/*
+ * Passes the error of a block-less write to the on_error block.
+ */
+void rbuv_stream_report_error(VALUE stream, int status) {
+  rbuv_stream_t *rbuv_stream;
+  VALUE error;
+
+  TypedData_Get_Struct(stream, rbuv_stream_t, &rbuv_stream_type, rbuv_stream);
+  if (status < 0 && status != UV_ECANCELED && RTEST(rbuv_stream->cb_on_error)) {
+    error = rbuv_error_new(status);
+    rbuv_call(rbuv_stream->cb_on_error, 2, stream, error);
+  }
+}
+
+/* @overload on_error
+ *   Sets the block called when a write without a callback fails, see
+ *   {#write} and {#try_write}.
+ *   @yield
+ *   @yieldparam stream [self]
+ *   @yieldparam error [Rbuv::Error]
+ *   @return [self] itself
+ */
+static VALUE rbuv_stream_on_error(VALUE self) {
+  rbuv_stream_t *rbuv_stream;
+  VALUE block;
+
+  rb_need_block();
+  block = rb_block_proc();
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  rbuv_stream->cb_on_error = block;
+
+  return self;
+}
+
+/* @overload try_write(data)
+ *   Write as much data as possible without blocking and without a request.
+ *   Whatever the socket does not take right away is written in the background,
+ *   in order, like a {#write} without a block.
+ *   @example
+ *     written = stream.try_write("HTTP/1.1 204 No Content\r\n\r\n")
+ *   @param data [String, IO::Buffer, Array<String, IO::Buffer>] the data to write
+ *   @return [Number] the number of bytes written right away
+ *   @raise [Rbuv::Error] if the write fails
+ */
+static VALUE rbuv_stream_try_write(VALUE self, VALUE data) {
+  rbuv_stream_t *rbuv_stream;
+  uv_buf_t uv_bufs_small[RBUV_WRITE_BUFS_SMALL];
+  uv_buf_t *uv_bufs;
+  unsigned int nbufs;
+  unsigned int i;
+  size_t len;
+  int uv_ret;
+
+  nbufs = rbuv_stream_check_data(data);
+
+  Data_Get_Handle_Struct(self, rbuv_stream_t, rbuv_stream);
+  rbuv_stream_flush_cork_or_raise(rbuv_stream);
+
+  uv_bufs = nbufs <= RBUV_WRITE_BUFS_SMALL ? uv_bufs_small : ALLOC_N(uv_buf_t, nbufs);
+  len = 0;
+  // rbuv_stream_check_data ensures there is at least one buffer
+  i = 0;
+  do {
+    const char *base;
+    size_t str_len;
+    rbuv_buffer_get_bytes(RBUV_WRITE_DATA_ENTRY(data, i), &base, &str_len);
+    uv_bufs[i] = uv_buf_init((char *)base, (unsigned int)str_len);
+    len += str_len;
+  } while (++i < nbufs);
+  uv_ret = uv_try_write(rbuv_stream->uv_handle, uv_bufs, nbufs);
+  if (uv_bufs != uv_bufs_small) {
+    xfree(uv_bufs);
+  }
+  if (uv_ret == UV_EAGAIN || uv_ret == UV_ENOSYS) {
+    uv_ret = 0;
+  } else if (uv_ret < 0) {
+    rbuv_error_raise(uv_ret);
+    return Qnil;
+  }
+  if ((size_t)uv_ret < len) {
+    rbuv_stream_queue_write(rbuv_stream, data, Qnil, NULL, nbufs, uv_ret, Qnil);
+    rbuv_stream_check_high_watermark(rbuv_stream);
+  }
+  return INT2NUM(uv_ret);
+}
+
+/*
+ * Raises unless +data+ is a String, an IO::Buffer or a non empty Array of
+ * them, returns how many buffers it has.
+ */
+unsigned int rbuv_stream_check_data(VALUE data) {
+  unsigned int nbufs;
+  unsigned int i;
+  VALUE str;
+
+  if (TYPE(data) == T_STRING || rbuv_buffer_is_io_buffer(data)) {
+    nbufs = 1;
+  } else if (TYPE(data) == T_ARRAY && RARRAY_LEN(data) > 0) {
+    nbufs = (unsigned int)RARRAY_LEN(data);
+    for (i = 0; i < nbufs; i++) {
+      str = rb_ary_entry(data, i);
+      if (TYPE(str) != T_STRING && !rbuv_buffer_is_io_buffer(str)) {
+        rb_raise(rb_eTypeError, "not valid value, should be a String");
+      }
+    }
+  } else if (TYPE(data) == T_ARRAY) {
+    rb_raise(rb_eArgError, "nothing to write, the Array is empty");
+  } else {
+    rb_raise(rb_eTypeError, "not valid value, should be a String or an Array");
+  }
+  return nbufs;
+}
+
+/*
+ * Queues a uv_write of +data+, skipping its first +offset+ bytes which were
+ * already written. A +send_handle+ other than nil, whose open stream is
+ * +uv_send_handle+, is sent along with it over an IPC pipe.
+ *
+ * Returns a Rbuv::Stream::WriteRequest calling +cb_on_write+ or, when
+ * +cb_on_write+ is nil, +Qnil+ and the write is tracked by the stream alone.
+ */
+VALUE rbuv_stream_queue_write(rbuv_stream_t *rbuv_stream, VALUE data,
+                              VALUE send_handle, uv_stream_t *uv_send_handle,
+                              unsigned int nbufs, size_t offset,
+                              VALUE cb_on_write) {
+  rbuv_write_t *rbuv_write;
+  VALUE request;
+  uv_buf_t uv_bufs_small[RBUV_WRITE_BUFS_SMALL];
+  uv_buf_t *uv_bufs;
+  unsigned int first;
+  int uv_ret;
+
+  if (cb_on_write == Qnil) {
+    rbuv_write = rbuv_write_get(rbuv_stream->uv_handle->loop);
+    request = Qnil;
+    rbuv_write->uv_write.data = NULL;
+    rbuv_stream_track_write(rbuv_stream, rbuv_write);
+  } else {
+    rbuv_write = rbuv_write_new(cb_on_write);
+    request = TypedData_Wrap_Struct(cRbuvStreamWriteRequest, &rbuv_write_type, rbuv_write);
+    rbuv_write->uv_write.data = (void *)request;
+  }
+
+  // libuv copies the uv_buf_t array, only the data has to outlive uv_write
+  uv_bufs = nbufs <= RBUV_WRITE_BUFS_SMALL ? uv_bufs_small : ALLOC_N(uv_buf_t, nbufs);
+  rbuv_write_set_data(rbuv_write, data, nbufs, uv_bufs, request != Qnil);
+  // skip what try_write already wrote, an empty write still has its buffer
+  for (first = 0; offset > 0 && first + 1 < nbufs && offset >= uv_bufs[first].len; first++) {
+    offset -= uv_bufs[first].len;
+  }
+  uv_bufs[first].base += offset;
+  uv_bufs[first].len -= offset;
+  rbuv_write->uv_req = &rbuv_write->uv_write;
+  if (uv_send_handle == NULL) {
+    uv_ret = uv_write(rbuv_write->uv_req, rbuv_stream->uv_handle,
+                      uv_bufs + first, nbufs - first, rbuv_stream_on_write);
+  } else {
+    // the handle is kept open until its descriptor is sent
+    rbuv_write->send_handle = send_handle;
+    uv_ret = uv_write2(rbuv_write->uv_req, rbuv_stream->uv_handle,
+                       uv_bufs + first, nbufs - first,
+                       uv_send_handle, rbuv_stream_on_write);
+  }
+  if (uv_bufs != uv_bufs_small) {
+    xfree(uv_bufs);
+  }
+  if (uv_ret < 0) {
+    rbuv_write->uv_req = NULL;
+    if (request == Qnil) {
+      rbuv_stream_forget_write(rbuv_stream, rbuv_write);
+    } else {
+      rbuv_write_release(rbuv_write);
+    }
+    rbuv_error_raise(uv_ret);
+    return Qnil;
+  } else {
+    if (request != Qnil) {
+      rbuv_request_link(&rbuv_stream->requests, &rbuv_write->link, request);
+    }
+    return request;
+  }
+}
+
+/*
+ * Links a block-less write to +rbuv_stream+, which marks its data.
+ */
+void rbuv_stream_track_write(rbuv_stream_t *rbuv_stream, rbuv_write_t *rbuv_write) {
+  rbuv_write->prev = NULL;
+  rbuv_write->next = rbuv_stream->writes;
+  if (rbuv_stream->writes != NULL) {
+    rbuv_stream->writes->prev = rbuv_write;
+  }
+  rbuv_stream->writes = rbuv_write;
+}
+
+/*
+ * Unlinks a block-less write from +rbuv_stream+ and gives it back to the loop.
+ */
+void rbuv_stream_forget_write(rbuv_stream_t *rbuv_stream, rbuv_write_t *rbuv_write) {
+  if (rbuv_write->prev != NULL) {
+    rbuv_write->prev->next = rbuv_write->next;
+  } else {
+    rbuv_stream->writes = rbuv_write->next;
+  }
+  if (rbuv_write->next != NULL) {
+    rbuv_write->next->prev = rbuv_write->prev;
+  }
+  rbuv_write_put(rbuv_stream->uv_handle->loop, rbuv_write);
+}
+
+void rbuv_stream_on_connection(uv_stream_t *uv_stream, int status) {
+  rbuv_stream_on_connection_arg_t arg = {
+    .uv_stream = uv_stream,
+    .status = status
+  };
+  rbuv_loop_defer(uv_stream->loop, (VALUE)uv_stream->data,
+                  (rbuv_loop_deferred_cb)rbuv_stream_on_connection_no_gvl,
+                  &arg, sizeof(arg));
+}
+
+void rbuv_stream_on_connection_no_gvl(rbuv_stream_on_connection_arg_t *arg) {
+  uv_stream_t *uv_stream = arg->uv_stream;
+  int status = arg->status;
+  VALUE stream;
+  rbuv_stream_t *rbuv_stream;
+  VALUE on_connection;
+  VALUE error;
+  VALUE clients;
+
+  RBUV_DEBUG_LOG("uv_stream: %p, status: %d", uv_stream, status);
+
+  // a callback earlier in the batch may have closed it
+  if (uv_is_closing((uv_handle_t *)uv_stream)) {
+    return;
+  }
+  stream = (VALUE)uv_stream->data;
+  Data_Get_Handle_Struct(stream, rbuv_stream_t, rbuv_stream);
+  on_connection = rbuv_stream->cb_on_connection;
+
+  RBUV_DEBUG_LOG_DETAIL("stream: %s, on_connection: %s",
+                        RSTRING_PTR(rb_inspect(stream)),
+                        RSTRING_PTR(rb_inspect(on_connection)));
+
+  if (status < 0) {
+    RBUV_DEBUG_LOG_DETAIL("uv_stream: %p, status: %d, error: %s", uv_stream, status,
+                          uv_strerror(status));
+    error = rbuv_error_new(status);
+  } else {
+    error = Qnil;
+  }
+  if (rbuv_stream->accept_limit == 0) {
+    rbuv_call(on_connection, 2, stream, error);
+  } else if (error != Qnil) {
+    rbuv_call(on_connection, 2, Qnil, error);
+  } else {
+    clients = rbuv_stream_accept_batch(stream, rbuv_stream, &error);
+    rbuv_call(on_connection, 2, clients, error);
+  }
+}
+
+/*
+ * Accepts the connection libuv has accepted, then takes the ones still
+ * pending straight from the listening socket, up to the accept_limit.
+ * Returns +nil+ and sets +error+ if the first one fails.
+ */
+VALUE rbuv_stream_accept_batch(VALUE stream, rbuv_stream_t *rbuv_server,
+                               VALUE *error) {
+  VALUE loop = (VALUE)rbuv_server->uv_handle->loop->data;
+  VALUE clients = rb_ary_new();
+  VALUE client;
+  rbuv_stream_t *rbuv_client;
+  int uv_ret;
+
+  client = rb_class_new_instance(1, &loop, rb_class_of(stream));
+  Data_Get_Handle_Struct(client, rbuv_stream_t, rbuv_client);
+  uv_ret = uv_accept(rbuv_server->uv_handle, rbuv_client->uv_handle);
+  if (uv_ret < 0) {
+    rb_funcallv(client, rb_intern("close"), 0, NULL);
+    *error = rbuv_error_new(uv_ret);
+    return Qnil;
+  }
+  rb_ary_push(clients, client);
+
+  while ((unsigned long)RARRAY_LEN(clients) < rbuv_server->accept_limit &&
+         rbuv_stream_accept_pending(stream, rbuv_server, &client)) {
+    rb_ary_push(clients, client);
+  }
+  return clients;
+}
+
+/*
+ * libuv accepts one connection per callback, and waits for uv_accept before
+ * taking the next one. Accepting the others here saves a loop iteration and
+ * a callback each. It gives up on any error, libuv reports it when it
+ * accepts the next connection.
+ *
+ * Returns 1 and sets +client+ if a connection was accepted.
+ */
+int rbuv_stream_accept_pending(VALUE stream, rbuv_stream_t *rbuv_server,
+                               VALUE *client) {
+#ifndef _WIN32
+  uv_stream_t *uv_server = rbuv_server->uv_handle;
+  VALUE loop = (VALUE)uv_server->loop->data;
+  rbuv_stream_t *rbuv_client;
+  uv_os_fd_t server_fd;
+  int fd;
+  int uv_ret;
+
+  if (uv_server->type != UV_TCP && uv_server->type != UV_NAMED_PIPE) {
+    return 0;
+  }
+  if (uv_fileno((uv_handle_t *)uv_server, &server_fd) < 0) {
+    return 0;
+  }
+  do {
+    fd = accept(server_fd, NULL, NULL);
+  } while (fd < 0 && (errno == EINTR || errno == ECONNABORTED));
+  if (fd < 0) {
+    return 0;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  *client = rb_class_new_instance(1, &loop, rb_class_of(stream));
+  Data_Get_Handle_Struct(*client, rbuv_stream_t, rbuv_client);
+  if (uv_server->type == UV_TCP) {
+    uv_ret = uv_tcp_open((uv_tcp_t *)rbuv_client->uv_handle, fd);
+  } else {
+    uv_ret = uv_pipe_open((uv_pipe_t *)rbuv_client->uv_handle, fd);
+  }
+  if (uv_ret < 0) {
+    close(fd);
+    rb_funcallv(*client, rb_intern("close"), 0, NULL);
+    return 0;
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+rbuv_buffer_pool_t *rbuv_stream_get_read_buffers(uv_stream_t *uv_stream) {
+  rbuv_loop_t *rbuv_loop = RTYPEDDATA_DATA((VALUE)uv_stream->loop->data);
+  return &rbuv_loop->read_buffers;
+}
+
+void rbuv_alloc_buffer(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+  rbuv_stream_t *rbuv_stream = RBUV_HANDLE_OF(handle);
+  rbuv_buffer_pool_t *read_buffers = rbuv_stream_get_read_buffers((uv_stream_t *)handle);
+  rbuv_stream->read_buffer = rbuv_buffer_pool_get(read_buffers, buf);
+}
+
+void rbuv_stream_on_read(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t *buf) {
+  rbuv_stream_t *rbuv_stream = RBUV_HANDLE_OF(uv_stream);
+  rbuv_stream_on_read_arg_t arg = {
+    .uv_stream = uv_stream,
+    .nread = nread,
+    .buf = *buf,
+    .buffer = rbuv_stream->read_buffer,
+    .generation = rbuv_stream->read_generation
+  };
+  rbuv_stream->read_buffer = Qnil;
+
+  if (nread <= 0 && buf->base != NULL) {
+    rbuv_buffer_pool_put(rbuv_stream_get_read_buffers(uv_stream), arg.buffer, buf);
+  }
+  if (nread > 0 && (rbuv_stream->read_handler & RBUV_READ_HANDLES)) {
+    // the handles queued since the previous read came with this data
+    arg.handles = uv_pipe_pending_count((uv_pipe_t *)uv_stream) - rbuv_stream->handles_counted;
+    rbuv_stream->handles_counted += arg.handles;
+  }
+  if (nread != 0) {
+    rbuv_loop_defer(uv_stream->loop,
+                    nread > 0 && arg.buffer != Qnil ? arg.buffer : (VALUE)uv_stream->data,
+                    (rbuv_loop_deferred_cb)rbuv_stream_on_read_no_gvl,
+                    &arg, sizeof(arg));
+  }
+}
+
+void rbuv_stream_on_read_no_gvl(rbuv_stream_on_read_arg_t *arg) {
+  uv_stream_t *uv_stream = arg->uv_stream;
+  ssize_t nread = arg->nread;
+
+  VALUE stream;
+  rbuv_stream_t *rbuv_stream;
+  VALUE data;
+  long i;
+
+  RBUV_DEBUG_LOG("uv_stream: %p, nread: %lu", uv_stream, nread);
+
+  stream = (VALUE)uv_stream->data;
+  Data_Get_Handle_Struct(stream, rbuv_stream_t, rbuv_stream);
+  RBUV_DEBUG_LOG_DETAIL("stream: %s, on_read: %s",
+                        RSTRING_PTR(rb_inspect(stream)),
+                        RSTRING_PTR(rb_inspect(rbuv_stream->cb_on_read)));
+  rbuv_stream->handles_counted -= arg->handles;
+  if (!rbuv_stream_read_is_current(rbuv_stream, arg)) {
+    if (nread > 0) {
+      rbuv_buffer_pool_put(rbuv_stream_get_read_buffers(uv_stream), arg->buffer, &arg->buf);
+    }
+    // the handles that came with the data go with it
+    if (arg->handles > 0 && !uv_is_closing((uv_handle_t *)uv_stream)) {
+      data = rbuv_stream_accept_handles(rbuv_stream, arg->handles);
+      for (i = 0; i < RARRAY_LEN(data); i++) {
+        rb_funcallv(RARRAY_AREF(data, i), rb_intern("close"), 0, NULL);
+      }
+    }
+    return;
+  }
+
+  if (nread < 0) {
+    data = Qnil;
+  } else {
+    data = rbuv_buffer_pool_take(rbuv_stream_get_read_buffers(uv_stream),
+                                 arg->buffer, &arg->buf, nread);
+  }
+  if (data != Qnil && (rbuv_stream->read_handler & RBUV_READ_HANDLES)) {
+    rbuv_call(rbuv_stream->cb_on_read, 3, data,
+              rbuv_stream_accept_handles(rbuv_stream, arg->handles), Qnil);
+  } else {
+    rbuv_stream_dispatch_read(rbuv_stream, data, nread, Qnil);
+  }
+}
+
+/*
+ * Gets the block or the handler given to read_start or read_frames, with the
+ * RBUV_READ_HANDLER flags of the latter.
+ */
+VALUE rbuv_stream_read_callback(int argc, VALUE *argv, VALUE *options, int *read_handler) {
+  VALUE handler;
+
+  rb_scan_args(argc, argv, "01:", &handler, options);
+  if (handler == Qnil) {
+    rb_need_block();
+    *read_handler = 0;
+    return rb_block_proc();
+  }
+  if (!rb_respond_to(handler, id_on_data)) {
+    rb_raise(rb_eTypeError, "the handler must respond to on_data");
+  }
+  *read_handler = RBUV_READ_HANDLER;
+  if (rb_respond_to(handler, id_on_eof)) {
+    *read_handler |= RBUV_READ_HANDLER_ON_EOF;
+  }
+  if (rb_respond_to(handler, id_on_error)) {
+    *read_handler |= RBUV_READ_HANDLER_ON_ERROR;
+  }
+  return handler;
+}
+
+/*
+ * Gives a read to the block as +data+ and +error+, or to the handler: +data+
+ * to on_data, EOF to on_eof and errors to on_error. A negative +status+ is
+ * the libuv error when +data+ and +error+ are +nil+.
+ */
+void rbuv_stream_dispatch_read(rbuv_stream_t *rbuv_stream, VALUE data,
+                               ssize_t status, VALUE error) {
+  VALUE callback = rbuv_stream->cb_on_read;
+  int read_handler = rbuv_stream->read_handler;
+
+  if (read_handler & RBUV_READ_HANDLES) {
+    rbuv_call(callback, 3, Qnil, Qnil, rbuv_stream_read_error(status));
+  } else if (!(read_handler & RBUV_READ_HANDLER)) {
+    if (data == Qnil && error == Qnil) {
+      error = rbuv_stream_read_error(status);
+    }
+    rbuv_call(callback, 2, data, error);
+  } else if (data != Qnil) {
+    rb_funcallv(callback, id_on_data, 1, &data);
+  } else if (error == Qnil && status == UV_EOF) {
+    if (read_handler & RBUV_READ_HANDLER_ON_EOF) {
+      rb_funcallv(callback, id_on_eof, 0, NULL);
+    }
+  } else if (read_handler & RBUV_READ_HANDLER_ON_ERROR) {
+    if (error == Qnil) {
+      error = rbuv_error_new(status);
+    }
+    rb_funcallv(callback, id_on_error, 1, &error);
+  }
+}
+
+/*
+ * Accepts the +count+ handles an IPC pipe has received along with the data
+ * being yielded into new Rbuv::Tcp or Rbuv::Pipe objects. The handles of
+ * other types are accepted into a pipe that is closed right away, so they do
+ * not hold up the ones behind them.
+ */
+VALUE rbuv_stream_accept_handles(rbuv_stream_t *rbuv_stream, int count) {
+  uv_pipe_t *uv_pipe = (uv_pipe_t *)rbuv_stream->uv_handle;
+  VALUE loop = (VALUE)uv_pipe->loop->data;
+  VALUE handles = rb_ary_new();
+  VALUE handle;
+  uv_handle_type type;
+  rbuv_stream_t *rbuv_handle;
+
+  for (; count > 0 && uv_pipe_pending_count(uv_pipe) > 0; count--) {
+    type = uv_pipe_pending_type(uv_pipe);
+    handle = rb_class_new_instance(1, &loop, type == UV_TCP ? cRbuvTcp : cRbuvPipe);
+    Data_Get_Handle_Struct(handle, rbuv_stream_t, rbuv_handle);
+    RBUV_CHECK_UV_RETURN(uv_accept((uv_stream_t *)uv_pipe, rbuv_handle->uv_handle));
+    if (type == UV_TCP || type == UV_NAMED_PIPE) {
+      rb_ary_push(handles, handle);
+    } else {
+      rb_funcallv(handle, rb_intern("close"), 0, NULL);
+    }
+  }
+  return handles;
+}
+
+/*
+ * Whether the read queued with +arg+ is still wanted: a callback earlier in
+ * the batch may have called read_stop, started another read or closed the
+ * stream.
+ */
+int rbuv_stream_read_is_current(rbuv_stream_t *rbuv_stream,
+                                rbuv_stream_on_read_arg_t *arg) {
+  return arg->generation == rbuv_stream->read_generation &&
+         !uv_is_closing((uv_handle_t *)rbuv_stream->uv_handle);
+}
+
+VALUE rbuv_stream_read_error(ssize_t nread) {
+  if (nread == UV_EOF) {
+    return rbuv_error_eof();
+  } else {
+    return rbuv_error_new(nread);
+  }
+}
+
+void rbuv_alloc_read_into(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+  rbuv_stream_t *rbuv_stream = RBUV_HANDLE_OF(handle);
+  rbuv_read_into_t *read_into = rbuv_stream->read_into;
+  *buf = uv_buf_init(read_into->base + read_into->len,
+                     (unsigned int)(read_into->capa - read_into->len));
+}
+
+/*
+ * Reads keep filling the buffer until the queued callback yields them, so a
+ * burst of reads is yielded once. A full buffer stops reading until then.
+ */
+void rbuv_stream_on_read_into(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t *buf) {
+  rbuv_stream_t *rbuv_stream = RBUV_HANDLE_OF(uv_stream);
+  rbuv_read_into_t *read_into = rbuv_stream->read_into;
+  rbuv_stream_on_read_arg_t arg = {
+    .uv_stream = uv_stream,
+    .nread = nread,
+    .buf = *buf,
+    .buffer = Qnil,
+    .generation = rbuv_stream->read_generation
+  };
+
+  if (nread > 0) {
+    read_into->len += nread;
+    if (read_into->len == read_into->capa) {
+      uv_read_stop(uv_stream);
+      read_into->paused = 1;
+    }
+    if (read_into->queued) {
+      return;
+    }
+    read_into->queued = 1;
+  }
+  if (nread != 0) {
+    rbuv_loop_defer(uv_stream->loop, (VALUE)uv_stream->data,
+                    (rbuv_loop_deferred_cb)rbuv_stream_on_read_into_no_gvl,
+                    &arg, sizeof(arg));
+  }
+}
+
+void rbuv_stream_on_read_into_no_gvl(rbuv_stream_on_read_arg_t *arg) {
+  uv_stream_t *uv_stream = arg->uv_stream;
+
+  VALUE stream;
+  rbuv_stream_t *rbuv_stream;
+  rbuv_read_into_t *read_into;
+  size_t len;
+
+  RBUV_DEBUG_LOG("uv_stream: %p, nread: %ld", uv_stream, arg->nread);
+
+  stream = (VALUE)uv_stream->data;
+  Data_Get_Handle_Struct(stream, rbuv_stream_t, rbuv_stream);
+  read_into = rbuv_stream->read_into;
+  // read_stop, another read_start or close may have come first
+  if (read_into == NULL || !rbuv_stream_read_is_current(rbuv_stream, arg)) {
+    return;
+  }
+
+  if (arg->nread < 0) {
+    rbuv_stream_release_reader(rbuv_stream);
+    rbuv_stream_dispatch_read(rbuv_stream, Qnil, arg->nread, Qnil);
+    return;
+  }
+  if (!read_into->queued) {
+    return;
+  }
+
+  len = read_into->len;
+  read_into->len = 0;
+  read_into->queued = 0;
+  rbuv_read_into_set_len(read_into, len);
+  rbuv_stream_dispatch_read(rbuv_stream, SIZET2NUM(len), 0, Qnil);
+
+  if (rbuv_stream->read_into != read_into) {
+    return;
+  }
+  rbuv_read_into_reset(read_into);
+  if (read_into->paused && rbuv_stream->uv_handle != NULL) {
+    read_into->paused = 0;
+    uv_read_start(rbuv_stream->uv_handle, rbuv_alloc_read_into, rbuv_stream_on_read_into);
+  }
+}
+
+void rbuv_alloc_frames(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+  rbuv_stream_t *rbuv_stream = RBUV_HANDLE_OF(handle);
+  rbuv_framer_alloc(rbuv_stream->framer, buf);
+}
+
+void rbuv_stream_on_read_frames(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t *buf) {
+  rbuv_stream_t *rbuv_stream = RBUV_HANDLE_OF(uv_stream);
+  rbuv_framer_t *framer = rbuv_stream->framer;
+  rbuv_stream_on_read_arg_t arg = {
+    .uv_stream = uv_stream,
+    .nread = nread,
+    .buf = *buf,
+    .buffer = Qnil,
+    .generation = rbuv_stream->read_generation
+  };
+
+  if (nread > 0) {
+    framer->len += nread;
+    if (framer->queued) {
+      return;
+    }
+    framer->queued = 1;
+  }
+  if (nread != 0) {
+    rbuv_loop_defer(uv_stream->loop, (VALUE)uv_stream->data,
+                    (rbuv_loop_deferred_cb)rbuv_stream_on_read_frames_no_gvl,
+                    &arg, sizeof(arg));
+  }
+}
+
+void rbuv_stream_on_read_frames_no_gvl(rbuv_stream_on_read_arg_t *arg) {
+  uv_stream_t *uv_stream = arg->uv_stream;
+
+  VALUE stream;
+  rbuv_stream_t *rbuv_stream;
+  rbuv_framer_t *framer;
+  VALUE frames;
+  VALUE rest;
+  int status;
+
+  RBUV_DEBUG_LOG("uv_stream: %p, nread: %ld", uv_stream, arg->nread);
+
+  stream = (VALUE)uv_stream->data;
+  Data_Get_Handle_Struct(stream, rbuv_stream_t, rbuv_stream);
+  framer = rbuv_stream->framer;
+  if (framer == NULL || !rbuv_stream_read_is_current(rbuv_stream, arg)) {
+    return;
+  }
+
+  if (arg->nread < 0) {
+    rest = arg->nread == UV_EOF ? rbuv_framer_rest(framer) : Qnil;
+    rbuv_stream_release_reader(rbuv_stream);
+    if (rest != Qnil) {
+      rbuv_stream_dispatch_read(rbuv_stream, rb_ary_new_from_args(1, rest), 0, Qnil);
+    }
+    rbuv_stream_dispatch_read(rbuv_stream, Qnil, arg->nread, Qnil);
+    return;
+  }
+  if (!framer->queued) {
+    return;
+  }
+
+  framer->queued = 0;
+  frames = rb_ary_new();
+  if (rbuv_framer_take(framer, frames) < 0) {
+    status = UV_EMSGSIZE;
+    uv_read_stop(uv_stream);
+    rbuv_stream_release_reader(rbuv_stream);
+  } else {
+    status = 0;
+  }
+  if (RARRAY_LEN(frames) > 0) {
+    rbuv_stream_dispatch_read(rbuv_stream, frames, 0, Qnil);
+  }
+  if (status != 0) {
+    rbuv_stream_dispatch_read(rbuv_stream, Qnil, status, Qnil);
+  }
+}
+
+void rbuv_alloc_pipe_chunk(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+  rbuv_stream_pipe_chunk_t *chunk = malloc(sizeof(*chunk));
+  *buf = uv_buf_init(chunk->data, RBUV_PIPE_CHUNK_SIZE);
+}
+
+/*
+ * Forwarding happens in the libuv callbacks, without the GVL: the chunk read
+ * is written to the target as it is and freed once written. Ruby only hears
+ * about the end of the pipe.
+ */
+void rbuv_stream_on_pipe_read(uv_stream_t *uv_stream, ssize_t nread, const uv_buf_t *buf) {
+  rbuv_stream_t *rbuv_stream = RBUV_HANDLE_OF(uv_stream);
+  rbuv_stream_pipe_t *pipe = rbuv_stream->pipe;
+  rbuv_stream_t *target = RTYPEDDATA_DATA(pipe->target);
+  rbuv_stream_pipe_chunk_t *chunk = NULL;
+  uv_buf_t uv_buf;
+  int status;
+
+  if (buf->base != NULL) {
+    chunk = (rbuv_stream_pipe_chunk_t *)(buf->base - RBUV_OFFSETOF(rbuv_stream_pipe_chunk_t, data));
+  }
+  if (nread > 0) {
+    if (target->uv_handle == NULL || uv_is_closing((uv_handle_t *)target->uv_handle)) {
+      status = UV_EPIPE;
+    } else {
+      chunk->pipe = pipe;
+      uv_buf = uv_buf_init(chunk->data, (unsigned int)nread);
+      status = uv_write(&chunk->uv_write, target->uv_handle, &uv_buf, 1, rbuv_stream_on_pipe_write);
+    }
+    if (status == 0) {
+      pipe->writes++;
+      if (target->uv_handle->write_queue_size > pipe->high_water) {
+        uv_read_stop(uv_stream);
+        pipe->paused = 1;
+      }
+      return;
+    }
+  } else {
+    status = (int)nread;
+  }
+  free(chunk);
+  if (status != 0) {
+    rbuv_stream_pipe_end(uv_stream, pipe, status);
+  }
+}
+
+void rbuv_stream_on_pipe_write(uv_write_t *uv_req, int status) {
+  rbuv_stream_pipe_chunk_t *chunk = RBUV_CONTAINTER_OF(uv_req, rbuv_stream_pipe_chunk_t, uv_write);
+  rbuv_stream_pipe_t *pipe = chunk->pipe;
+  uv_stream_t *target = uv_req->handle;
+
+  free(chunk);
+  pipe->writes--;
+  if (pipe->source == NULL) {
+    if (pipe->writes == 0) {
+      free(pipe);
+    }
+  } else if (pipe->stopped) {
+    return;
+  } else if (status < 0 && status != UV_ECANCELED) {
+    rbuv_stream_pipe_end(pipe->source, pipe, status);
+  } else if (pipe->paused && target->write_queue_size <= pipe->high_water / 2 &&
+             !uv_is_closing((uv_handle_t *)pipe->source) &&
+             ((rbuv_stream_t *)RBUV_HANDLE_OF(pipe->source))->pipe == pipe) {
+    pipe->paused = 0;
+    uv_read_start(pipe->source, rbuv_alloc_pipe_chunk, rbuv_stream_on_pipe_read);
+  }
+}
+
+void rbuv_stream_pipe_end(uv_stream_t *uv_stream, rbuv_stream_pipe_t *pipe, int status) {
+  rbuv_stream_on_pipe_end_arg_t arg = {
+    .uv_stream = uv_stream,
+    .pipe = pipe,
+    .status = status
+  };
+  pipe->stopped = 1;
+  uv_read_stop(uv_stream);
+  rbuv_loop_defer(uv_stream->loop, (VALUE)uv_stream->data,
+                  (rbuv_loop_deferred_cb)rbuv_stream_on_pipe_end_no_gvl,
+                  &arg, sizeof(arg));
+}
+
+void rbuv_stream_on_pipe_end_no_gvl(rbuv_stream_on_pipe_end_arg_t *arg) {
+  VALUE stream;
+  rbuv_stream_t *rbuv_stream;
+  VALUE error;
+
+  RBUV_DEBUG_LOG("uv_stream: %p, status: %d", arg->uv_stream, arg->status);
+
+  stream = (VALUE)arg->uv_stream->data;
+  Data_Get_Handle_Struct(stream, rbuv_stream_t, rbuv_stream);
+  // read_stop or another read may have come first
+  if (rbuv_stream->pipe != arg->pipe) {
+    return;
+  }
+  rbuv_stream_release_reader(rbuv_stream);
+
+  if (RTEST(rbuv_stream->cb_on_read)) {
+    error = arg->status == UV_EOF ? Qnil : rbuv_error_new(arg->status);
+    rbuv_call(rbuv_stream->cb_on_read, 1, error);
+  }
+}
+
+/*
+ * The source lets go of +pipe+, which is freed once its chunks are written.
+ */
+void rbuv_stream_pipe_release(rbuv_stream_pipe_t *pipe) {
+  pipe->source = NULL;
+  if (pipe->writes == 0) {
+    free(pipe);
+  }
+}
+
+/*
+ * Stops using the buffer of read_start(buffer:), the framer of read_frames or
+ * the pipe of pipe_to, the buffer is given back to the caller.
+ */
+void rbuv_stream_release_reader(rbuv_stream_t *rbuv_stream) {
+  rbuv_read_into_t *read_into = rbuv_stream->read_into;
+
+  // the reads already queued are not for the next reader
+  rbuv_stream->read_generation++;
+  if (read_into != NULL) {
+    rbuv_stream->read_into = NULL;
+    rbuv_read_into_release(read_into);
+  }
+  rbuv_framer_free(rbuv_stream->framer);
+  rbuv_stream->framer = NULL;
+  if (rbuv_stream->pipe != NULL) {
+    rbuv_stream_pipe_release(rbuv_stream->pipe);
+    rbuv_stream->pipe = NULL;
+  }
+}
+
+void rbuv_stream_closed(rbuv_stream_t *rbuv_stream) {
+  rbuv_stream_release_reader(rbuv_stream);
+}
+
+void rbuv_stream_on_write(uv_write_t *uv_req, int status) {
+  rbuv_stream_on_write_arg_t arg = {.uv_req = uv_req, .status = status};
+  rbuv_loop_defer(uv_req->handle->loop,
+                  uv_req->data != NULL ? (VALUE)uv_req->data : (VALUE)uv_req->handle->data,
+                  (rbuv_loop_deferred_cb)rbuv_stream_on_write_no_gvl,
+                  &arg, sizeof(arg));
+}
+
+void rbuv_stream_on_write_no_gvl(rbuv_stream_on_write_arg_t *arg) {
+  rbuv_write_t *rbuv_write;
+  rbuv_stream_t *rbuv_stream;
+  VALUE request;
+  VALUE stream;
   VALUE error;
+  VALUE cb_on_write;
 
+  rbuv_write = RBUV_CONTAINTER_OF(arg->uv_req, rbuv_write_t, uv_write);
   request = (VALUE) arg->uv_req->data;
-  Data_Get_Struct(request, rbuv_shutdown_t, rbuv_shutdown);
-  if (rbuv_shutdown->uv_req != NULL) {
-    free(rbuv_shutdown->uv_req);
-    rbuv_shutdown->uv_req = NULL;
+  stream = (VALUE) arg->uv_req->handle->data;
+  TypedData_Get_Struct(stream, rbuv_stream_t, &rbuv_stream_type, rbuv_stream);
+
+  cb_on_write = rbuv_write->cb_on_write;
+  rbuv_write->uv_req = NULL;
+  if (request == (VALUE)NULL) {
+    rbuv_stream_forget_write(rbuv_stream, rbuv_write);
+    rbuv_stream_report_error(stream, arg->status);
+    rbuv_stream_check_low_watermark(stream, rbuv_stream);
+    return;
+  }
+  rbuv_write_release(rbuv_write);
+  rbuv_request_unlink(&rbuv_stream->requests, &rbuv_write->link);
+
+  if (arg->status < 0) {
+    error = rbuv_error_new(arg->status);
+  } else {
+    error = Qnil;
   }
+  // RBUV_DEBUG_LOG_DETAIL("cb_on_write: %s, cbs_on_write: %s, error: %s",
+  //                     RSTRING_PTR(rb_inspect(cb_on_write)),
+  //                     RSTRING_PTR(rb_inspect(rbuv_stream->cbs_on_write)),
+  //                     RSTRING_PTR(rb_inspect(error)));
+
+  rbuv_call(cb_on_write, 1, error);
+  rbuv_stream_check_low_watermark(stream, rbuv_stream);
+}
+
+void rbuv_stream_on_shutdown(uv_shutdown_t *uv_req, int status) {
+  rbuv_stream_on_shutdown_arg_t arg = {
+    .uv_req = uv_req,
+    .status = status
+  };
+  rbuv_loop_defer(uv_req->handle->loop, (VALUE)uv_req->data,
+                  (rbuv_loop_deferred_cb)rbuv_stream_on_shutdown_no_gvl,
+                  &arg, sizeof(arg));
+}
+
+void rbuv_stream_on_shutdown_no_gvl(rbuv_stream_on_shutdown_arg_t *arg) {
+  rbuv_stream_t *rbuv_stream;
+  rbuv_shutdown_t *rbuv_shutdown;
+  VALUE request;
+  VALUE stream;
+  VALUE error;
+
+  request = (VALUE) arg->uv_req->data;
+  TypedData_Get_Struct(request, rbuv_shutdown_t, &rbuv_shutdown_type, rbuv_shutdown);
+  rbuv_shutdown->uv_req = NULL;
   stream = (VALUE) arg->uv_req->handle->data;
-  Data_Get_Struct(stream, rbuv_stream_t, rbuv_stream);
-  rbuv_ary_delete_same_object(rbuv_stream->requests, request);
+  TypedData_Get_Struct(stream, rbuv_stream_t, &rbuv_stream_type, rbuv_stream);
+  rbuv_request_unlink(&rbuv_stream->requests, &rbuv_shutdown->link);
 
   if (arg->status < 0) {
-    error = rb_exc_new2(eRbuvError, uv_strerror(arg->status));
+    error = rbuv_error_new(arg->status);
   } else {
     error = Qnil;
   }
-  rb_funcall(rbuv_shutdown->cb_on_shutdown, id_call, 1, error);
+  rbuv_call(rbuv_shutdown->cb_on_shutdown, 1, error);
 }
 
 void Init_rbuv_stream() {
   cRbuvStream = rb_define_class_under(mRbuv, "Stream", cRbuvHandle);
   rb_undef_alloc_func(cRbuvStream);
 
-  rb_define_method(cRbuvStream, "listen", rbuv_stream_listen, 1);
+  id_on_data = rb_intern("on_data");
+  id_on_eof = rb_intern("on_eof");
+  id_on_error = rb_intern("on_error");
+
+  rb_define_method(cRbuvStream, "listen", rbuv_stream_listen, -1);
   rb_define_method(cRbuvStream, "accept", rbuv_stream_accept, 1);
   rb_define_method(cRbuvStream, "readable?", rbuv_stream_is_readable, 0);
   rb_define_method(cRbuvStream, "writable?", rbuv_stream_is_writable, 0);
   rb_define_method(cRbuvStream, "shutdown", rbuv_stream_shutdown, 0);
-  rb_define_method(cRbuvStream, "read_start", rbuv_stream_read_start, 0);
-//  rb_define_method(cRbuvStream, "read2_start", rbuv_stream_read2_start, 0);
+  rb_define_method(cRbuvStream, "read_start", rbuv_stream_read_start, -1);
+  rb_define_method(cRbuvStream, "read2_start", rbuv_stream_read2_start, 0);
+  rb_define_method(cRbuvStream, "read_frames", rbuv_stream_read_frames, -1);
   rb_define_method(cRbuvStream, "read_stop", rbuv_stream_read_stop, 0);
+  rb_define_method(cRbuvStream, "pipe_to", rbuv_stream_pipe_to, -1);
   rb_define_method(cRbuvStream, "write", rbuv_stream_write, 1);
-//  rb_define_method(cRbuvStream, "write2", rbuv_stream_write2, 1);
+  rb_define_method(cRbuvStream, "try_write", rbuv_stream_try_write, 1);
+  rb_define_method(cRbuvStream, "on_error", rbuv_stream_on_error, 0);
+  rb_define_method(cRbuvStream, "write_queue_size", rbuv_stream_get_write_queue_size, 0);
+  rb_define_method(cRbuvStream, "send_buffer_size", rbuv_stream_get_send_buffer_size, 0);
+  rb_define_method(cRbuvStream, "send_buffer_size=", rbuv_stream_set_send_buffer_size, 1);
+  rb_define_method(cRbuvStream, "recv_buffer_size", rbuv_stream_get_recv_buffer_size, 0);
+  rb_define_method(cRbuvStream, "recv_buffer_size=", rbuv_stream_set_recv_buffer_size, 1);
+  rb_define_method(cRbuvStream, "write_watermarks", rbuv_stream_get_write_watermarks, 0);
+  rb_define_method(cRbuvStream, "set_write_watermarks", rbuv_stream_set_write_watermarks, 2);
+  rb_define_method(cRbuvStream, "writable_without_blocking?", rbuv_stream_is_writable_without_blocking, 0);
+  rb_define_method(cRbuvStream, "on_drain", rbuv_stream_on_drain, 0);
+  rb_define_method(cRbuvStream, "cork", rbuv_stream_cork, 0);
+  rb_define_method(cRbuvStream, "uncork", rbuv_stream_uncork, 0);
+  rb_define_method(cRbuvStream, "auto_cork=", rbuv_stream_set_auto_cork, 1);
+  rb_define_method(cRbuvStream, "auto_cork?", rbuv_stream_is_auto_cork, 0);
+  rb_define_method(cRbuvStream, "write2", rbuv_stream_write2, 2);
 }
 
 /* This have to be declared after Init_* so it can replace YARD bad assumption
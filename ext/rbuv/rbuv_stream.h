@@ -3,7 +3,87 @@
 
 #include "rbuv.h"
 
+/* Corked data is flushed once it reaches this size */
+#define RBUV_CORK_SIZE 65536
+/* Default write watermarks */
+#define RBUV_WRITE_HIGH_WATERMARK 65536
+#define RBUV_WRITE_LOW_WATERMARK 16384
+/* Size of the chunks forwarded by pipe_to */
+#define RBUV_PIPE_CHUNK_SIZE 65536
+
+/* listen(batch: true) accepts every pending connection */
+#define RBUV_ACCEPT_UNLIMITED UINT_MAX
+
+/* What the cb_on_read of a stream is */
+#define RBUV_READ_HANDLER 1          /* a handler object, not a block */
+#define RBUV_READ_HANDLER_ON_EOF 2   /* which responds to on_eof */
+#define RBUV_READ_HANDLER_ON_ERROR 4 /* which responds to on_error */
+#define RBUV_READ_HANDLES 8          /* a block given to read2_start */
+
+enum rbuv_cork_e {
+  RBUV_CORK_OFF = 0,
+  RBUV_CORK_MANUAL,
+  RBUV_CORK_AUTO
+};
+
+/* Forwarding set up by pipe_to */
+struct rbuv_stream_pipe_s {
+  uv_stream_t *source; /* NULL once the source let go of it */
+  VALUE target;
+  size_t high_water;
+  int paused;          /* reading stopped until the target drains */
+  int stopped;         /* EOF or an error was reached */
+  unsigned int writes; /* forwarded chunks being written */
+};
+typedef struct rbuv_stream_pipe_s rbuv_stream_pipe_t;
+
+/* Room for the uv handle embedded in every stream struct */
+union rbuv_stream_uv_u {
+  uv_stream_t stream;
+  uv_tcp_t tcp;
+  uv_pipe_t pipe;
+  uv_tty_t tty;
+};
+
+struct rbuv_stream_s {
+  uv_stream_t *uv_handle;
+  VALUE cb_on_close;
+  union rbuv_stream_uv_u uv;
+  VALUE cb_on_connection;
+  VALUE cb_on_read;
+  struct rbuv_request_link_s *requests; /* pending requests with a block */
+  VALUE read_buffer;
+  VALUE cb_on_error;
+  struct rbuv_write_s *writes; /* pending block-less writes */
+  int cork;
+  int cork_queued; /* listed in the corked streams of the loop */
+  char *cork_buf;
+  size_t cork_len;
+  size_t cork_capa;
+  size_t high_watermark;
+  size_t low_watermark;
+  int needs_drain; /* went over high_watermark, on_drain is due */
+  VALUE cb_on_drain;
+  rbuv_read_into_t *read_into; /* set by read_start(buffer:) */
+  rbuv_framer_t *framer; /* set by read_frames */
+  rbuv_stream_pipe_t *pipe; /* set by pipe_to */
+  int read_handler; /* RBUV_READ_HANDLER flags */
+  unsigned int accept_limit; /* set by listen(batch:), 0 when not batched */
+  int handles_counted; /* received handles given to deferred reads */
+  unsigned int read_generation; /* bumped when the reader is released */
+};
+typedef struct rbuv_stream_s rbuv_stream_t;
+
 extern VALUE cRbuvStream;
+extern const rb_data_type_t rbuv_stream_type;
 void Init_rbuv_stream();
 
+void rbuv_stream_alloc(rbuv_stream_t *rbuv_stream);
+void rbuv_stream_mark(rbuv_stream_t *rbuv_stream);
+void rbuv_stream_free(rbuv_stream_t *rbuv_stream);
+void rbuv_stream_compact(rbuv_stream_t *rbuv_stream);
+size_t rbuv_stream_memsize(const rbuv_stream_t *rbuv_stream);
+void rbuv_stream_flush_auto_cork(VALUE stream);
+void rbuv_stream_closed(rbuv_stream_t *rbuv_stream);
+
 #endif  /* RBUV_STREAM_H_ */
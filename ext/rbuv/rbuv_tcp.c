@@ -1,12 +1,42 @@
 #include "rbuv_tcp.h"
 
+#ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <sys/socket.h>
+# include <unistd.h>
+#endif
+
 struct rbuv_tcp_s {
   uv_tcp_t *uv_handle;
   VALUE cb_on_close;
+  union rbuv_stream_uv_u uv;
   VALUE cb_on_connection;
   VALUE cb_on_read;
-  VALUE requests;
+  struct rbuv_request_link_s *requests; /* pending requests with a block */
+  VALUE read_buffer;
+  VALUE cb_on_error;
+  struct rbuv_write_s *writes;
+  int cork;
+  int cork_queued;
+  char *cork_buf;
+  size_t cork_len;
+  size_t cork_capa;
+  size_t high_watermark;
+  size_t low_watermark;
+  int needs_drain;
+  VALUE cb_on_drain;
+  rbuv_read_into_t *read_into; /* set by read_start(buffer:) */
+  rbuv_framer_t *framer; /* set by read_frames */
+  rbuv_stream_pipe_t *pipe; /* set by pipe_to */
+  int read_handler;
+  unsigned int accept_limit;
+  int handles_counted;
+  unsigned int read_generation;
   VALUE cb_on_connect;
+  uv_connect_t uv_connect;
 };
 typedef struct rbuv_tcp_s rbuv_tcp_t;
 
@@ -22,38 +52,60 @@ VALUE cRbuvTcp;
 static VALUE rbuv_tcp_alloc(VALUE klass);
 static void rbuv_tcp_mark(rbuv_tcp_t *rbuv_tcp);
 static void rbuv_tcp_free(rbuv_tcp_t *rbuv_tcp);
+static void rbuv_tcp_compact(rbuv_tcp_t *rbuv_tcp);
+static size_t rbuv_tcp_memsize(const rbuv_tcp_t *rbuv_tcp);
+
+static const rb_data_type_t rbuv_tcp_type = {
+  .wrap_struct_name = "rbuv_tcp",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_tcp_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_tcp_free,
+    .dsize = (size_t (*)(const void *))rbuv_tcp_memsize,
+    RBUV_DCOMPACT(rbuv_tcp_compact)
+  },
+  .parent = &rbuv_stream_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_tcp_on_connect(uv_connect_t *uv_connect, int status);
 static void rbuv_tcp_on_connect_no_gvl(rbuv_tcp_on_connect_arg_t *arg);
+static int rbuv_tcp_reuseport(rbuv_tcp_t *rbuv_tcp, unsigned int *flags);
+static int rbuv_tcp_socket(rbuv_tcp_t *rbuv_tcp, uv_os_fd_t *fd);
+static int rbuv_tcp_fastopen_connect(rbuv_tcp_t *rbuv_tcp);
+static void rbuv_tcp_setsockopt(VALUE self, int level, int name,
+                                const void *value, size_t len);
 
 VALUE rbuv_tcp_alloc(VALUE klass) {
   rbuv_tcp_t *rbuv_tcp;
 
   rbuv_tcp = malloc(sizeof(*rbuv_tcp));
-  rbuv_handle_alloc((rbuv_handle_t *)rbuv_tcp);
-  rbuv_tcp->requests = rb_ary_new();
-  rbuv_tcp->cb_on_connection = Qnil;
-  rbuv_tcp->cb_on_read = Qnil;
+  rbuv_stream_alloc((rbuv_stream_t *)rbuv_tcp);
   rbuv_tcp->cb_on_connect = Qnil;
 
-  return Data_Wrap_Struct(klass, rbuv_tcp_mark, rbuv_tcp_free, rbuv_tcp);
+  return TypedData_Wrap_Struct(klass, &rbuv_tcp_type, rbuv_tcp);
 }
 
 void rbuv_tcp_mark(rbuv_tcp_t *rbuv_tcp) {
   assert(rbuv_tcp);
   RBUV_DEBUG_LOG_DETAIL("rbuv_tcp: %p, uv_handle: %p", rbuv_tcp, rbuv_tcp->uv_handle);
-  rbuv_handle_mark((rbuv_handle_t *)rbuv_tcp);
-  rb_gc_mark(rbuv_tcp->requests);
-  rb_gc_mark(rbuv_tcp->cb_on_connection);
-  rb_gc_mark(rbuv_tcp->cb_on_read);
-  rb_gc_mark(rbuv_tcp->cb_on_connect);
+  rbuv_stream_mark((rbuv_stream_t *)rbuv_tcp);
+  rb_gc_mark_movable(rbuv_tcp->cb_on_connect);
 }
 
 void rbuv_tcp_free(rbuv_tcp_t *rbuv_tcp) {
   RBUV_DEBUG_LOG_DETAIL("rbuv_tcp: %p, uv_handle: %p", rbuv_tcp, rbuv_tcp->uv_handle);
 
-  rbuv_handle_free((rbuv_handle_t *)rbuv_tcp);
+  rbuv_stream_free((rbuv_stream_t *)rbuv_tcp);
+}
+
+void rbuv_tcp_compact(rbuv_tcp_t *rbuv_tcp) {
+  rbuv_stream_compact((rbuv_stream_t *)rbuv_tcp);
+  RBUV_GC_UPDATE(rbuv_tcp->cb_on_connect);
+}
+
+size_t rbuv_tcp_memsize(const rbuv_tcp_t *rbuv_tcp) {
+  return sizeof(*rbuv_tcp) + rbuv_stream_memsize((const rbuv_stream_t *)rbuv_tcp);
 }
 
 /*
@@ -74,19 +126,32 @@ static VALUE rbuv_tcp_initialize(int argc, VALUE *argv, VALUE self) {
   rbuv_tcp_t *rbuv_tcp;
   rbuv_loop_t *rbuv_loop;
 
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  Data_Get_Struct(self, rbuv_tcp_t, rbuv_tcp);
-  rbuv_tcp->uv_handle = malloc(sizeof(*rbuv_tcp->uv_handle));
-  uv_ret = uv_tcp_init(rbuv_loop->uv_handle, rbuv_tcp->uv_handle);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  TypedData_Get_Struct(self, rbuv_tcp_t, &rbuv_tcp_type, rbuv_tcp);
+  uv_ret = uv_tcp_init(rbuv_loop->uv_handle, &rbuv_tcp->uv.tcp);
   if (uv_ret < 0) {
-    free(rbuv_tcp->uv_handle);
-    rbuv_tcp->uv_handle = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   }
+  rbuv_tcp->uv_handle = &rbuv_tcp->uv.tcp;
   rbuv_tcp->uv_handle->data = (void *)self;
   return self;
 }
 
+/* @overload open(fd)
+ * Use an existing socket, like a listening socket inherited from the process
+ * which started this one.
+ * @see Rbuv::Listener.inherit
+ * @param fd [Number] the file descriptor of the socket, the handle closes it
+ *   when it is closed
+ * @return [self] itself
+ */
+static VALUE rbuv_tcp_open(VALUE self, VALUE fd) {
+  rbuv_tcp_t *rbuv_tcp;
+  Data_Get_Handle_Struct(self, rbuv_tcp_t, rbuv_tcp);
+  RBUV_CHECK_UV_RETURN(uv_tcp_open(rbuv_tcp->uv_handle, (uv_os_sock_t)NUM2INT(fd)));
+  return self;
+}
+
 /* @overload enable_nodelay
  * Disable Nagle's algorithm.
  *
@@ -119,8 +184,9 @@ static VALUE rbuv_tcp_disable_nodelay(VALUE self) {
  */
 static VALUE rbuv_tcp_enable_keepalive(VALUE self, VALUE delay) {
   rbuv_tcp_t *rbuv_tcp;
+  unsigned int uv_delay = NUM2UINT(delay);
   Data_Get_Handle_Struct(self, rbuv_tcp_t, rbuv_tcp);
-  RBUV_CHECK_UV_RETURN(uv_tcp_keepalive(rbuv_tcp->uv_handle, 1, 1));
+  RBUV_CHECK_UV_RETURN(uv_tcp_keepalive(rbuv_tcp->uv_handle, 1, uv_delay));
   return self;
 }
 
@@ -169,6 +235,118 @@ static VALUE rbuv_tcp_disable_simultaneous_accepts(VALUE self) {
 }
 
 
+/* @overload defer_accept=(seconds)
+ * Only wake up a listening socket once data has arrived on a new connection,
+ * or after +seconds+ (+TCP_DEFER_ACCEPT+, Linux only). Set it after {#bind}.
+ * @param seconds [Number] 0 turns it off
+ * @raise [Rbuv::Error::ENOTSUP] if the platform does not support it
+ */
+static VALUE rbuv_tcp_set_defer_accept(VALUE self, VALUE seconds) {
+#ifdef TCP_DEFER_ACCEPT
+  int value = NUM2INT(seconds);
+  rbuv_tcp_setsockopt(self, IPPROTO_TCP, TCP_DEFER_ACCEPT, &value, sizeof(value));
+#else
+  rbuv_error_raise(UV_ENOTSUP);
+#endif
+  return seconds;
+}
+
+/* @overload quickack=(enable)
+ * Send ACKs right away instead of delaying them (+TCP_QUICKACK+, Linux only).
+ * The kernel may go back to delayed ACKs on its own, so it is usually set
+ * again after each read.
+ * @param enable [Boolean]
+ * @raise [Rbuv::Error::ENOTSUP] if the platform does not support it
+ */
+static VALUE rbuv_tcp_set_quickack(VALUE self, VALUE enable) {
+#ifdef TCP_QUICKACK
+  int value = RTEST(enable);
+  rbuv_tcp_setsockopt(self, IPPROTO_TCP, TCP_QUICKACK, &value, sizeof(value));
+#else
+  rbuv_error_raise(UV_ENOTSUP);
+#endif
+  return enable;
+}
+
+/* @overload user_timeout=(milliseconds)
+ * Abort the connection when sent data stays unacknowledged for
+ * +milliseconds+ (+TCP_USER_TIMEOUT+), instead of retransmitting for many
+ * minutes.
+ * @param milliseconds [Number] 0 restores the system default
+ * @raise [Rbuv::Error::ENOTSUP] if the platform does not support it
+ */
+static VALUE rbuv_tcp_set_user_timeout(VALUE self, VALUE milliseconds) {
+#ifdef TCP_USER_TIMEOUT
+  unsigned int value = NUM2UINT(milliseconds);
+  rbuv_tcp_setsockopt(self, IPPROTO_TCP, TCP_USER_TIMEOUT, &value, sizeof(value));
+#else
+  rbuv_error_raise(UV_ENOTSUP);
+#endif
+  return milliseconds;
+}
+
+/* @overload max_pacing_rate=(bytes_per_second)
+ * Cap the rate the kernel sends at (+SO_MAX_PACING_RATE+, Linux only), it
+ * spreads bursts out instead of overflowing the queues on the path.
+ * @param bytes_per_second [Number]
+ * @raise [Rbuv::Error::ENOTSUP] if the platform does not support it
+ */
+static VALUE rbuv_tcp_set_max_pacing_rate(VALUE self, VALUE bytes_per_second) {
+#ifdef SO_MAX_PACING_RATE
+  uint64_t rate = NUM2ULL(bytes_per_second);
+  unsigned int rate32;
+  if (rate <= UINT_MAX) {
+    // older kernels only take a 32 bits value
+    rate32 = (unsigned int)rate;
+    rbuv_tcp_setsockopt(self, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, sizeof(rate32));
+  } else {
+    rbuv_tcp_setsockopt(self, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate));
+  }
+#else
+  rbuv_error_raise(UV_ENOTSUP);
+#endif
+  return bytes_per_second;
+}
+
+/*
+ * Sets a socket option, the socket must exist.
+ */
+void rbuv_tcp_setsockopt(VALUE self, int level, int name,
+                         const void *value, size_t len) {
+#ifndef _WIN32
+  rbuv_tcp_t *rbuv_tcp;
+  uv_os_fd_t fd;
+
+  Data_Get_Handle_Struct(self, rbuv_tcp_t, rbuv_tcp);
+  RBUV_CHECK_UV_RETURN(uv_fileno((uv_handle_t *)rbuv_tcp->uv_handle, &fd));
+  if (setsockopt(fd, level, name, value, (socklen_t)len) < 0) {
+    rbuv_error_raise(uv_translate_sys_error(errno));
+  }
+#else
+  rbuv_error_raise(UV_ENOTSUP);
+#endif
+}
+
+/* @overload close_reset
+ * Close the connection by sending a RST packet instead of the usual FIN, the
+ * socket does not linger in TIME_WAIT. Pending writes are dropped.
+ * @yield (see Rbuv::Handle#close)
+ * @raise [Rbuv::Error::EINVAL] if a {#shutdown} is in progress
+ * @return [self] itself
+ */
+static VALUE rbuv_tcp_close_reset(VALUE self) {
+  rbuv_tcp_t *rbuv_tcp;
+  VALUE block;
+
+  block = rb_block_given_p() ? rb_block_proc() : Qnil;
+  Data_Get_Handle_Struct(self, rbuv_tcp_t, rbuv_tcp);
+  if (!uv_is_closing((uv_handle_t *)rbuv_tcp->uv_handle)) {
+    RBUV_CHECK_UV_RETURN(uv_tcp_close_reset(rbuv_tcp->uv_handle, rbuv_handle_on_close));
+    rbuv_tcp->cb_on_close = block;
+  }
+  return self;
+}
+
 static VALUE rbuv_tcp_getpeername(VALUE self) {
   rbuv_tcp_t *rbuv_tcp;
   Data_Get_Handle_Struct(self, rbuv_tcp_t, rbuv_tcp);
@@ -224,25 +402,41 @@ static VALUE rbuv_tcp_accept(int argc, VALUE *argv, VALUE self) {
   }
 }
 
-/* @overload bind(ip, port)
+/* @overload bind(ip, port, reuseport: false)
  * Bind this tcp object to the given address and port.
+ * @example One listener per worker process, the kernel balances them
+ *   server = Rbuv::Tcp.new
+ *   server.bind '0.0.0.0', 8080, reuseport: true
  * @param ip [String] the ip address to bind to
  * @param port [Number] the port to bind to
+ * @param reuseport [Boolean] set +SO_REUSEPORT+, so that several sockets,
+ *   usually in different processes, can listen on the same address and port.
+ *   The kernel spreads the incoming connections between them.
+ * @raise [Rbuv::Error::ENOTSUP] if +reuseport+ is not supported on this
+ *   platform
  * @return [self] itself
  */
-static VALUE rbuv_tcp_bind(VALUE self, VALUE ip, VALUE port) {
+static VALUE rbuv_tcp_bind(int argc, VALUE *argv, VALUE self) {
+  VALUE ip;
+  VALUE port;
+  VALUE options;
   const char *uv_ip;
   int uv_port;
+  unsigned int flags = 0;
   rbuv_tcp_t *rbuv_tcp;
   struct sockaddr_in bind_addr;
 
+  rb_scan_args(argc, argv, "2:", &ip, &port, &options);
   uv_ip = RSTRING_PTR(ip);
   uv_port = FIX2INT(port);
 
   uv_ip4_addr(uv_ip, uv_port, &bind_addr);
 
   Data_Get_Handle_Struct(self, rbuv_tcp_t, rbuv_tcp);
-  RBUV_CHECK_UV_RETURN(uv_tcp_bind(rbuv_tcp->uv_handle, (const struct sockaddr *) &bind_addr, 0));
+  if (!NIL_P(options) && RTEST(rb_hash_aref(options, ID2SYM(rb_intern("reuseport"))))) {
+    RBUV_CHECK_UV_RETURN(rbuv_tcp_reuseport(rbuv_tcp, &flags));
+  }
+  RBUV_CHECK_UV_RETURN(uv_tcp_bind(rbuv_tcp->uv_handle, (const struct sockaddr *) &bind_addr, flags));
 
   RBUV_DEBUG_LOG_DETAIL("self: %s, ip: %s, port: %d, rbuv_tcp: %p, uv_handle: %p",
                         RSTRING_PTR(rb_inspect(self)), uv_ip, uv_port, rbuv_tcp,
@@ -251,24 +445,154 @@ static VALUE rbuv_tcp_bind(VALUE self, VALUE ip, VALUE port) {
   return self;
 }
 
-/* @overload connect(ip, port)
+/*
+ * Gets ready to bind with SO_REUSEPORT. libuv 1.49 has a bind flag for it,
+ * older ones create the socket on bind, so it is created and opened here to
+ * set the option first.
+ */
+int rbuv_tcp_reuseport(rbuv_tcp_t *rbuv_tcp, unsigned int *flags) {
+#if UV_VERSION_HEX >= 0x013100
+  *flags |= UV_TCP_REUSEPORT;
+  return 0;
+#elif defined(SO_REUSEPORT) && !defined(_WIN32)
+  uv_os_fd_t fd;
+  int on = 1;
+  int uv_ret;
+
+  uv_ret = rbuv_tcp_socket(rbuv_tcp, &fd);
+  if (uv_ret < 0) {
+    return uv_ret;
+  }
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+    return uv_translate_sys_error(errno);
+  }
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+/*
+ * Gets the socket of the handle, libuv only creates it on bind, connect or
+ * listen so it is created and opened here when there is none yet.
+ */
+int rbuv_tcp_socket(rbuv_tcp_t *rbuv_tcp, uv_os_fd_t *fd) {
+#ifndef _WIN32
+  int uv_ret;
+
+  if (uv_fileno((uv_handle_t *)rbuv_tcp->uv_handle, fd) == 0) {
+    return 0;
+  }
+  // like the sockets of libuv, it must not leak into exec'd children
+#ifdef SOCK_CLOEXEC
+  *fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (*fd < 0) {
+    return uv_translate_sys_error(errno);
+  }
+#else
+  *fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (*fd < 0) {
+    return uv_translate_sys_error(errno);
+  }
+  if (fcntl(*fd, F_SETFD, FD_CLOEXEC) < 0) {
+    uv_ret = uv_translate_sys_error(errno);
+    close(*fd);
+    return uv_ret;
+  }
+#endif
+  uv_ret = uv_tcp_open(rbuv_tcp->uv_handle, *fd);
+  if (uv_ret < 0) {
+    close(*fd);
+    return uv_ret;
+  }
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+/*
+ * Asks the kernel to send the first write in the SYN, when it has a Fast Open
+ * cookie for the server. Platforms or kernels without TCP_FASTOPEN_CONNECT
+ * simply connect first, it is not an error.
+ */
+int rbuv_tcp_fastopen_connect(rbuv_tcp_t *rbuv_tcp) {
+#if defined(TCP_FASTOPEN_CONNECT) && !defined(_WIN32)
+  uv_os_fd_t fd;
+  int on = 1;
+  int uv_ret;
+
+  uv_ret = rbuv_tcp_socket(rbuv_tcp, &fd);
+  if (uv_ret < 0) {
+    return uv_ret;
+  }
+  if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &on, sizeof(on)) < 0 &&
+      errno != ENOPROTOOPT && errno != EOPNOTSUPP) {
+    return uv_translate_sys_error(errno);
+  }
+#endif
+  return 0;
+}
+
+/*
+ * Lets a listening socket accept data in the SYN of new connections, up to
+ * +qlen+ connections may wait for their handshake to finish.
+ */
+int rbuv_tcp_fastopen_listen(uv_tcp_t *uv_tcp, int qlen) {
+#if defined(TCP_FASTOPEN) && !defined(_WIN32)
+  uv_os_fd_t fd;
+  int uv_ret;
+
+  uv_ret = uv_fileno((uv_handle_t *)uv_tcp, &fd);
+  if (uv_ret < 0) {
+    return uv_ret;
+  }
+  if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) < 0) {
+    return uv_translate_sys_error(errno);
+  }
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+/* @overload connect(ip, port, data: nil)
  * Connect this tcp object to the given address and port.
+ * @example Sending the request in the SYN
+ *   client.connect('10.0.0.2', 80, data: "GET / HTTP/1.0\r\n\r\n") do |client, error|
+ *     client.read_start { ... } unless error
+ *   end
  * @param ip [String] the ip address to bind to
  * @param port [Number] the port to bind to
+ * @param data [String, nil] written as soon as the connection is made. With
+ *   TCP Fast Open (+TCP_FASTOPEN_CONNECT+ on Linux) it is sent in the SYN
+ *   when the kernel has a cookie from a previous connection to the server,
+ *   this saves a round trip. Otherwise it is written once connected. The
+ *   server must listen with +fastopen:+, see {Rbuv::Stream#listen}. Errors
+ *   writing it are given to {#on_error}.
  * @yield callback
  * @yieldparam stream [self]
  * @yieldparam error [Rbuv::Error, nil]
  * @return [self] itself
  */
-static VALUE rbuv_tcp_connect(VALUE self, VALUE ip, VALUE port) {
+static VALUE rbuv_tcp_connect(int argc, VALUE *argv, VALUE self) {
+  VALUE ip;
+  VALUE port;
+  VALUE options;
+  VALUE data;
   VALUE block;
   const char *uv_ip;
   int uv_port;
   rbuv_tcp_t *rbuv_tcp;
   struct sockaddr_in connect_addr;
-  uv_connect_t *uv_connect;
   int uv_ret;
 
+  rb_scan_args(argc, argv, "2:", &ip, &port, &options);
+  data = NIL_P(options) ? Qnil : rb_hash_aref(options, ID2SYM(rb_intern("data")));
+  if (!NIL_P(data)) {
+    StringValue(data);
+  }
+
   rb_need_block();
   block = rb_block_proc();
 
@@ -280,27 +604,33 @@ static VALUE rbuv_tcp_connect(VALUE self, VALUE ip, VALUE port) {
 
   uv_ret = uv_ip4_addr(uv_ip, uv_port, &connect_addr);
   if (uv_ret < 0) {
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
     return Qnil;
   }
   RBUV_DEBUG_LOG_DETAIL("self: %s, ip: %s, port: %d, rbuv_tcp: %p, uv_handle: %p",
                         RSTRING_PTR(rb_inspect(self)), uv_ip, uv_port, rbuv_tcp,
                         rbuv_tcp->uv_handle);
 
-  uv_connect = malloc(sizeof(*uv_connect));
-  uv_ret = uv_tcp_connect(uv_connect, rbuv_tcp->uv_handle,
+  if (!NIL_P(data)) {
+    RBUV_CHECK_UV_RETURN(rbuv_tcp_fastopen_connect(rbuv_tcp));
+  }
+  uv_ret = uv_tcp_connect(&rbuv_tcp->uv_connect, rbuv_tcp->uv_handle,
                                       (const struct sockaddr *) &connect_addr,
                                       rbuv_tcp_on_connect);
   if (uv_ret < 0) {
-    free(uv_connect);
-    uv_connect = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
     return Qnil;
   }
   RBUV_DEBUG_LOG_DETAIL("self: %s, ip: %s, port: %d, rbuv_tcp: %p, uv_handle: %p",
                         RSTRING_PTR(rb_inspect(self)), uv_ip, uv_port, rbuv_tcp,
                         rbuv_tcp->uv_handle);
 
+  // libuv holds the write until the socket is connected, with Fast Open the
+  // kernel then sends the SYN along with it
+  if (!NIL_P(data)) {
+    rb_funcall(self, rb_intern("write"), 1, data);
+  }
+
   return self;
 }
 
@@ -309,9 +639,9 @@ void rbuv_tcp_on_connect(uv_connect_t *uv_connect, int status) {
     .uv_handle = uv_connect->handle,
     .status = status
   };
-  free(uv_connect);
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)
-                          rbuv_tcp_on_connect_no_gvl, &arg);
+  rbuv_loop_defer(arg.uv_handle->loop, (VALUE)arg.uv_handle->data,
+                  (rbuv_loop_deferred_cb)rbuv_tcp_on_connect_no_gvl,
+                  &arg, sizeof(arg));
 }
 
 void rbuv_tcp_on_connect_no_gvl(rbuv_tcp_on_connect_arg_t *arg) {
@@ -337,20 +667,23 @@ void rbuv_tcp_on_connect_no_gvl(rbuv_tcp_on_connect_arg_t *arg) {
   if (status < 0) {
     RBUV_DEBUG_LOG_DETAIL("uv_stream: %p, status: %d, error: %s", uv_stream, status,
                           uv_strerror(status));
-    error = rb_exc_new2(eRbuvError, uv_strerror(status));
+    error = rbuv_error_new(status);
   } else {
     error = Qnil;
   }
-  rb_funcall(on_connect, id_call, 2, tcp, error);
+  rbuv_call(on_connect, 2, tcp, error);
 }
 
 void Init_rbuv_tcp() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_tcp_t, uv);
+
   cRbuvTcp = rb_define_class_under(mRbuv, "Tcp", cRbuvStream);
   rb_define_alloc_func(cRbuvTcp, rbuv_tcp_alloc);
 
   rb_define_method(cRbuvTcp, "initialize", rbuv_tcp_initialize, -1);
-  rb_define_method(cRbuvTcp, "bind", rbuv_tcp_bind, 2);
-  rb_define_method(cRbuvTcp, "connect", rbuv_tcp_connect, 2);
+  rb_define_method(cRbuvTcp, "open", rbuv_tcp_open, 1);
+  rb_define_method(cRbuvTcp, "bind", rbuv_tcp_bind, -1);
+  rb_define_method(cRbuvTcp, "connect", rbuv_tcp_connect, -1);
   rb_define_method(cRbuvTcp, "accept", rbuv_tcp_accept, -1);
   rb_define_method(cRbuvTcp, "enable_keepalive", rbuv_tcp_enable_keepalive, 1);
   rb_define_method(cRbuvTcp, "disable_keepalive",
@@ -361,6 +694,11 @@ void Init_rbuv_tcp() {
                    rbuv_tcp_enable_simultaneous_accepts, 0);
   rb_define_method(cRbuvTcp, "disable_simultaneous_accepts",
                    rbuv_tcp_disable_simultaneous_accepts, 0);
+  rb_define_method(cRbuvTcp, "defer_accept=", rbuv_tcp_set_defer_accept, 1);
+  rb_define_method(cRbuvTcp, "quickack=", rbuv_tcp_set_quickack, 1);
+  rb_define_method(cRbuvTcp, "user_timeout=", rbuv_tcp_set_user_timeout, 1);
+  rb_define_method(cRbuvTcp, "max_pacing_rate=", rbuv_tcp_set_max_pacing_rate, 1);
+  rb_define_method(cRbuvTcp, "close_reset", rbuv_tcp_close_reset, 0);
   rb_define_method(cRbuvTcp, "peername", rbuv_tcp_getpeername, 0);
   rb_define_method(cRbuvTcp, "sockname", rbuv_tcp_getsockname, 0);
 }
@@ -7,4 +7,6 @@ extern VALUE cRbuvTcp;
 
 void Init_rbuv_tcp();
 
+int rbuv_tcp_fastopen_listen(uv_tcp_t *uv_tcp, int qlen);
+
 #endif  /* RBUV_TCP_H_ */
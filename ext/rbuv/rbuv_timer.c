@@ -5,17 +5,39 @@ VALUE cRbuvTimer;
 struct rbuv_timer_s {
   uv_timer_t *uv_handle;
   VALUE cb_on_close;
+  uv_timer_t uv_timer;
   VALUE cb_on_timeout;
+  unsigned int generation; /* bumped by start and stop */
 };
 typedef struct rbuv_timer_s rbuv_timer_t;
 
+struct rbuv_timer_on_timeout_arg_s {
+  uv_timer_t *uv_timer;
+  unsigned int generation;
+};
+typedef struct rbuv_timer_on_timeout_arg_s rbuv_timer_on_timeout_arg_t;
+
 static VALUE rbuv_timer_alloc(VALUE klass);
 static void rbuv_timer_mark(rbuv_timer_t *rbuv_timer);
 static void rbuv_timer_free(rbuv_timer_t *rbuv_timer);
+static void rbuv_timer_compact(rbuv_timer_t *rbuv_timer);
+static size_t rbuv_timer_memsize(const rbuv_timer_t *rbuv_timer);
+
+static const rb_data_type_t rbuv_timer_type = {
+  .wrap_struct_name = "rbuv_timer",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_timer_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_timer_free,
+    .dsize = (size_t (*)(const void *))rbuv_timer_memsize,
+    RBUV_DCOMPACT(rbuv_timer_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
 
 /* Private methods */
 static void rbuv_timer_on_timeout(uv_timer_t *uv_timer);
-static void rbuv_timer_on_timeout_no_gvl(uv_timer_t *uv_timer);
+static void rbuv_timer_on_timeout_no_gvl(rbuv_timer_on_timeout_arg_t *arg);
 
 VALUE rbuv_timer_alloc(VALUE klass) {
   rbuv_timer_t *rbuv_timer;
@@ -23,13 +45,14 @@ VALUE rbuv_timer_alloc(VALUE klass) {
   rbuv_timer = malloc(sizeof(*rbuv_timer));
   rbuv_handle_alloc((rbuv_handle_t *)rbuv_timer);
   rbuv_timer->cb_on_timeout = Qnil;
-  return Data_Wrap_Struct(klass, rbuv_timer_mark, rbuv_timer_free, rbuv_timer);
+  rbuv_timer->generation = 0;
+  return TypedData_Wrap_Struct(klass, &rbuv_timer_type, rbuv_timer);
 }
 
 void rbuv_timer_mark(rbuv_timer_t *rbuv_timer) {
   assert(rbuv_timer);
   rbuv_handle_mark((rbuv_handle_t *)rbuv_timer);
-  rb_gc_mark(rbuv_timer->cb_on_timeout);
+  rb_gc_mark_movable(rbuv_timer->cb_on_timeout);
 }
 
 void rbuv_timer_free(rbuv_timer_t *rbuv_timer) {
@@ -39,6 +62,15 @@ void rbuv_timer_free(rbuv_timer_t *rbuv_timer) {
   rbuv_handle_free((rbuv_handle_t *)rbuv_timer);
 }
 
+static void rbuv_timer_compact(rbuv_timer_t *rbuv_timer) {
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_timer);
+  RBUV_GC_UPDATE(rbuv_timer->cb_on_timeout);
+}
+
+static size_t rbuv_timer_memsize(const rbuv_timer_t *rbuv_timer) {
+  return sizeof(*rbuv_timer);
+}
+
 /*
  * @overload initialize(loop=nil)
  *   Create a new handle that fires on specified timeouts.
@@ -58,15 +90,13 @@ static VALUE rbuv_timer_initialize(int argc, VALUE *argv, VALUE self) {
     loop = rbuv_loop_s_default(cRbuvLoop);
   }
 
-  Data_Get_Struct(self, rbuv_timer_t, rbuv_timer);
-  Data_Get_Struct(loop, rbuv_loop_t, rbuv_loop);
-  rbuv_timer->uv_handle = malloc(sizeof(*rbuv_timer->uv_handle));
-  uv_ret = uv_timer_init(rbuv_loop->uv_handle, rbuv_timer->uv_handle);
+  TypedData_Get_Struct(self, rbuv_timer_t, &rbuv_timer_type, rbuv_timer);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+  uv_ret = uv_timer_init(rbuv_loop->uv_handle, &rbuv_timer->uv_timer);
   if (uv_ret < 0) {
-    free(rbuv_timer->uv_handle);
-    rbuv_timer->uv_handle = NULL;
-    rb_raise(eRbuvError, "%s", uv_strerror(uv_ret));
+    rbuv_error_raise(uv_ret);
   }
+  rbuv_timer->uv_handle = &rbuv_timer->uv_timer;
   rbuv_timer->uv_handle->data = (void *)self;
 
   return self;
@@ -93,6 +123,7 @@ VALUE rbuv_timer_start(VALUE self, VALUE timeout, VALUE repeat) {
 
   Data_Get_Handle_Struct(self, rbuv_timer_t, rbuv_timer);
   rbuv_timer->cb_on_timeout = block;
+  rbuv_timer->generation++;
 
   RBUV_DEBUG_LOG_DETAIL("rbuv_timer: %p, uv_handle: %p, rbuv_timer_on_timeout: %p, timer: %s",
                         rbuv_timer, rbuv_timer->uv_handle, rbuv_timer_on_timeout,
@@ -114,6 +145,7 @@ VALUE rbuv_timer_stop(VALUE self) {
   Data_Get_Handle_Struct(self, rbuv_timer_t, rbuv_timer);
 
   uv_timer_stop(rbuv_timer->uv_handle);
+  rbuv_timer->generation++;
 
   return self;
 }
@@ -142,21 +174,36 @@ VALUE rbuv_timer_repeat_set(VALUE self, VALUE repeat) {
 }
 
 void rbuv_timer_on_timeout(uv_timer_t *uv_timer) {
-  rb_thread_call_with_gvl((rbuv_rb_blocking_function_t)
-                          rbuv_timer_on_timeout_no_gvl, uv_timer);
+  rbuv_timer_t *rbuv_timer = RBUV_HANDLE_OF(uv_timer);
+  rbuv_timer_on_timeout_arg_t arg = {
+    .uv_timer = uv_timer,
+    .generation = rbuv_timer->generation
+  };
+  rbuv_loop_defer(uv_timer->loop, (VALUE)uv_timer->data,
+                  (rbuv_loop_deferred_cb)rbuv_timer_on_timeout_no_gvl, &arg, sizeof(arg));
 }
 
-void rbuv_timer_on_timeout_no_gvl(uv_timer_t *uv_timer) {
+void rbuv_timer_on_timeout_no_gvl(rbuv_timer_on_timeout_arg_t *arg) {
+  uv_timer_t *uv_timer = arg->uv_timer;
   VALUE timer;
   rbuv_timer_t *rbuv_timer;
 
+  // a callback earlier in the batch may have stopped, restarted or closed it
+  if (uv_is_closing((uv_handle_t *)uv_timer)) {
+    return;
+  }
   timer = (VALUE)uv_timer->data;
   Data_Get_Handle_Struct(timer, struct rbuv_timer_s, rbuv_timer);
+  if (arg->generation != rbuv_timer->generation) {
+    return;
+  }
 
-  rb_funcall(rbuv_timer->cb_on_timeout, id_call, 1, timer);
+  rbuv_call(rbuv_timer->cb_on_timeout, 1, timer);
 }
 
 void Init_rbuv_timer() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_timer_t, uv_timer);
+
   cRbuvTimer = rb_define_class_under(mRbuv, "Timer", cRbuvHandle);
   rb_define_alloc_func(cRbuvTimer, rbuv_timer_alloc);
 
@@ -0,0 +1,569 @@
+#include "rbuv_timer_wheel.h"
+
+VALUE cRbuvTimerWheel;
+
+/* The end of a slot list, or of the free list */
+#define RBUV_TIMER_WHEEL_NIL UINT32_MAX
+#define RBUV_TIMER_WHEEL_GENERATION_MASK 0x7fffffff
+
+struct rbuv_timer_wheel_entry_s {
+  VALUE value;
+  uint64_t expires;    /* the tick it is due on */
+  uint32_t prev;
+  uint32_t next;       /* also links the free entries */
+  uint32_t generation; /* bumped on release, so that stale ids do not match */
+  int pending;
+};
+typedef struct rbuv_timer_wheel_entry_s rbuv_timer_wheel_entry_t;
+
+struct rbuv_timer_wheel_s {
+  uv_timer_t *uv_handle;
+  VALUE cb_on_close;
+  uv_timer_t uv_timer;
+  VALUE cb_on_timeout;
+  int started;
+  uint64_t tick;    /* in milliseconds */
+  uint64_t origin;  /* the loop time of tick 0 */
+  uint64_t current; /* the last tick delivered */
+  uint32_t *slots;  /* the first entry of every slot */
+  uint32_t mask;    /* the number of slots - 1 */
+  rbuv_timer_wheel_entry_t *entries;
+  uint32_t entries_capa;
+  uint32_t entries_used; /* entries past it were never used */
+  uint32_t free_head;
+  uint32_t count;   /* pending entries */
+};
+typedef struct rbuv_timer_wheel_s rbuv_timer_wheel_t;
+
+struct rbuv_timer_wheel_on_tick_arg_s {
+  uv_timer_t *uv_timer;
+};
+typedef struct rbuv_timer_wheel_on_tick_arg_s rbuv_timer_wheel_on_tick_arg_t;
+
+static VALUE rbuv_timer_wheel_alloc(VALUE klass);
+static void rbuv_timer_wheel_mark(rbuv_timer_wheel_t *rbuv_wheel);
+static void rbuv_timer_wheel_free(rbuv_timer_wheel_t *rbuv_wheel);
+static void rbuv_timer_wheel_compact(rbuv_timer_wheel_t *rbuv_wheel);
+static size_t rbuv_timer_wheel_memsize(const rbuv_timer_wheel_t *rbuv_wheel);
+
+static const rb_data_type_t rbuv_timer_wheel_type = {
+  .wrap_struct_name = "rbuv_timer_wheel",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_timer_wheel_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_timer_wheel_free,
+    .dsize = (size_t (*)(const void *))rbuv_timer_wheel_memsize,
+    RBUV_DCOMPACT(rbuv_timer_wheel_compact)
+  },
+  .parent = &rbuv_handle_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+/* Private methods */
+static void rbuv_timer_wheel_on_tick(uv_timer_t *uv_timer);
+static void rbuv_timer_wheel_on_tick_no_gvl(rbuv_timer_wheel_on_tick_arg_t *arg);
+static void rbuv_timer_wheel_arm(rbuv_timer_wheel_t *rbuv_wheel);
+static uint64_t rbuv_timer_wheel_now(rbuv_timer_wheel_t *rbuv_wheel);
+static uint64_t rbuv_timer_wheel_expires(rbuv_timer_wheel_t *rbuv_wheel, VALUE timeout);
+static rbuv_timer_wheel_entry_t *rbuv_timer_wheel_find(rbuv_timer_wheel_t *rbuv_wheel,
+                                                       VALUE id, uint32_t *index);
+static void rbuv_timer_wheel_link(rbuv_timer_wheel_t *rbuv_wheel, uint32_t index);
+static void rbuv_timer_wheel_unlink(rbuv_timer_wheel_t *rbuv_wheel, uint32_t index);
+static void rbuv_timer_wheel_release(rbuv_timer_wheel_t *rbuv_wheel, uint32_t index);
+
+VALUE rbuv_timer_wheel_alloc(VALUE klass) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+
+  rbuv_wheel = malloc(sizeof(*rbuv_wheel));
+  rbuv_handle_alloc((rbuv_handle_t *)rbuv_wheel);
+  rbuv_wheel->cb_on_timeout = Qnil;
+  rbuv_wheel->started = 0;
+  rbuv_wheel->tick = RBUV_TIMER_WHEEL_TICK;
+  rbuv_wheel->origin = 0;
+  rbuv_wheel->current = 0;
+  rbuv_wheel->slots = NULL;
+  rbuv_wheel->mask = 0;
+  rbuv_wheel->entries = NULL;
+  rbuv_wheel->entries_capa = 0;
+  rbuv_wheel->entries_used = 0;
+  rbuv_wheel->free_head = RBUV_TIMER_WHEEL_NIL;
+  rbuv_wheel->count = 0;
+  return TypedData_Wrap_Struct(klass, &rbuv_timer_wheel_type, rbuv_wheel);
+}
+
+void rbuv_timer_wheel_mark(rbuv_timer_wheel_t *rbuv_wheel) {
+  uint32_t i;
+
+  assert(rbuv_wheel);
+  rbuv_handle_mark((rbuv_handle_t *)rbuv_wheel);
+  rb_gc_mark_movable(rbuv_wheel->cb_on_timeout);
+  for (i = 0; i < rbuv_wheel->entries_used; i++) {
+    if (rbuv_wheel->entries[i].pending) {
+      rb_gc_mark_movable(rbuv_wheel->entries[i].value);
+    }
+  }
+}
+
+void rbuv_timer_wheel_free(rbuv_timer_wheel_t *rbuv_wheel) {
+  assert(rbuv_wheel);
+  RBUV_DEBUG_LOG_DETAIL("rbuv_wheel: %p, uv_handle: %p", rbuv_wheel, rbuv_wheel->uv_handle);
+
+  free(rbuv_wheel->slots);
+  free(rbuv_wheel->entries);
+  rbuv_wheel->slots = NULL;
+  rbuv_wheel->entries = NULL;
+  rbuv_wheel->entries_used = 0;
+  rbuv_handle_free((rbuv_handle_t *)rbuv_wheel);
+}
+
+static void rbuv_timer_wheel_compact(rbuv_timer_wheel_t *rbuv_wheel) {
+  uint32_t i;
+
+  rbuv_handle_compact((rbuv_handle_t *)rbuv_wheel);
+  RBUV_GC_UPDATE(rbuv_wheel->cb_on_timeout);
+  for (i = 0; i < rbuv_wheel->entries_used; i++) {
+    if (rbuv_wheel->entries[i].pending) {
+      RBUV_GC_UPDATE(rbuv_wheel->entries[i].value);
+    }
+  }
+}
+
+static size_t rbuv_timer_wheel_memsize(const rbuv_timer_wheel_t *rbuv_wheel) {
+  return sizeof(*rbuv_wheel) +
+         ((size_t)rbuv_wheel->mask + 1) * sizeof(*rbuv_wheel->slots) +
+         rbuv_wheel->entries_capa * sizeof(*rbuv_wheel->entries);
+}
+
+/*
+ * @overload initialize(loop=nil, tick: 10, slots: 512)
+ *   Create a new wheel, it is driven by a single timer however many entries
+ *   are scheduled.
+ *
+ *   @param loop [Rbuv::Loop, nil] loop object where this handle runs, if it is
+ *     +nil+ then it the runs the handle in the {Rbuv::Loop.default}
+ *   @param tick [Number] the resolution of the wheel in milliseconds, entries
+ *     are due on the first tick after their timeout
+ *   @param slots [Number] the number of slots, rounded up to a power of 2.
+ *     Timeouts longer than +tick * slots+ go around the wheel more than
+ *     once, the entries sharing a slot are visited on every turn.
+ *   @return [Rbuv::TimerWheel]
+ */
+static VALUE rbuv_timer_wheel_initialize(int argc, VALUE *argv, VALUE self) {
+  VALUE loop;
+  VALUE options;
+  VALUE tick;
+  VALUE slots;
+  rbuv_timer_wheel_t *rbuv_wheel;
+  rbuv_loop_t *rbuv_loop;
+  uint32_t uv_slots = RBUV_TIMER_WHEEL_SLOTS;
+  uint32_t count = 1;
+  uint32_t i;
+  int uv_ret;
+
+  rb_scan_args(argc, argv, "01:", &loop, &options);
+  if (loop == Qnil) {
+    loop = rbuv_loop_s_default(cRbuvLoop);
+  }
+
+  TypedData_Get_Struct(self, rbuv_timer_wheel_t, &rbuv_timer_wheel_type, rbuv_wheel);
+  TypedData_Get_Struct(loop, rbuv_loop_t, &rbuv_loop_type, rbuv_loop);
+
+  if (!NIL_P(options)) {
+    tick = rb_hash_aref(options, ID2SYM(rb_intern("tick")));
+    slots = rb_hash_aref(options, ID2SYM(rb_intern("slots")));
+    if (!NIL_P(tick)) {
+      rbuv_wheel->tick = NUM2ULL(tick);
+    }
+    if (!NIL_P(slots)) {
+      uv_slots = NUM2UINT(slots);
+    }
+  }
+  if (rbuv_wheel->tick == 0) {
+    rb_raise(rb_eArgError, "tick must be positive");
+  }
+  if (uv_slots == 0 || uv_slots > (1U << 24)) {
+    rb_raise(rb_eArgError, "slots must be between 1 and 16777216");
+  }
+  while (count < uv_slots) {
+    count <<= 1;
+  }
+
+  uv_ret = uv_timer_init(rbuv_loop->uv_handle, &rbuv_wheel->uv_timer);
+  if (uv_ret < 0) {
+    rbuv_error_raise(uv_ret);
+  }
+  rbuv_wheel->uv_handle = &rbuv_wheel->uv_timer;
+  rbuv_wheel->uv_handle->data = (void *)self;
+
+  rbuv_wheel->slots = malloc(count * sizeof(*rbuv_wheel->slots));
+  if (rbuv_wheel->slots == NULL) {
+    rb_memerror();
+  }
+  for (i = 0; i < count; i++) {
+    rbuv_wheel->slots[i] = RBUV_TIMER_WHEEL_NIL;
+  }
+  rbuv_wheel->mask = count - 1;
+  rbuv_wheel->origin = uv_now(rbuv_loop->uv_handle);
+
+  return self;
+}
+
+/*
+ * @overload start
+ *   Start delivering the due entries.
+ *   @yield called once per tick with every entry due on it
+ *   @yieldparam values [Array] the values of the due entries, in the order of
+ *     their ticks
+ *   @return [self] itself
+ */
+static VALUE rbuv_timer_wheel_start(VALUE self) {
+  VALUE block;
+  rbuv_timer_wheel_t *rbuv_wheel;
+
+  rb_need_block();
+  block = rb_block_proc();
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  rbuv_wheel->cb_on_timeout = block;
+  rbuv_wheel->started = 1;
+  rbuv_timer_wheel_arm(rbuv_wheel);
+
+  return self;
+}
+
+/*
+ * Stop delivering the due entries, they stay scheduled and are delivered once
+ * started again.
+ *
+ * @return [self] itself
+ */
+static VALUE rbuv_timer_wheel_stop(VALUE self) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  rbuv_wheel->started = 0;
+  uv_timer_stop(rbuv_wheel->uv_handle);
+
+  return self;
+}
+
+/*
+ * @overload schedule(timeout, value)
+ *   Schedule +value+ to be delivered after +timeout+. It takes constant time,
+ *   whatever the number of entries.
+ *   @param timeout [Number] the timeout in milliseconds
+ *   @param value [Object] yielded to the {#start} block when due
+ *   @return [Integer] the id of the entry, for {#cancel} and {#reschedule}
+ */
+static VALUE rbuv_timer_wheel_schedule(VALUE self, VALUE timeout, VALUE value) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+  rbuv_timer_wheel_entry_t *entry;
+  uint32_t index;
+  uint32_t capa;
+  void *entries;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+
+  if (rbuv_wheel->free_head != RBUV_TIMER_WHEEL_NIL) {
+    index = rbuv_wheel->free_head;
+    rbuv_wheel->free_head = rbuv_wheel->entries[index].next;
+  } else {
+    if (rbuv_wheel->entries_used == rbuv_wheel->entries_capa) {
+      if (rbuv_wheel->entries_capa >= RBUV_TIMER_WHEEL_NIL / 2) {
+        rb_raise(rb_eRangeError, "too many entries");
+      }
+      capa = rbuv_wheel->entries_capa == 0 ? 64 : rbuv_wheel->entries_capa * 2;
+      entries = realloc(rbuv_wheel->entries, capa * sizeof(*rbuv_wheel->entries));
+      if (entries == NULL) {
+        rb_memerror();
+      }
+      rbuv_wheel->entries = entries;
+      rbuv_wheel->entries_capa = capa;
+    }
+    index = rbuv_wheel->entries_used++;
+    rbuv_wheel->entries[index].generation = 0;
+  }
+
+  if (rbuv_wheel->count == 0) {
+    // nothing was pending, the ticks in between have nothing to deliver
+    rbuv_wheel->current = rbuv_timer_wheel_now(rbuv_wheel);
+  }
+  entry = &rbuv_wheel->entries[index];
+  entry->value = value;
+  entry->pending = 1;
+  entry->expires = rbuv_timer_wheel_expires(rbuv_wheel, timeout);
+  rbuv_timer_wheel_link(rbuv_wheel, index);
+  rbuv_wheel->count++;
+  rbuv_timer_wheel_arm(rbuv_wheel);
+
+  return ULL2NUM(((uint64_t)entry->generation << 32) | index);
+}
+
+/*
+ * @overload cancel(id)
+ *   Cancel an entry, in constant time.
+ *   @param id [Integer] the id returned by {#schedule}
+ *   @return [Object, nil] the value of the entry, +nil+ if it was not pending
+ */
+static VALUE rbuv_timer_wheel_cancel(VALUE self, VALUE id) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+  rbuv_timer_wheel_entry_t *entry;
+  uint32_t index;
+  VALUE value;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  entry = rbuv_timer_wheel_find(rbuv_wheel, id, &index);
+  if (entry == NULL) {
+    return Qnil;
+  }
+  value = entry->value;
+  rbuv_timer_wheel_unlink(rbuv_wheel, index);
+  rbuv_timer_wheel_release(rbuv_wheel, index);
+  if (rbuv_wheel->count == 0) {
+    uv_timer_stop(rbuv_wheel->uv_handle);
+  }
+  return value;
+}
+
+/*
+ * @overload reschedule(id, timeout)
+ *   Push back an entry, in constant time. Usually done on every read or
+ *   write of a connection with an idle timeout.
+ *   @param id [Integer] the id returned by {#schedule}
+ *   @param timeout [Number] the new timeout in milliseconds, from now
+ *   @return [Boolean] +false+ if the entry was not pending
+ */
+static VALUE rbuv_timer_wheel_reschedule(VALUE self, VALUE id, VALUE timeout) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+  rbuv_timer_wheel_entry_t *entry;
+  uint32_t index;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  entry = rbuv_timer_wheel_find(rbuv_wheel, id, &index);
+  if (entry == NULL) {
+    return Qfalse;
+  }
+  rbuv_timer_wheel_unlink(rbuv_wheel, index);
+  entry->expires = rbuv_timer_wheel_expires(rbuv_wheel, timeout);
+  rbuv_timer_wheel_link(rbuv_wheel, index);
+  return Qtrue;
+}
+
+/*
+ * @overload pending?(id)
+ *   @param id [Integer] the id returned by {#schedule}
+ *   @return [Boolean] whether the entry is still to be delivered
+ */
+static VALUE rbuv_timer_wheel_is_pending(VALUE self, VALUE id) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+  uint32_t index;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  return rbuv_timer_wheel_find(rbuv_wheel, id, &index) != NULL ? Qtrue : Qfalse;
+}
+
+/*
+ * @return [Integer] the number of pending entries
+ */
+static VALUE rbuv_timer_wheel_size(VALUE self) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  return UINT2NUM(rbuv_wheel->count);
+}
+
+/*
+ * @return [Integer] the length of a tick in milliseconds
+ */
+static VALUE rbuv_timer_wheel_get_tick(VALUE self) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  return ULL2NUM(rbuv_wheel->tick);
+}
+
+/*
+ * @return [Integer] the number of slots
+ */
+static VALUE rbuv_timer_wheel_get_slots(VALUE self) {
+  rbuv_timer_wheel_t *rbuv_wheel;
+
+  Data_Get_Handle_Struct(self, rbuv_timer_wheel_t, rbuv_wheel);
+  return UINT2NUM(rbuv_wheel->mask + 1);
+}
+
+/*
+ * The timer only runs while entries are pending, so that an idle wheel does
+ * not wake the loop up.
+ */
+void rbuv_timer_wheel_arm(rbuv_timer_wheel_t *rbuv_wheel) {
+  if (rbuv_wheel->started && rbuv_wheel->count > 0 &&
+      !uv_is_active((uv_handle_t *)rbuv_wheel->uv_handle)) {
+    uv_timer_start(rbuv_wheel->uv_handle, rbuv_timer_wheel_on_tick,
+                   rbuv_wheel->tick, rbuv_wheel->tick);
+  }
+}
+
+/* The tick the loop time is in */
+uint64_t rbuv_timer_wheel_now(rbuv_timer_wheel_t *rbuv_wheel) {
+  return (uv_now(rbuv_wheel->uv_handle->loop) - rbuv_wheel->origin) / rbuv_wheel->tick;
+}
+
+/* The first tick after +timeout+, never one already delivered */
+uint64_t rbuv_timer_wheel_expires(rbuv_timer_wheel_t *rbuv_wheel, VALUE timeout) {
+  LONG_LONG uv_timeout = NUM2LL(timeout);
+  uint64_t elapsed;
+  uint64_t expires;
+
+  if (uv_timeout < 0) {
+    rb_raise(rb_eArgError, "timeout must not be negative");
+  }
+  elapsed = uv_now(rbuv_wheel->uv_handle->loop) - rbuv_wheel->origin;
+  expires = (elapsed + (uint64_t)uv_timeout + rbuv_wheel->tick - 1) / rbuv_wheel->tick;
+  return expires > rbuv_wheel->current ? expires : rbuv_wheel->current + 1;
+}
+
+/* The pending entry with that id, NULL if it was delivered or canceled */
+rbuv_timer_wheel_entry_t *rbuv_timer_wheel_find(rbuv_timer_wheel_t *rbuv_wheel,
+                                                VALUE id, uint32_t *index) {
+  uint64_t uv_id = NUM2ULL(id);
+  rbuv_timer_wheel_entry_t *entry;
+
+  *index = (uint32_t)(uv_id & 0xffffffff);
+  if (*index >= rbuv_wheel->entries_used) {
+    return NULL;
+  }
+  entry = &rbuv_wheel->entries[*index];
+  if (!entry->pending || entry->generation != (uv_id >> 32)) {
+    return NULL;
+  }
+  return entry;
+}
+
+void rbuv_timer_wheel_link(rbuv_timer_wheel_t *rbuv_wheel, uint32_t index) {
+  rbuv_timer_wheel_entry_t *entry = &rbuv_wheel->entries[index];
+  uint32_t *head = &rbuv_wheel->slots[entry->expires & rbuv_wheel->mask];
+
+  entry->prev = RBUV_TIMER_WHEEL_NIL;
+  entry->next = *head;
+  if (*head != RBUV_TIMER_WHEEL_NIL) {
+    rbuv_wheel->entries[*head].prev = index;
+  }
+  *head = index;
+}
+
+void rbuv_timer_wheel_unlink(rbuv_timer_wheel_t *rbuv_wheel, uint32_t index) {
+  rbuv_timer_wheel_entry_t *entry = &rbuv_wheel->entries[index];
+
+  if (entry->prev != RBUV_TIMER_WHEEL_NIL) {
+    rbuv_wheel->entries[entry->prev].next = entry->next;
+  } else {
+    rbuv_wheel->slots[entry->expires & rbuv_wheel->mask] = entry->next;
+  }
+  if (entry->next != RBUV_TIMER_WHEEL_NIL) {
+    rbuv_wheel->entries[entry->next].prev = entry->prev;
+  }
+}
+
+void rbuv_timer_wheel_release(rbuv_timer_wheel_t *rbuv_wheel, uint32_t index) {
+  rbuv_timer_wheel_entry_t *entry = &rbuv_wheel->entries[index];
+
+  entry->value = Qnil;
+  entry->pending = 0;
+  entry->generation = (entry->generation + 1) & RBUV_TIMER_WHEEL_GENERATION_MASK;
+  entry->next = rbuv_wheel->free_head;
+  rbuv_wheel->free_head = index;
+  rbuv_wheel->count--;
+}
+
+void rbuv_timer_wheel_on_tick(uv_timer_t *uv_timer) {
+  rbuv_timer_wheel_on_tick_arg_t arg = { .uv_timer = uv_timer };
+  rbuv_loop_defer(uv_timer->loop, (VALUE)uv_timer->data,
+                  (rbuv_loop_deferred_cb)rbuv_timer_wheel_on_tick_no_gvl, &arg, sizeof(arg));
+}
+
+/*
+ * Takes the entries due since the last tick delivered off the wheel and
+ * yields them at once. After a long pause every slot is visited once.
+ */
+void rbuv_timer_wheel_on_tick_no_gvl(rbuv_timer_wheel_on_tick_arg_t *arg) {
+  VALUE wheel;
+  VALUE values;
+  rbuv_timer_wheel_t *rbuv_wheel;
+  rbuv_timer_wheel_entry_t *entry;
+  uint64_t now;
+  uint64_t tick;
+  uint64_t last;
+  uint32_t index;
+  uint32_t next;
+
+  wheel = (VALUE)arg->uv_timer->data;
+  TypedData_Get_Struct(wheel, rbuv_timer_wheel_t, &rbuv_timer_wheel_type, rbuv_wheel);
+  if (rbuv_wheel->uv_handle == NULL || !rbuv_wheel->started ||
+      uv_is_closing((uv_handle_t *)arg->uv_timer)) {
+    return;
+  }
+
+  now = rbuv_timer_wheel_now(rbuv_wheel);
+  if (now <= rbuv_wheel->current) {
+    return;
+  }
+  last = now - rbuv_wheel->current > (uint64_t)rbuv_wheel->mask + 1 ?
+         rbuv_wheel->current + rbuv_wheel->mask + 1 : now;
+  values = rb_ary_new();
+  for (tick = rbuv_wheel->current + 1; tick <= last; tick++) {
+    index = rbuv_wheel->slots[tick & rbuv_wheel->mask];
+    while (index != RBUV_TIMER_WHEEL_NIL) {
+      entry = &rbuv_wheel->entries[index];
+      next = entry->next;
+      if (entry->expires <= now) {
+        rb_ary_push(values, entry->value);
+        rbuv_timer_wheel_unlink(rbuv_wheel, index);
+        rbuv_timer_wheel_release(rbuv_wheel, index);
+      }
+      index = next;
+    }
+  }
+  rbuv_wheel->current = now;
+  if (rbuv_wheel->count == 0) {
+    uv_timer_stop(rbuv_wheel->uv_handle);
+  }
+
+  if (RARRAY_LEN(values) > 0) {
+    rbuv_call(rbuv_wheel->cb_on_timeout, 1, values);
+  }
+}
+
+void Init_rbuv_timer_wheel() {
+  RBUV_HANDLE_CHECK_LAYOUT(rbuv_timer_wheel_t, uv_timer);
+
+  cRbuvTimerWheel = rb_define_class_under(mRbuv, "TimerWheel", cRbuvHandle);
+  rb_define_alloc_func(cRbuvTimerWheel, rbuv_timer_wheel_alloc);
+
+  rb_define_method(cRbuvTimerWheel, "initialize", rbuv_timer_wheel_initialize, -1);
+  rb_define_method(cRbuvTimerWheel, "start", rbuv_timer_wheel_start, 0);
+  rb_define_method(cRbuvTimerWheel, "stop", rbuv_timer_wheel_stop, 0);
+  rb_define_method(cRbuvTimerWheel, "schedule", rbuv_timer_wheel_schedule, 2);
+  rb_define_method(cRbuvTimerWheel, "cancel", rbuv_timer_wheel_cancel, 1);
+  rb_define_method(cRbuvTimerWheel, "reschedule", rbuv_timer_wheel_reschedule, 2);
+  rb_define_method(cRbuvTimerWheel, "pending?", rbuv_timer_wheel_is_pending, 1);
+  rb_define_method(cRbuvTimerWheel, "size", rbuv_timer_wheel_size, 0);
+  rb_define_method(cRbuvTimerWheel, "tick", rbuv_timer_wheel_get_tick, 0);
+  rb_define_method(cRbuvTimerWheel, "slots", rbuv_timer_wheel_get_slots, 0);
+}
+
+/*
+ * Document-class: Rbuv::TimerWheel < Rbuv::Handle
+ * A hashed timer wheel: many timeouts, like the idle timeouts of every
+ * connection, share one timer instead of one {Rbuv::Timer} each. Entries are
+ * scheduled, canceled and rescheduled in constant time, and the ones due on a
+ * tick are yielded together.
+ *
+ * @example Idle timeouts
+ *   wheel = Rbuv::TimerWheel.new(loop, tick: 100)
+ *   wheel.start { |clients| clients.each(&:close) }
+ *   id = wheel.schedule(30_000, client)
+ *   client.read_start do |data, error|
+ *     wheel.reschedule(id, 30_000)
+ *     ...
+ *   end
+ */
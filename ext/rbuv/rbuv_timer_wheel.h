@@ -0,0 +1,15 @@
+#ifndef RBUV_TIMER_WHEEL_H_
+#define RBUV_TIMER_WHEEL_H_
+
+#include "rbuv.h"
+
+/* Default length of a tick, in milliseconds */
+#define RBUV_TIMER_WHEEL_TICK 10
+/* Default number of slots, always rounded up to a power of 2 */
+#define RBUV_TIMER_WHEEL_SLOTS 512
+
+extern VALUE cRbuvTimerWheel;
+
+void Init_rbuv_timer_wheel();
+
+#endif  /* RBUV_TIMER_WHEEL_H_ */
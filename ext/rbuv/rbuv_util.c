@@ -1,4 +1,6 @@
 #include "rbuv_util.h"
+#include <stdarg.h>
+
 #ifndef INET_ADDRSTRLEN
 #define INET_ADDRSTRLEN 16
 #endif
@@ -39,6 +41,27 @@ int rbuv_util_extractname2(struct sockaddr* sockname, int namelen, VALUE *ip, VA
   }
 }
 
+/*
+ * Calls a callback with +argc+ VALUEs. Blocks are Procs and are called
+ * directly, without looking up and dispatching #call.
+ */
+VALUE rbuv_call(VALUE callback, int argc, ...) {
+  VALUE argv[RBUV_CALL_MAX_ARGS];
+  va_list ap;
+  int i;
+
+  assert(argc <= RBUV_CALL_MAX_ARGS);
+  va_start(ap, argc);
+  for (i = 0; i < argc; i++) {
+    argv[i] = va_arg(ap, VALUE);
+  }
+  va_end(ap);
+  if (rb_obj_is_proc(callback)) {
+    return rb_proc_call_with_block(callback, argc, argv, Qnil);
+  }
+  return rb_funcallv(callback, id_call, argc, argv);
+}
+
 typedef struct {
   VALUE args;
   VALUE (* proc)(ANYARGS);
@@ -59,15 +82,5 @@ void rbuv_run_callback(VALUE callback, VALUE (* proc)(ANYARGS), VALUE args) {
     .proc = proc
   };
   VALUE result_arr = rb_rescue(rbuv_run_callback_begin, (VALUE)&arg, rbuv_run_callback_rescue, Qnil);
-  rb_funcall(callback, id_call, 2, rb_ary_entry(result_arr, 0), rb_ary_entry(result_arr, 1));
-}
-
-void rbuv_ary_delete_same_object(VALUE ary, VALUE obj) {
-  long i;
-  for (i = 0; i < RARRAY_LEN(ary); i++) {
-    if (rb_ary_entry(ary, i) == obj) {
-      rb_ary_delete_at(ary, i);
-      break;
-    }
-  }
+  rbuv_call(callback, 2, rb_ary_entry(result_arr, 0), rb_ary_entry(result_arr, 1));
 }
@@ -5,7 +5,10 @@
 
 VALUE rbuv_util_extractname(struct sockaddr* sockname, int namelen);
 int rbuv_util_extractname2(struct sockaddr* sockname, int namelen, VALUE *ip, VALUE *port);
+/* Most arguments rbuv_call passes to a callback */
+#define RBUV_CALL_MAX_ARGS 4
+
+VALUE rbuv_call(VALUE callback, int argc, ...);
 void rbuv_run_callback(VALUE callback, VALUE (* proc)(ANYARGS), VALUE args);
-void rbuv_ary_delete_same_object(VALUE ary, VALUE obj);
 
 #endif  /* RBUV_UTIL_H_ */
@@ -2,24 +2,215 @@
 
 VALUE cRbuvStreamWriteRequest;
 
+const rb_data_type_t rbuv_write_type = {
+  .wrap_struct_name = "rbuv_write",
+  .function = {
+    .dmark = (RUBY_DATA_FUNC)rbuv_write_mark,
+    .dfree = (RUBY_DATA_FUNC)rbuv_write_free,
+    .dsize = (size_t (*)(const void *))rbuv_write_memsize,
+    RBUV_DCOMPACT(rbuv_write_compact)
+  },
+  .parent = &rbuv_request_type,
+  .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
 void rbuv_write_mark(rbuv_write_t* rbuv_write) {
   rbuv_request_mark((rbuv_request_t *)rbuv_write);
-  rb_gc_mark(rbuv_write->cb_on_write);
+  rb_gc_mark_movable(rbuv_write->cb_on_write);
+  rbuv_write_mark_data(rbuv_write);
   if (rbuv_write->uv_req != NULL) {
     rb_gc_mark((VALUE)rbuv_write->uv_req->handle->data);
   }
 }
+
 void rbuv_write_free(rbuv_write_t* rbuv_write) {
-  if (rbuv_write->uv_buf.base != NULL) {
-    free(rbuv_write->uv_buf.base);
-    rbuv_write->uv_buf.base = NULL;
+  rbuv_write_release(rbuv_write);
+  free(rbuv_write);
+}
+
+void rbuv_write_compact(rbuv_write_t *rbuv_write) {
+  RBUV_GC_UPDATE(rbuv_write->cb_on_write);
+}
+
+size_t rbuv_write_memsize(const rbuv_write_t *rbuv_write) {
+  size_t size = sizeof(*rbuv_write) + rbuv_write->copy_capa;
+  if (rbuv_write->strs != &rbuv_write->str) {
+    size += rbuv_write->nstrs * sizeof(VALUE);
+  }
+  return size;
+}
+
+/*
+ * Copy buffers hold the data of writes outside of the Ruby heap, the GC is
+ * told about them so it runs as often as if they were Strings.
+ */
+char *rbuv_write_copy_resize(char *copy, size_t capa, size_t new_capa) {
+  copy = realloc(copy, new_capa);
+  rb_gc_adjust_memory_usage((ssize_t)new_capa - (ssize_t)capa);
+  return copy;
+}
+
+void rbuv_write_copy_free(char *copy, size_t capa) {
+  if (copy != NULL) {
+    free(copy);
+    rb_gc_adjust_memory_usage(-(ssize_t)capa);
+  }
+}
+
+rbuv_write_t *rbuv_write_new(VALUE cb_on_write) {
+  rbuv_write_t *rbuv_write;
+
+  rbuv_write = malloc(sizeof(*rbuv_write));
+  rbuv_write->uv_req = NULL;
+  rbuv_write->cb_on_write = cb_on_write;
+  rbuv_write->nstrs = 0;
+  rbuv_write->str = Qnil;
+  rbuv_write->strs = &rbuv_write->str;
+  rbuv_write->copy = NULL;
+  rbuv_write->copy_capa = 0;
+  rbuv_write->send_handle = Qnil;
+  rbuv_write->prev = NULL;
+  rbuv_write->next = NULL;
+  rbuv_request_link_init(&rbuv_write->link);
+  return rbuv_write;
+}
+
+/*
+ * Points +uv_bufs+ to the data of +data+, a String, an IO::Buffer or an Array
+ * of them.
+ *
+ * Frozen strings are written from their own memory and marked until the write
+ * completes, rb_gc_mark pins them so compaction does not move them. With
+ * +share+ other strings become copy-on-write through rb_str_new_frozen, so
+ * changing them later does not touch the data being written. Without it they
+ * are copied into C memory and no Ruby object is allocated.
+ *
+ * +rbuv_write+ must already be reachable by the GC.
+ */
+void rbuv_write_set_data(rbuv_write_t *rbuv_write, VALUE data,
+                         unsigned int nbufs, uv_buf_t *uv_bufs, int share) {
+  unsigned int i;
+  size_t copy_len;
+  VALUE str;
+  const char *base;
+  size_t len;
+
+  if (nbufs > 1) {
+    rbuv_write->strs = ALLOC_N(VALUE, nbufs);
+  }
+  copy_len = 0;
+  for (i = 0; i < nbufs; i++) {
+    str = RBUV_WRITE_DATA_ENTRY(data, i);
+    rbuv_write->strs[i] = Qnil;
+    if (!RBUV_WRITE_CAN_SHARE(str, share)) {
+      rbuv_buffer_get_bytes(str, &base, &len);
+      copy_len += len;
+    }
+  }
+  rbuv_write->nstrs = nbufs;
+  if (copy_len > rbuv_write->copy_capa) {
+    rbuv_write_copy_free(rbuv_write->copy, rbuv_write->copy_capa);
+    rbuv_write->copy = rbuv_write_copy_resize(NULL, 0, copy_len);
+    rbuv_write->copy_capa = copy_len;
+  }
+
+  // IO::Buffers are always copied, their memory can be resized or freed
+  copy_len = 0;
+  for (i = 0; i < nbufs; i++) {
+    str = RBUV_WRITE_DATA_ENTRY(data, i);
+    if (RBUV_WRITE_CAN_SHARE(str, share)) {
+      str = rb_str_new_frozen(str);
+      rbuv_write->strs[i] = str;
+      uv_bufs[i] = uv_buf_init(RSTRING_PTR(str), (unsigned int)RSTRING_LEN(str));
+    } else {
+      rbuv_buffer_get_bytes(str, &base, &len);
+      uv_bufs[i] = uv_buf_init(rbuv_write->copy + copy_len, (unsigned int)len);
+      memcpy(uv_bufs[i].base, base, len);
+      copy_len += len;
+    }
+  }
+}
+
+void rbuv_write_mark_data(rbuv_write_t *rbuv_write) {
+  unsigned int i;
+  for (i = 0; i < rbuv_write->nstrs; i++) {
+    rb_gc_mark(rbuv_write->strs[i]);
+  }
+  rb_gc_mark(rbuv_write->send_handle);
+}
+
+/*
+ * Drops the data of a completed write.
+ */
+void rbuv_write_release(rbuv_write_t *rbuv_write) {
+  if (rbuv_write->strs != &rbuv_write->str) {
+    xfree(rbuv_write->strs);
+    rbuv_write->strs = &rbuv_write->str;
+  }
+  rbuv_write->nstrs = 0;
+  rbuv_write->str = Qnil;
+  rbuv_write->send_handle = Qnil;
+  rbuv_write_copy_free(rbuv_write->copy, rbuv_write->copy_capa);
+  rbuv_write->copy = NULL;
+  rbuv_write->copy_capa = 0;
+}
+
+/*
+ * Block-less writes have no Ruby object, so their structs can be reused. Each
+ * loop keeps the completed ones, with their copy buffer, for the next writes.
+ * Writes with a block belong to their Rbuv::Stream::WriteRequest and are freed
+ * by the GC.
+ */
+rbuv_write_t *rbuv_write_get(uv_loop_t *uv_loop) {
+  rbuv_loop_t *rbuv_loop = RTYPEDDATA_DATA((VALUE)uv_loop->data);
+  rbuv_write_t *rbuv_write = rbuv_loop->spare_writes;
+
+  if (rbuv_write == NULL) {
+    rbuv_loop->stats_write_pool_misses++;
+    return rbuv_write_new(Qnil);
+  }
+  rbuv_loop->stats_write_pool_hits++;
+  rbuv_loop->spare_writes = rbuv_write->next;
+  rbuv_loop->spare_writes_count--;
+  rbuv_write->prev = NULL;
+  rbuv_write->next = NULL;
+  return rbuv_write;
+}
+
+void rbuv_write_put(uv_loop_t *uv_loop, rbuv_write_t *rbuv_write) {
+  rbuv_loop_t *rbuv_loop = RTYPEDDATA_DATA((VALUE)uv_loop->data);
+  char *copy = rbuv_write->copy;
+  size_t copy_capa = rbuv_write->copy_capa;
+
+  if (rbuv_loop->spare_writes_count >= RBUV_WRITE_POOL_SIZE) {
+    rbuv_write_free(rbuv_write);
+    return;
+  }
+  rbuv_write->copy = NULL;
+  rbuv_write_release(rbuv_write);
+  if (copy_capa <= RBUV_WRITE_POOL_COPY_LIMIT) {
+    rbuv_write->copy = copy;
+    rbuv_write->copy_capa = copy_capa;
+  } else {
+    rbuv_write_copy_free(copy, copy_capa);
+  }
+  rbuv_write->next = rbuv_loop->spare_writes;
+  rbuv_loop->spare_writes = rbuv_write;
+  rbuv_loop->spare_writes_count++;
+}
+
+void rbuv_write_free_spares(rbuv_loop_t *rbuv_loop) {
+  rbuv_write_t *rbuv_write;
+  while ((rbuv_write = rbuv_loop->spare_writes) != NULL) {
+    rbuv_loop->spare_writes = rbuv_write->next;
+    rbuv_write_free(rbuv_write);
   }
-  rbuv_request_free((rbuv_request_t *)rbuv_write);
+  rbuv_loop->spare_writes_count = 0;
 }
 
 static VALUE rbuv_write_get_handle(VALUE self) {
   rbuv_write_t *rbuv_write;
-  Data_Get_Struct(self, rbuv_write_t, rbuv_write);
+  TypedData_Get_Struct(self, rbuv_write_t, &rbuv_write_type, rbuv_write);
   if (rbuv_write->uv_req == NULL) {
     return Qnil;
   } else {
@@ -3,16 +3,55 @@
 
 #include "rbuv.h"
 
-typedef struct {
-  uv_write_t *uv_req;
-  uv_buf_t uv_buf;
+/* Arrays up to this size are written without allocating a uv_buf_t array */
+#define RBUV_WRITE_BUFS_SMALL 16
+
+/* Spare block-less writes kept by each loop */
+#define RBUV_WRITE_POOL_SIZE 256
+/* A spare write keeps its copy buffer up to this size */
+#define RBUV_WRITE_POOL_COPY_LIMIT 65536
+
+/* The i-th buffer of the data given to a write */
+#define RBUV_WRITE_DATA_ENTRY(data, i) \
+  (TYPE(data) == T_ARRAY ? rb_ary_entry((data), (i)) : (data))
+/* Whether a buffer can be written from its own memory */
+#define RBUV_WRITE_CAN_SHARE(str, share) \
+  (TYPE(str) == T_STRING && ((share) || OBJ_FROZEN(str)))
+
+typedef struct rbuv_write_s rbuv_write_t;
+struct rbuv_write_s {
+  uv_write_t *uv_req; /* points to uv_write while the write is pending */
   VALUE cb_on_write;
-} rbuv_write_t;
+  unsigned int nstrs;
+  VALUE str;   /* storage of strs for single String writes */
+  VALUE *strs; /* the frozen Strings being written, nil for copied ones */
+  char *copy;  /* the data of mutable Strings of block-less writes */
+  size_t copy_capa;
+  VALUE send_handle; /* the handle sent by write2, nil otherwise */
+  rbuv_write_t *prev; /* block-less writes of the same stream */
+  rbuv_write_t *next;
+  rbuv_request_link_t link; /* in the requests of the stream */
+  uv_write_t uv_write;
+};
 
 extern VALUE cRbuvStreamWriteRequest;
+extern const rb_data_type_t rbuv_write_type;
 
 void rbuv_write_mark(rbuv_write_t* rbuv_write);
 void rbuv_write_free(rbuv_write_t* rbuv_write);
+void rbuv_write_compact(rbuv_write_t *rbuv_write);
+size_t rbuv_write_memsize(const rbuv_write_t *rbuv_write);
+char *rbuv_write_copy_resize(char *copy, size_t capa, size_t new_capa);
+void rbuv_write_copy_free(char *copy, size_t capa);
+rbuv_write_t *rbuv_write_new(VALUE cb_on_write);
+void rbuv_write_set_data(rbuv_write_t *rbuv_write, VALUE data,
+                         unsigned int nbufs, uv_buf_t *uv_bufs, int share);
+void rbuv_write_mark_data(rbuv_write_t *rbuv_write);
+void rbuv_write_release(rbuv_write_t *rbuv_write);
+rbuv_write_t *rbuv_write_get(uv_loop_t *uv_loop);
+void rbuv_write_put(uv_loop_t *uv_loop, rbuv_write_t *rbuv_write);
+struct rbuv_loop_s;
+void rbuv_write_free_spares(struct rbuv_loop_s *rbuv_loop);
 void Init_rbuv_write();
 
 #endif  /* RBUV_WRITE_H_ */
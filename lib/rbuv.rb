@@ -3,6 +3,9 @@ require 'rbuv/version'
 require 'rbuv/timer'
 require 'rbuv/signal'
 require 'rbuv/loop'
+require 'rbuv/prefork'
+require 'rbuv/listener'
+require 'rbuv/tcp/pool'
 
 module Rbuv
   class << self
@@ -0,0 +1,67 @@
+require 'socket'
+
+module Rbuv
+  # Passes listening sockets to a new process the way systemd socket
+  # activation does: the sockets are file descriptors 3 and up, and the
+  # +LISTEN_FDS+ environment variable tells how many there are.
+  #
+  # A server restarting without closing its listeners spawns its replacement
+  # with {.spawn}. The new process picks them up with {.inherit}, and the old
+  # one stops accepting. Connections waiting in the backlog are accepted by the
+  # new process, none is refused.
+  #
+  # @example The new process
+  #   server = Rbuv::Listener.inherit.first
+  #   server ||= Rbuv::Tcp.new.bind('0.0.0.0', 8080)
+  #   server.listen(128) { ... }
+  # @example The old process, on SIGHUP
+  #   Rbuv::Listener.spawn([server], 'ruby', 'server.rb')
+  #   server.close
+  module Listener
+    # The first inherited file descriptor
+    LISTEN_FDS_START = 3
+
+    class << self
+      # Wraps the listening sockets given by the parent process or systemd.
+      #
+      # The +LISTEN_*+ variables are removed from +ENV+ so that child processes
+      # do not inherit the sockets again.
+      # @param loop [Rbuv::Loop] the loop of the handles
+      # @return [Array<Rbuv::Tcp, Rbuv::Pipe>] the inherited listeners, in
+      #   order, empty when there are none or they are meant for another
+      #   process
+      def inherit(loop = Loop.default)
+        pid = ENV.delete('LISTEN_PID')
+        count = ENV.delete('LISTEN_FDS').to_i
+        ENV.delete('LISTEN_FDNAMES')
+        return [] if pid && pid.to_i != Process.pid
+        Array.new(count) do |i|
+          fd = LISTEN_FDS_START + i
+          handle_class(fd).new(loop).open(fd)
+        end
+      end
+
+      # Starts a process which inherits +listeners+, see {.inherit}.
+      # @param listeners [Array<Rbuv::Tcp, Rbuv::Pipe>] the listeners
+      # @param command [Array<String>] the command and its arguments, as for
+      #   +Process.spawn+
+      # @return [Integer] the pid of the new process
+      def spawn(listeners, *command)
+        env = { 'LISTEN_FDS' => listeners.size.to_s }
+        options = {}
+        listeners.each_with_index do |listener, i|
+          options[LISTEN_FDS_START + i] = listener.fileno
+        end
+        Process.spawn(env, *command, options)
+      end
+
+      private
+
+      def handle_class(fd)
+        socket = Socket.for_fd(fd)
+        socket.autoclose = false
+        socket.local_address.unix? ? Pipe : Tcp
+      end
+    end
+  end
+end
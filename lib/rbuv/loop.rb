@@ -6,12 +6,26 @@ module Rbuv
       Tcp.new(self)
     end
 
+    # creates a {Rbuv::Pipe} associate with this loop
+    # @param ipc [Boolean] whether handles can be passed over the pipe
+    # @return [Rbuv::Pipe] a fresh {Rbuv::Pipe} instance
+    def pipe(ipc: false)
+      Pipe.new(self, ipc: ipc)
+    end
+
     # creates a {Rbuv::Timer} associate with this loop
     # @return [Rbuv::Timer] a fresh {Rbuv::Timer} instance
     def timer
       Timer.new(self)
     end
 
+    # creates a {Rbuv::TimerWheel} associate with this loop
+    # @param options (see Rbuv::TimerWheel#initialize)
+    # @return [Rbuv::TimerWheel] a fresh {Rbuv::TimerWheel} instance
+    def timer_wheel(**options)
+      TimerWheel.new(self, **options)
+    end
+
     # creates a {Rbuv::Signal} associate with this loop
     # @return [Rbuv::Signal] a fresh {Rbuv::Signal} instance
     def signal
@@ -0,0 +1,113 @@
+require 'etc'
+
+module Rbuv
+  # Runs a server in several worker processes, so that it uses more than one
+  # core. Every worker runs its own {Rbuv::Loop.default} and usually binds its
+  # own listener with +reuseport: true+, the kernel then spreads the incoming
+  # connections between them.
+  #
+  # The process calling {#run} supervises the workers: it restarts the ones
+  # which crash and stops all of them on +INT+ or +TERM+.
+  #
+  # @example
+  #   Rbuv::Prefork.new(4) do |index|
+  #     server = Rbuv::Tcp.new
+  #     server.bind '0.0.0.0', 8080, reuseport: true
+  #     server.listen(128) { ... }
+  #   end.run
+  class Prefork
+    # Signals which stop the workers
+    STOP_SIGNALS = %w(INT TERM).freeze
+
+    # @return [Integer] the number of workers
+    attr_reader :size
+
+    # @param size [Integer] the number of workers
+    # @param restart_delay [Numeric] seconds to wait before restarting a
+    #   worker which crashed
+    # @yield Called in every worker, right before its loop runs. The worker
+    #   exits when its loop has nothing left to do.
+    # @yieldparam index [Integer] the index of the worker, from 0 to
+    #   +size - 1+, a restarted worker gets the index of the one it replaces
+    # @raise [ArgumentError] if no block is given
+    def initialize(size = Etc.nprocessors, restart_delay: 0.1, &block)
+      raise ArgumentError, "a block is required" unless block
+      @size = size
+      @restart_delay = restart_delay
+      @block = block
+      @workers = {}
+      @stopping = false
+    end
+
+    # @return [Array<Integer>] the pids of the running workers
+    def pids
+      @workers.keys
+    end
+
+    # Forks the workers and supervises them until they have all exited.
+    #
+    # Workers which exit successfully are not replaced, the others are
+    # restarted unless {#stop} was called.
+    # @return [self] itself
+    def run
+      @stopping = false
+      previous_traps = STOP_SIGNALS.map do |signame|
+        [signame, trap(signame) { stop(signame) }]
+      end
+      @size.times { |index| spawn(index) }
+      until @workers.empty?
+        pid, status = Process.wait2
+        index = @workers.delete(pid)
+        next if index.nil? || @stopping || status.success?
+        sleep @restart_delay
+        spawn(index) unless @stopping
+      end
+      self
+    ensure
+      previous_traps.each { |signame, handler| trap(signame, handler) } if previous_traps
+    end
+
+    # Stops the workers, they close every handle of their loop and exit.
+    # @param signame [String] the signal sent to the workers, +TERM+ or +INT+
+    # @return [self] itself
+    def stop(signame = "TERM")
+      @stopping = true
+      pids.each do |pid|
+        begin
+          Process.kill(signame, pid)
+        rescue Errno::ESRCH
+        end
+      end
+      self
+    end
+
+    private
+
+    def spawn(index)
+      pid = Process.fork { work(index) }
+      @workers[pid] = index
+      pid
+    end
+
+    def work(index)
+      loop = Loop.default
+      loop.after_fork
+      STOP_SIGNALS.each do |signame|
+        trap(signame, "DEFAULT")
+      end
+      loop.run do
+        STOP_SIGNALS.each do |signame|
+          Signal.start(loop, ::Signal.list[signame]) do
+            loop.handles.each { |handle| handle.close unless handle.closing? }
+          end.unref
+        end
+        @block.call(index)
+      end
+      # at_exit handlers belong to the supervisor
+      exit!(true)
+    rescue Exception => e
+      warn "#{e.class}: #{e.message}\n\t#{e.backtrace.join("\n\t")}"
+      exit!(false)
+    end
+  end
+end
@@ -0,0 +1,289 @@
+require 'socket'
+
+module Rbuv
+  class Tcp
+    # Keeps connections to backends open between requests, so that each
+    # request does not pay for a handshake and leave a socket in TIME_WAIT.
+    #
+    # Connections are grouped by address. A connection is taken with
+    # {#checkout} and given back with {#checkin} once the response has been
+    # read, or thrown away with {#discard} when it is in an unknown state.
+    # Idle connections are watched: the ones the server closes and the ones
+    # idle for longer than +idle_timeout+ are closed. They do not keep the loop
+    # alive.
+    #
+    # @example
+    #   pool = Rbuv::Tcp::Pool.new(max_idle: 4, max_active: 16)
+    #   pool.checkout('10.0.0.2', 6379) do |tcp, error|
+    #     next warn(error.message) if error
+    #     tcp.write "PING\r\n"
+    #     tcp.read_start do |data, read_error|
+    #       tcp.read_stop
+    #       read_error ? pool.discard(tcp) : pool.checkin(tcp)
+    #     end
+    #   end
+    class Pool
+      # @return [Rbuv::Loop] the loop of the connections
+      attr_reader :loop
+      # @return [Integer] the most idle connections kept per address
+      attr_reader :max_idle
+      # @return [Integer] the most connections per address, connecting or
+      #   checked out
+      attr_reader :max_active
+      # @return [Numeric] seconds an idle connection is kept
+      attr_reader :idle_timeout
+
+      # @param loop [Rbuv::Loop] the loop of the connections
+      # @param max_idle [Integer] the most idle connections kept per address
+      # @param max_active [Integer] the most connections per address,
+      #   connecting or checked out, other checkouts wait for one of them
+      # @param idle_timeout [Numeric] seconds an idle connection is kept
+      def initialize(loop = Loop.default, max_idle: 8, max_active: 64, idle_timeout: 60)
+        @loop = loop
+        @max_idle = max_idle
+        @max_active = max_active
+        @idle_timeout = idle_timeout
+        @idle = {}      # address => [[tcp, deadline], ...], the oldest first
+        @active = {}    # address => connecting and checked out connections
+        @waiters = {}   # address => [[ip, port, block], ...]
+        @addresses = {}.compare_by_identity # checked out tcp => address
+        @stats = { hits: 0, misses: 0, waits: 0, expired: 0, broken: 0 }
+        @timer = nil
+        @closed = false
+      end
+
+      # Takes a connection to +ip+ and +port+: the idle connection used last,
+      # a new connection, or the first one checked in when there are already
+      # +max_active+.
+      # @param ip [String] the ip address of the server
+      # @param port [Integer] the port of the server
+      # @yield called right away when an idle connection is reused, otherwise
+      #   once connected
+      # @yieldparam tcp [Rbuv::Tcp, nil] the connection, give it back with
+      #   {#checkin} or {#discard}
+      # @yieldparam error [Rbuv::Error, nil] the error connecting, or
+      #   +Rbuv::Error::ECANCELED+ if the pool was closed while waiting
+      # @raise [ArgumentError] if no block is given
+      # @raise [IOError] if the pool is closed
+      # @return [self] itself
+      def checkout(ip, port, &block)
+        raise ArgumentError, "a block is required" unless block
+        raise IOError, "closed pool" if @closed
+        address = "#{ip}:#{port}"
+        tcp = take_idle(address)
+        if tcp
+          @stats[:hits] += 1
+          @active[address] = @active.fetch(address, 0) + 1
+          @addresses[tcp] = address
+          block.call(tcp, nil)
+        elsif @active.fetch(address, 0) < @max_active
+          @stats[:misses] += 1
+          connect(address, ip, port, block)
+        else
+          @stats[:waits] += 1
+          (@waiters[address] ||= []) << [ip, port, block]
+        end
+        self
+      end
+
+      # Gives back a connection taken with {#checkout}, it must be done with
+      # its last request and must not be reading.
+      # @param tcp [Rbuv::Tcp] the connection
+      # @raise [ArgumentError] if the connection was not checked out from this
+      #   pool
+      # @return [self] itself
+      def checkin(tcp)
+        address = @addresses.delete(tcp)
+        raise ArgumentError, "not checked out from this pool" unless address
+        if gone?(tcp)
+          release(address)
+        elsif (waiter = next_waiter(address))
+          @addresses[tcp] = address
+          waiter.last.call(tcp, nil)
+        elsif @closed || idle_count(address) >= @max_idle
+          tcp.close
+          release(address)
+        else
+          release(address)
+          park(address, tcp)
+        end
+        self
+      end
+
+      # Closes a connection taken with {#checkout} instead of giving it back,
+      # after an error or when its state is unknown.
+      # @param tcp [Rbuv::Tcp] the connection
+      # @raise [ArgumentError] if the connection was not checked out from this
+      #   pool
+      # @return [self] itself
+      def discard(tcp)
+        address = @addresses.delete(tcp)
+        raise ArgumentError, "not checked out from this pool" unless address
+        tcp.close unless gone?(tcp)
+        release(address)
+        self
+      end
+
+      # Closes the idle connections and cancels the waiting checkouts. The
+      # connections checked out are closed when they are given back.
+      # @return [self] itself
+      def close
+        @closed = true
+        @idle.each_value do |entries|
+          entries.each { |tcp, _| tcp.close unless gone?(tcp) }
+        end
+        @idle.clear
+        waiters = @waiters.values.flatten(1)
+        @waiters.clear
+        waiters.each do |_, _, block|
+          block.call(nil, Rbuv::Error::ECANCELED.new("operation canceled"))
+        end
+        @timer.close if @timer && !gone?(@timer)
+        self
+      end
+
+      # @return [Boolean] whether {#close} was called
+      def closed?
+        @closed
+      end
+
+      # @return [Hash] +:hits+ the checkouts which reused an idle connection,
+      #   +:misses+ those which connected, +:waits+ those which waited for a
+      #   connection to be given back. +:expired+ and +:broken+ count the idle
+      #   connections closed after +idle_timeout+ and those the server
+      #   closed. +:idle+, +:active+ and +:waiting+ are the current counts.
+      def stats
+        @stats.merge(
+          idle: @idle.each_value.sum(&:size),
+          active: @active.each_value.sum,
+          waiting: @waiters.each_value.sum(&:size)
+        )
+      end
+
+      private
+
+      def connect(address, ip, port, block)
+        @active[address] = @active.fetch(address, 0) + 1
+        tcp = Tcp.new(@loop)
+        begin
+          tcp.connect(ip, port) do |_, error|
+            if error
+              tcp.close
+              release(address)
+              block.call(nil, error)
+            else
+              @addresses[tcp] = address
+              block.call(tcp, nil)
+            end
+          end
+        rescue Exception
+          tcp.close
+          release(address)
+          raise
+        end
+      end
+
+      # A slot is free, the first checkout waiting for one connects
+      def release(address)
+        count = @active.fetch(address, 0) - 1
+        if count > 0
+          @active[address] = count
+        else
+          @active.delete(address)
+        end
+        waiter = next_waiter(address)
+        connect(address, waiter[0], waiter[1], waiter[2]) if waiter
+      end
+
+      def next_waiter(address)
+        waiters = @waiters[address]
+        return unless waiters
+        waiter = waiters.shift
+        @waiters.delete(address) if waiters.empty?
+        waiter
+      end
+
+      def idle_count(address)
+        entries = @idle[address]
+        entries ? entries.size : 0
+      end
+
+      def park(address, tcp)
+        tcp.unref
+        # Nothing is expected on an idle connection, EOF or data means the
+        # server closed it or it is out of sync
+        tcp.read_start do
+          remove_idle(address, tcp)
+          @stats[:broken] += 1
+          tcp.close unless gone?(tcp)
+        end
+        (@idle[address] ||= []) << [tcp, @loop.now + (@idle_timeout * 1000).to_i]
+        schedule_sweep
+      end
+
+      def take_idle(address)
+        entries = @idle[address]
+        return unless entries
+        while (entry = entries.pop)
+          tcp = entry.first
+          tcp.read_stop
+          if alive?(tcp)
+            tcp.ref
+            break
+          end
+          @stats[:broken] += 1
+          tcp.close unless gone?(tcp)
+          tcp = nil
+        end
+        @idle.delete(address) if entries.empty?
+        tcp
+      end
+
+      def gone?(handle)
+        handle.closed? || handle.closing?
+      end
+
+      # The server may have closed the connection since the loop last polled
+      def alive?(tcp)
+        socket = Socket.for_fd(tcp.fileno)
+        socket.autoclose = false
+        socket.recv_nonblock(1, Socket::MSG_PEEK, exception: false) == :wait_readable
+      rescue SystemCallError, Rbuv::Error
+        false
+      end
+
+      def remove_idle(address, tcp)
+        entries = @idle[address]
+        return unless entries
+        entries.delete_if { |entry, _| entry.equal?(tcp) }
+        @idle.delete(address) if entries.empty?
+      end
+
+      # Idle connections are added with increasing deadlines, the timer is
+      # armed for the oldest one
+      def schedule_sweep
+        return if @timer && @timer.active?
+        deadline = @idle.each_value.map { |entries| entries.first.last }.min
+        return unless deadline
+        unless @timer
+          @timer = Timer.new(@loop)
+          @timer.unref
+        end
+        @timer.start([deadline - @loop.now, 0].max, 0) { sweep }
+      end
+
+      def sweep
+        now = @loop.now
+        @idle.delete_if do |_, entries|
+          while (entry = entries.first) && entry.last <= now
+            entries.shift
+            @stats[:expired] += 1
+            entry.first.close unless gone?(entry.first)
+          end
+          entries.empty?
+        end
+        schedule_sweep
+      end
+    end
+  end
+end
@@ -0,0 +1,60 @@
+require 'spec_helper'
+require 'shared_context/loop'
+require 'socket'
+
+describe Rbuv::Error do
+  include_context Rbuv::Loop
+
+  after { Rbuv.error_mode = :new }
+
+  def connect_error
+    error = nil
+    tcp = Rbuv::Tcp.new(loop)
+    loop.run do
+      tcp.connect('127.0.0.1', 60000) do |_, e|
+        error = e
+        tcp.close
+      end
+    end
+    error
+  end
+
+  it "has a subclass for each libuv error" do
+    expect(Rbuv::Error::ECONNRESET.superclass).to eq(Rbuv::Error)
+    expect(Rbuv::Error::ECONNREFUSED::Errno).to eq(-Errno::ECONNREFUSED::Errno)
+  end
+
+  it "raises the subclass of the error" do
+    server = TCPServer.new '127.0.0.1', 60000
+    tcp = Rbuv::Tcp.new(loop)
+    tcp.bind '127.0.0.1', 60000
+    expect { tcp.listen(10) {} }.to raise_error Rbuv::Error::EADDRINUSE
+  ensure
+    server.close if server
+  end
+
+  it "defaults to new exceptions" do
+    expect(Rbuv.error_mode).to eq(:new)
+    first = connect_error
+    expect(first).to be_a Rbuv::Error::ECONNREFUSED
+    expect(first).not_to be_frozen
+    expect(connect_error).not_to be(first)
+  end
+
+  it "yields frozen exceptions in :frozen mode" do
+    Rbuv.error_mode = :frozen
+    first = connect_error
+    expect(first).to be_a Rbuv::Error::ECONNREFUSED
+    expect(first).to be_frozen
+    expect(connect_error).to be(first)
+  end
+
+  it "yields Symbols in :symbol mode" do
+    Rbuv.error_mode = :symbol
+    expect(connect_error).to eq(:ECONNREFUSED)
+  end
+
+  it "rejects unknown modes" do
+    expect { Rbuv.error_mode = :other }.to raise_error ArgumentError
+  end
+end
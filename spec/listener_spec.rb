@@ -0,0 +1,47 @@
+require 'spec_helper'
+require 'shared_context/loop'
+require 'socket'
+
+describe Rbuv::Listener do
+  include_context Rbuv::Loop
+
+  after do
+    %w(LISTEN_PID LISTEN_FDS LISTEN_FDNAMES).each { |name| ENV.delete(name) }
+  end
+
+  context ".inherit" do
+    it "returns nothing without LISTEN_FDS" do
+      expect(Rbuv::Listener.inherit(loop)).to eq([])
+    end
+
+    it "ignores sockets meant for another process" do
+      ENV['LISTEN_PID'] = (Process.pid + 1).to_s
+      ENV['LISTEN_FDS'] = '1'
+      expect(Rbuv::Listener.inherit(loop)).to eq([])
+      expect(ENV['LISTEN_FDS']).to be_nil
+    end
+  end
+
+  it "hands a listener to a new process" do
+    load_path = $LOAD_PATH.flat_map { |path| ['-I', path] }
+    child = <<-RUBY
+      require 'rbuv'
+      server = Rbuv::Listener.inherit.first
+      Rbuv.run do
+        server.listen(10) do
+          client = server.accept
+          client.write("\#{server.class} from the child") { client.close; server.close }
+        end
+      end
+    RUBY
+    server = Rbuv::Tcp.new(loop)
+    server.bind '127.0.0.1', 60000
+    server.listen(10) {}
+    pid = Rbuv::Listener.spawn([server], RbConfig.ruby, *load_path, '-e', child)
+    server.close
+    socket = TCPSocket.new('127.0.0.1', 60000)
+    expect(socket.read).to eq("Rbuv::Tcp from the child")
+    socket.close
+    Process.wait(pid)
+  end
+end
@@ -172,4 +172,38 @@ describe Rbuv::Loop do
       expect(subject.now).to_not eq(cached_now)
     end
   end
+
+  context "#requests" do
+    it "returns an empty array when there are no requests" do
+      expect(subject.requests).to eq([])
+    end
+
+    it "returns the pending requests in order" do
+      requests = 3.times.map do
+        Rbuv::GetaddrinfoRequest.new("localhost", nil, subject) {}
+      end
+      expect(subject.requests).to eq(requests)
+      subject.run
+      expect(subject.requests).to eq([])
+    end
+  end
+
+  context "#stats" do
+    it "starts empty" do
+      expect(subject.stats).to eq(drains: 0, events: 0, last_batch: 0, max_batch: 0,
+                                  write_pool_hits: 0, write_pool_misses: 0)
+    end
+
+    it "counts callbacks run in the same batch" do
+      timers = 3.times.map do
+        timer = Rbuv::Timer.new(subject)
+        timer.start(0, 0) { timer.close }
+        timer
+      end
+      subject.run
+      expect(subject.stats[:events]).to eq(6)
+      expect(subject.stats[:max_batch]).to eq(3)
+      expect(subject.stats[:drains]).to eq(2)
+    end
+  end
 end
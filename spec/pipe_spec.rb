@@ -0,0 +1,126 @@
+require 'spec_helper'
+require 'shared_examples/handle'
+require 'shared_context/loop'
+require 'socket'
+require 'tmpdir'
+
+describe Rbuv::Pipe do
+  include_context Rbuv::Loop
+  it_should_behave_like Rbuv::Handle
+
+  def open_pair(ipc)
+    Socket.pair(:UNIX, :STREAM).map do |socket|
+      socket.autoclose = false
+      Rbuv::Pipe.new(loop, ipc: ipc).open(socket.fileno)
+    end
+  end
+
+  context "#ipc?" do
+    it "is false by default" do
+      expect(subject.ipc?).to be false
+    end
+
+    it "is true for an IPC pipe" do
+      expect(Rbuv::Pipe.new(loop, ipc: true).ipc?).to be true
+    end
+  end
+
+  it "connects to a bound pipe" do
+    Dir.mktmpdir do |dir|
+      path = File.join(dir, "sock")
+      received = ""
+      loop.run do
+        subject.bind path
+        subject.listen(10) do
+          client = subject.accept
+          client.read_start do |data, error|
+            if error
+              client.close
+              subject.close
+            else
+              received << data
+            end
+          end
+        end
+        client = Rbuv::Pipe.new(loop)
+        client.connect(path) do |pipe, error|
+          expect(error).to be_nil
+          client.write("test string") { client.close }
+        end
+      end
+      expect(received).to eq("test string")
+    end
+  end
+
+  context "#write2" do
+    it "sends a tcp handle" do
+      server = TCPServer.new '127.0.0.1', 60000
+      parent, child = open_pair(true)
+      client = Rbuv::Tcp.new(loop)
+      received = nil
+      socket = nil
+      loop.run do
+        client.connect('127.0.0.1', 60000) do
+          parent.write2("c", client) do |error|
+            expect(error).to be_nil
+            client.close
+            parent.close
+          end
+        end
+        child.read2_start do |data, handles, error|
+          next child.close if error
+          expect(data).to eq("c")
+          received = handles
+          received.each do |handle|
+            handle.write("from the child") { handle.close }
+          end
+        end
+        socket = server.accept
+      end
+      expect(received.map(&:class)).to eq([Rbuv::Tcp])
+      expect(socket.read).to eq("from the child")
+      socket.close
+      server.close
+    end
+
+    it "gives each chunk the handles sent with it" do
+      server = TCPServer.new '127.0.0.1', 60000
+      socket = TCPSocket.new '127.0.0.1', 60000
+      parent, child = UNIXSocket.pair(:STREAM)
+      pipe = Rbuv::Pipe.new(loop, ipc: true).open(child.fileno)
+      child.autoclose = false
+      received = []
+      File.open(__FILE__) do |file|
+        parent.send_io(file)
+        parent.send_io(socket)
+      end
+      loop.run do
+        pipe.read2_start do |data, handles, error|
+          received << handles.map(&:class)
+          handles.each(&:close)
+          pipe.close if received.size == 2
+        end
+      end
+      expect(received).to eq([[], [Rbuv::Tcp]])
+      parent.close
+      socket.close
+      server.close
+    end
+
+    it "does not queue anything for a closed handle" do
+      require 'objspace'
+      parent, child = open_pair(true)
+      client = Rbuv::Tcp.new(loop)
+      client.close
+      loop.run
+      size = ObjectSpace.memsize_of(parent)
+      expect { parent.write2("c", client) }.to raise_error Rbuv::Error
+      expect(ObjectSpace.memsize_of(parent)).to eq(size)
+    end
+
+    it "requires an IPC pipe" do
+      pipe, other = open_pair(false)
+      expect { pipe.read2_start {} }.to raise_error Rbuv::Error::EINVAL
+    end
+  end
+end
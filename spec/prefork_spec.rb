@@ -0,0 +1,67 @@
+require 'spec_helper'
+require 'socket'
+require 'timeout'
+
+describe Rbuv::Prefork do
+  def wait_for
+    Timeout.timeout(5) do
+      sleep 0.01 until yield
+    end
+  end
+
+  def run_in_thread(prefork)
+    thread = Thread.new { prefork.run }
+    wait_for { prefork.pids.size == prefork.size }
+    yield
+  ensure
+    prefork.stop
+    thread.join
+  end
+
+  it "requires a block" do
+    expect { Rbuv::Prefork.new(2) }.to raise_error ArgumentError
+  end
+
+  it "spreads the connections between the workers" do
+    prefork = Rbuv::Prefork.new(2) do
+      server = Rbuv::Tcp.new
+      server.bind '127.0.0.1', 60000, reuseport: true
+      server.listen(10) do
+        client = server.accept
+        client.write(Process.pid.to_s) { client.close }
+      end
+    end
+    pids = []
+    workers = nil
+    run_in_thread(prefork) do
+      workers = prefork.pids
+      wait_for do
+        begin
+          socket = TCPSocket.new('127.0.0.1', 60000)
+          pids << socket.read.to_i
+          socket.close
+        rescue Errno::ECONNREFUSED
+        end
+        pids.uniq.size == 2
+      end
+    end
+    expect(pids.uniq.sort).to eq(workers.sort)
+  end
+
+  it "restarts a crashed worker" do
+    prefork = Rbuv::Prefork.new(1, restart_delay: 0) do
+      Rbuv::Timer.new.start(10_000, 0) {}
+    end
+    run_in_thread(prefork) do
+      crashed = prefork.pids.first
+      Process.kill(:KILL, crashed)
+      wait_for { prefork.pids.size == 1 && prefork.pids.first != crashed }
+    end
+  end
+
+  it "does not restart a worker which exited" do
+    prefork = Rbuv::Prefork.new(1) {}
+    Timeout.timeout(5) { prefork.run }
+    expect(prefork.pids).to eq([])
+  end
+end
@@ -2,7 +2,9 @@ shared_examples Rbuv::Stream do
   it { is_expected.to be_a_kind_of Rbuv::Stream }
 
   describe "#write" do
-    it_requires_a_block "data"
+    it "returns itself when no block is given" do
+      expect(subject.write("string")).to be(subject)
+    end
 
     it "calls the block" do
       on_write = double
@@ -43,9 +45,84 @@ shared_examples Rbuv::Stream do
 
     it "requires a string" do
       expect {
-        subject.write [] { }
+        subject.write(1) { }
+      }.to raise_error TypeError
+    end
+
+    it "requires an array of strings" do
+      expect {
+        subject.write(["string", 1]) { }
       }.to raise_error TypeError
     end
+
+    it "requires a non empty array" do
+      expect {
+        subject.write([]) { }
+      }.to raise_error ArgumentError
+    end
+  end
+
+  describe "#on_error" do
+    it_requires_a_block
+
+    it "returns itself" do
+      expect(subject.on_error { }).to be(subject)
+    end
+  end
+
+  describe "#write_queue_size" do
+    it "is zero when nothing was written" do
+      expect(subject.write_queue_size).to eq(0)
+    end
+  end
+
+  describe "#set_write_watermarks" do
+    it "changes the watermarks" do
+      expect(subject.write_watermarks).to eq([65536, 16384])
+      subject.set_write_watermarks(1024, 512)
+      expect(subject.write_watermarks).to eq([1024, 512])
+    end
+
+    it "requires the low watermark to be below the high one" do
+      expect {
+        subject.set_write_watermarks(512, 1024)
+      }.to raise_error ArgumentError
+    end
+  end
+
+  describe "#writable_without_blocking?" do
+    it "is true when nothing was written" do
+      expect(subject.writable_without_blocking?).to be true
+    end
+  end
+
+  describe "#on_drain" do
+    it_requires_a_block
+
+    it "returns itself" do
+      expect(subject.on_drain { }).to be(subject)
+    end
+  end
+
+  describe "#cork" do
+    it "returns itself" do
+      expect(subject.cork).to be(subject)
+    end
+  end
+
+  describe "#uncork" do
+    it "returns itself" do
+      expect(subject.uncork).to be(subject)
+    end
+  end
+
+  describe "#auto_cork=" do
+    it "turns auto corking on and off" do
+      subject.auto_cork = true
+      expect(subject.auto_cork?).to be true
+      subject.auto_cork = false
+      expect(subject.auto_cork?).to be false
+    end
   end
 
   describe "#shutdown" do
@@ -84,7 +161,7 @@ shared_examples Rbuv::Stream do
       on_shutdown = double
       expect(on_shutdown).to receive(:call).once.with(nil)
       on_write = double
-      expect(on_write).to receive(:call).once.with(Rbuv::Error.new("broken pipe"))
+      expect(on_write).to receive(:call).once.with(Rbuv::Error::EPIPE.new("broken pipe"))
       request = subject.shutdown do |error|
         on_shutdown.call(error)
       end
@@ -19,7 +19,7 @@ require 'rbuv'
 
 module Helpers
   def it_raise_error_when_closed
-    method = /^#([a-zA-Z][a-zA-Z0-9]*[\?\!]?)$/.match(description)[1]
+    method = /^#([a-zA-Z][a-zA-Z0-9_]*[\?\!]?)$/.match(description)[1]
     context "when handle is closed" do
       before do
         subject.close
@@ -35,7 +35,7 @@ module Helpers
   end
 
   def it_requires_a_block(*args)
-    method = /^#([a-zA-Z][a-zA-Z0-9]*[\?\!]?)$/.match(description)[1]
+    method = /^#([a-zA-Z][a-zA-Z0-9_]*[\?\!]?)$/.match(description)[1]
 
     it "requires a block" do
       expect {
@@ -0,0 +1,136 @@
+require 'spec_helper'
+require 'shared_context/loop'
+
+describe Rbuv::Tcp::Pool do
+  include_context Rbuv::Loop
+
+  # Answers every read with the same data, closes the connections right away
+  # when +close_clients+
+  def echo_server(close_clients: false)
+    server = Rbuv::Tcp.new(loop)
+    server.bind '127.0.0.1', 60000
+    server.listen(10) do
+      client = Rbuv::Tcp.new(loop)
+      server.accept client
+      if close_clients
+        client.close
+      else
+        client.read_start do |data, error|
+          error ? client.close : client.write(data)
+        end
+      end
+    end
+    server
+  end
+
+  def after_ms(ms, &block)
+    Rbuv::Timer.start(loop, ms, 0) do |timer|
+      timer.close
+      block.call
+    end
+  end
+
+  it "reuses a connection given back" do
+    server = echo_server
+    connections = []
+    loop.run do
+      subject.checkout('127.0.0.1', 60000) do |tcp, error|
+        connections << tcp
+        subject.checkin(tcp)
+        subject.checkout('127.0.0.1', 60000) do |reused, _|
+          connections << reused
+          subject.discard(reused)
+          server.close
+        end
+      end
+    end
+    expect(connections[1]).to be(connections[0])
+    expect(subject.stats[:misses]).to eq(1)
+    expect(subject.stats[:hits]).to eq(1)
+    expect(subject.stats[:active]).to eq(0)
+  end
+
+  it "yields the connection errors" do
+    result = nil
+    loop.run do
+      subject.checkout('127.0.0.1', 60000) do |tcp, error|
+        result = [tcp, error]
+      end
+    end
+    expect(result[0]).to be_nil
+    expect(result[1]).to be_a Rbuv::Error::ECONNREFUSED
+    expect(subject.stats[:active]).to eq(0)
+  end
+
+  context "with max_active" do
+    subject { Rbuv::Tcp::Pool.new(loop, max_active: 1) }
+
+    it "hands a connection given back to the waiting checkout" do
+      server = echo_server
+      connections = []
+      loop.run do
+        subject.checkout('127.0.0.1', 60000) do |tcp, _|
+          connections << tcp
+          subject.checkin(tcp)
+        end
+        subject.checkout('127.0.0.1', 60000) do |tcp, _|
+          connections << tcp
+          subject.discard(tcp)
+          server.close
+        end
+        expect(subject.stats[:waiting]).to eq(1)
+      end
+      expect(connections[1]).to be(connections[0])
+      expect(subject.stats[:waits]).to eq(1)
+      expect(subject.stats[:misses]).to eq(1)
+    end
+
+    it "cancels the waiting checkouts on close" do
+      server = echo_server
+      error = nil
+      loop.run do
+        subject.checkout('127.0.0.1', 60000) do |tcp, _|
+          subject.checkin(tcp)
+          expect(tcp.closing?).to be true
+          server.close
+        end
+        subject.checkout('127.0.0.1', 60000) { |_, e| error = e }
+        subject.close
+      end
+      expect(error).to be_a Rbuv::Error::ECANCELED
+      expect { subject.checkout('127.0.0.1', 60000) { } }.to raise_error IOError
+    end
+  end
+
+  it "closes the connections idle for longer than idle_timeout" do
+    pool = Rbuv::Tcp::Pool.new(loop, idle_timeout: 0.02)
+    server = echo_server
+    loop.run do
+      pool.checkout('127.0.0.1', 60000) do |tcp, _|
+        pool.checkin(tcp)
+        expect(pool.stats[:idle]).to eq(1)
+        after_ms(100) { server.close }
+      end
+    end
+    expect(pool.stats[:expired]).to eq(1)
+    expect(pool.stats[:idle]).to eq(0)
+  end
+
+  it "drops the idle connections closed by the server" do
+    server = echo_server(close_clients: true)
+    loop.run do
+      subject.checkout('127.0.0.1', 60000) do |tcp, _|
+        subject.checkin(tcp)
+        after_ms(50) do
+          subject.checkout('127.0.0.1', 60000) do |fresh, _|
+            subject.discard(fresh)
+            server.close
+          end
+        end
+      end
+    end
+    expect(subject.stats[:broken]).to eq(1)
+    expect(subject.stats[:hits]).to eq(0)
+    expect(subject.stats[:misses]).to eq(2)
+  end
+end
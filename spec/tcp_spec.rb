@@ -58,6 +58,31 @@ describe Rbuv::Tcp, :type => :handle do
   end
 
   context "#listen" do
+    context "with fastopen" do
+      after do
+        subject.close
+        loop.run_nowait until subject.closed?
+      end
+
+      it "sets the fast open queue length", :if => RUBY_PLATFORM =~ /linux/ do
+        subject.bind '127.0.0.1', 60000
+        subject.listen(10, fastopen: 5) { }
+        socket = Socket.for_fd(subject.fileno)
+        socket.autoclose = false
+        expect(socket.getsockopt(:TCP, Socket::TCP_FASTOPEN).int).to eq(5)
+      end
+
+      it "does not listen when the option is invalid" do
+        subject.bind '127.0.0.1', 60000
+        expect { subject.listen(10, fastopen: "5") { } }.to raise_error TypeError
+        expect { TCPSocket.new('127.0.0.1', 60000) }.to raise_error Errno::ECONNREFUSED
+      end
+
+      it "requires a bound stream", :if => RUBY_PLATFORM =~ /linux/ do
+        expect { subject.listen(10, fastopen: 5) { } }.to raise_error Rbuv::Error::EBADF
+      end
+    end
+
     it "when address not in use" do
       expect(port_in_use?(60000)).to be false
 
@@ -91,6 +116,75 @@ describe Rbuv::Tcp, :type => :handle do
       end
     end
 
+    it "shares the port with reuseport" do
+      other = Rbuv::Tcp.new(loop)
+      loop.run do
+        begin
+          subject.bind '127.0.0.1', 60000, reuseport: true
+          other.bind '127.0.0.1', 60000, reuseport: true
+          subject.listen(10) {}
+          expect { other.listen(10) {} }.not_to raise_error
+        ensure
+          subject.close
+          other.close
+        end
+      end
+    end
+
+    it "creates the reuseport socket close-on-exec" do
+      subject.bind '127.0.0.1', 60000, reuseport: true
+      io = IO.for_fd(subject.fileno, autoclose: false)
+      expect(io.close_on_exec?).to be true
+      subject.close
+      loop.run_nowait until subject.closed?
+    end
+
+    context "with batch" do
+      def accept_batches(count, batch)
+        batches = []
+        accepted = 0
+        sockets = nil
+        loop.run do
+          subject.bind '127.0.0.1', 60000
+          subject.listen(count, batch: batch) do |clients, error|
+            expect(error).to be_nil
+            batches << clients.size
+            clients.each(&:close)
+            accepted += clients.size
+            subject.close if accepted == count
+          end
+          sockets = Array.new(count) { TCPSocket.new('127.0.0.1', 60000) }
+        end
+        sockets.each(&:close)
+        batches
+      end
+
+      it "accepts every pending connection at once" do
+        expect(accept_batches(10, true)).to eq([10])
+      end
+
+      it "accepts at most the given number of connections per iteration" do
+        expect(accept_batches(10, 4)).to eq([4, 4, 2])
+      end
+
+      it "yields streams of the class of the server" do
+        klass = Class.new(Rbuv::Tcp)
+        server = klass.new(loop)
+        accepted = nil
+        loop.run do
+          server.bind '127.0.0.1', 60000
+          server.listen(10, batch: true) do |clients, error|
+            accepted = clients
+            clients.each(&:close)
+            server.close
+          end
+          @socket = TCPSocket.new('127.0.0.1', 60000)
+        end
+        @socket.close
+        expect(accepted.map(&:class)).to eq([klass])
+      end
+    end
+
     it "should call the on_connection callback when connection coming" do
       on_connection = double
       expect(on_connection).to receive(:call).once.with(subject, nil)
@@ -169,7 +263,7 @@ describe Rbuv::Tcp, :type => :handle do
     context "when server does not exist" do
       it "calls the block with tcp and an error" do
         on_connect = double
-        expect(on_connect).to receive(:call).once.with(subject, Rbuv::Error.new('connection refused'))
+        expect(on_connect).to receive(:call).once.with(subject, Rbuv::Error::ECONNREFUSED.new('connection refused'))
 
         loop.run do
           subject.connect('127.0.0.1', 60000) do |*args|
@@ -195,6 +289,30 @@ describe Rbuv::Tcp, :type => :handle do
         end
       end
     end
+
+    context "with data" do
+      it "writes the data once connected" do
+        server = TCPServer.new '127.0.0.1', 60000
+        thread = Thread.new do
+          client = server.accept
+          begin
+            client.read
+          ensure
+            client.close
+          end
+        end
+        connect_error = :not_called
+        loop.run do
+          subject.connect('127.0.0.1', 60000, data: "hello") do |tcp, error|
+            connect_error = error
+            subject.shutdown { subject.close }
+          end
+        end
+        expect(connect_error).to be_nil
+        expect(thread.value).to eq("hello")
+        server.close
+      end
+    end
   end
 
   context "#write" do
@@ -226,5 +344,634 @@ describe Rbuv::Tcp, :type => :handle do
       results = stop_server
       expect(results).to eq('test string')
     end
+
+    it "writes without a block" do
+      on_error = double
+      expect(on_error).not_to receive(:call)
+
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.on_error { |*args| on_error.call(*args) }
+          subject.write('test ')
+          subject.write(['str'.freeze, 'ing'])
+          subject.shutdown { subject.close }
+        end
+      end
+      results = stop_server
+      expect(results).to eq('test string')
+    end
+
+    it "writes empty data" do
+      write_error = :not_called
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.write('')
+          subject.write(['', 'data', ''])
+          subject.write('') do |error|
+            write_error = error
+            subject.shutdown { subject.close }
+          end
+        end
+      end
+      results = stop_server
+      expect(write_error).to be_nil
+      expect(results).to eq('data')
+    end
+
+    it "reuses completed block-less writes" do
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.write('test ')
+          timer = Rbuv::Timer.new(loop)
+          timer.start(10, 0) do
+            timer.close
+            subject.write('string')
+            subject.shutdown { subject.close }
+          end
+        end
+      end
+      results = stop_server
+      expect(results).to eq('test string')
+      expect(loop.stats[:write_pool_misses]).to eq(1)
+      expect(loop.stats[:write_pool_hits]).to eq(1)
+    end
+
+    it "writes an Array with a single request" do
+      on_write = double
+      expect(on_write).to receive(:call).once.with(nil)
+
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.write(['test', ' ', 'string']) do |*args|
+            on_write.call(*args)
+            subject.close
+          end
+        end
+      end
+      results = stop_server
+      expect(results).to eq('test string')
+    end
+
+    it "writes IO::Buffers", :if => defined?(IO::Buffer) do
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.write(['test', IO::Buffer.for(' string')]) do |error|
+            raise error if error
+            subject.close
+          end
+        end
+      end
+      results = stop_server
+      expect(results).to eq('test string')
+    end
+
+    it "writes frozen strings" do
+      payload = ('x' * 100_000).freeze
+
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.write(payload) do |error|
+            raise error if error
+            subject.close
+          end
+        end
+      end
+      results = stop_server
+      expect(results).to eq(payload)
+    end
+
+    it "writes the data as it was when #write was called" do
+      payload = 'test string' * 100
+
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.write(payload) do |error|
+            raise error if error
+            subject.close
+          end
+          payload.replace('changed')
+        end
+      end
+      results = stop_server
+      expect(results).to eq('test string' * 100)
+    end
+  end
+
+  context "#on_drain" do
+    include_context "an open tcp server", '127.0.0.1', 60000
+
+    it "is called once the queued data goes below the low watermark" do
+      on_drain = double
+      expect(on_drain).to receive(:call).once.with(subject)
+      payload = 'x' * 4_000_000
+
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.on_drain do |*args|
+            expect(subject.writable_without_blocking?).to be true
+            on_drain.call(*args)
+            subject.shutdown { subject.close }
+          end
+          subject.write(payload)
+          expect(subject.write_queue_size).not_to eq(0)
+          expect(subject.writable_without_blocking?).to be false
+        end
+      end
+      results = stop_server
+      expect(results.size).to eq(payload.size)
+    end
+  end
+
+  context "#cork" do
+    include_context "an open tcp server", '127.0.0.1', 60000
+
+    it "writes the corked data in order" do
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.cork
+          subject.write('test')
+          subject.write(' ')
+          subject.write('str') { |error| raise error if error }
+          subject.write('ing')
+          subject.uncork
+          subject.shutdown { subject.close }
+        end
+      end
+      results = stop_server
+      expect(results).to eq('test string')
+    end
+
+    it "writes the corked data at the end of the batch with auto_cork" do
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.auto_cork = true
+          subject.write('test')
+          subject.write(' string')
+          loop.next_tick { subject.close }
+        end
+      end
+      results = stop_server
+      expect(results).to eq('test string')
+    end
+
+    it "reports the cork buffer in ObjectSpace.memsize_of" do
+      require 'objspace'
+      growth = nil
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          before = ObjectSpace.memsize_of(subject)
+          subject.cork
+          subject.write('test')
+          growth = ObjectSpace.memsize_of(subject) - before
+          subject.close
+        end
+      end
+      stop_server
+      expect(growth).to eq(4096)
+    end
+  end
+
+  context "#try_write" do
+    include_context "an open tcp server", '127.0.0.1', 60000
+
+    it "returns the number of bytes written right away" do
+      written = nil
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          written = subject.try_write('test string')
+          subject.close
+        end
+      end
+      results = stop_server
+      expect(written).to eq(11)
+      expect(results).to eq('test string')
+    end
+
+    it "writes what is left in the background" do
+      payload = ['a' * 500_000, 'b' * 500_000]
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.try_write(payload)
+          subject.shutdown { subject.close }
+        end
+      end
+      results = stop_server
+      expect(results).to eq(payload.join)
+    end
+  end
+
+  context "#open" do
+    it "wraps an existing socket" do
+      socket = TCPServer.new '127.0.0.1', 60000
+      socket.autoclose = false
+      subject.open(socket.fileno)
+      expect(subject.fileno).to eq(socket.fileno)
+      expect(subject.sockname).to eq(['127.0.0.1', 60000])
+      subject.close
+      loop.run_nowait until subject.closed?
+      expect(port_in_use?(60000)).to be false
+    end
+  end
+
+  context "#fileno" do
+    it "raises when there is no socket yet" do
+      expect { subject.fileno }.to raise_error Rbuv::Error::EBADF
+    end
+  end
+
+  context "socket options" do
+    def sockopt(level, name)
+      socket = Socket.for_fd(subject.fileno)
+      socket.autoclose = false
+      socket.getsockopt(level, name).int
+    end
+
+    before { subject.bind '127.0.0.1', 60000 }
+    after do
+      subject.close
+      loop.run_nowait until subject.closed?
+    end
+
+    it "keeps alive with the given delay" do
+      subject.enable_keepalive(42)
+      expect(sockopt(:SOCKET, :KEEPALIVE)).to eq(1)
+      expect(sockopt(:TCP, :KEEPIDLE)).to eq(42)
+    end
+
+    it "sets the buffer sizes" do
+      subject.send_buffer_size = 65536
+      subject.recv_buffer_size = 65536
+      # Linux doubles the requested size
+      expect(subject.send_buffer_size).to eq(sockopt(:SOCKET, :SNDBUF))
+      expect(subject.recv_buffer_size).to eq(sockopt(:SOCKET, :RCVBUF))
+      expect([65536, 131072]).to include(subject.send_buffer_size)
+    end
+
+    it "sets the user timeout", :if => RUBY_PLATFORM =~ /linux/ do
+      subject.user_timeout = 5000
+      expect(sockopt(:TCP, Socket::TCP_USER_TIMEOUT)).to eq(5000)
+    end
+
+    it "sets the linux only options", :if => RUBY_PLATFORM =~ /linux/ do
+      subject.defer_accept = 1
+      subject.quickack = true
+      subject.max_pacing_rate = 1_000_000
+      expect(sockopt(:TCP, Socket::TCP_DEFER_ACCEPT)).to eq(1)
+    end
+  end
+
+  context "#close_reset" do
+    it "resets the connection" do
+      server = TCPServer.new '127.0.0.1', 60000
+      thread = Thread.new do
+        client = server.accept
+        begin
+          client.read
+        rescue Errno::ECONNRESET => e
+          e
+        ensure
+          client.close
+        end
+      end
+      closed = false
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.close_reset { closed = true }
+        end
+      end
+      expect(closed).to be true
+      expect(thread.value).to be_a Errno::ECONNRESET
+      server.close
+    end
+  end
+
+  context "#read_start" do
+    def read_from_server(payload, **options)
+      server = TCPServer.new '127.0.0.1', 60000
+      thread = Thread.new do
+        client = server.accept
+        client.write payload
+        client.close
+      end
+      received = ""
+      read_error = nil
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.read_start(**options) do |data, error|
+            if error
+              read_error = error
+              subject.close
+            else
+              received << (block_given? ? yield(data) : data)
+            end
+          end
+        end
+      end
+      thread.join
+      server.close
+      [received, read_error]
+    end
+
+    it "yields small reads" do
+      received, error = read_from_server("test string")
+      expect(received).to eq("test string")
+      expect(error).to be_a EOFError
+    end
+
+    it "yields reads larger than a pooled buffer" do
+      payload = Random.new(42).bytes(300_000)
+      received, error = read_from_server(payload)
+      expect(received).to eq(payload)
+      expect(error).to be_a EOFError
+    end
+
+    # both streams have data when the loop polls, their reads are yielded in
+    # the same batch
+    def read_both
+      server = TCPServer.new '127.0.0.1', 60000
+      clients = 2.times.map { Rbuv::Tcp.new(loop) }
+      sockets = []
+      received = []
+      loop.run do
+        clients.each do |client|
+          client.connect('127.0.0.1', 60000) do
+            sockets << server.accept
+            next if sockets.size < 2
+            sockets.each { |socket| socket.write "data" }
+            clients.each do |reader|
+              reader.read_start do |data, error|
+                received << data
+                yield clients
+              end
+            end
+          end
+        end
+      end
+      sockets.each(&:close)
+      server.close
+      received
+    end
+
+    it "does not yield a read queued before read_stop" do
+      received = read_both do |clients|
+        clients.each(&:read_stop)
+        Rbuv::Timer.new(loop).start(10, 0) { clients.each(&:close) }
+      end
+      expect(received).to eq(["data"])
+    end
+
+    it "does not yield a read queued before close" do
+      received = read_both { |clients| clients.each(&:close) }
+      expect(received).to eq(["data"])
+    end
+
+    context "with a buffer" do
+      it "reads into a String" do
+        payload = Random.new(42).bytes(300_000)
+        buffer = String.new(capacity: 4096)
+        received, error = read_from_server(payload, buffer: buffer) do |nread|
+          expect(buffer.bytesize).to eq(nread)
+          buffer.dup
+        end
+        expect(received).to eq(payload)
+        expect(error).to be_a EOFError
+      end
+
+      it "reads into an IO::Buffer", :if => defined?(IO::Buffer) do
+        payload = Random.new(42).bytes(300_000)
+        buffer = IO::Buffer.new(4096)
+        received, error = read_from_server(payload, buffer: buffer) do |nread|
+          buffer.get_string(0, nread)
+        end
+        expect(received).to eq(payload)
+        expect(error).to be_a EOFError
+      end
+
+      it "unlocks the buffer at EOF" do
+        buffer = String.new(capacity: 4096)
+        read_from_server("test string", buffer: buffer) { "" }
+        expect { buffer << "more" }.not_to raise_error
+      end
+
+      it "requires a mutable buffer" do
+        expect {
+          subject.read_start(buffer: "frozen".freeze) {}
+        }.to raise_error FrozenError
+      end
+
+      it "requires a String or an IO::Buffer" do
+        expect {
+          subject.read_start(buffer: 1) {}
+        }.to raise_error TypeError
+      end
+    end
+
+    context "with a handler" do
+      let(:handler_class) do
+        Class.new do
+          attr_reader :received, :eof
+          def initialize(stream)
+            @stream = stream
+            @received = ""
+            @eof = false
+          end
+          def on_data(data) @received << data end
+          def on_eof
+            @eof = true
+            @stream.close
+          end
+        end
+      end
+
+      it "calls on_data and on_eof" do
+        server = TCPServer.new '127.0.0.1', 60000
+        thread = Thread.new do
+          client = server.accept
+          client.write "test string"
+          client.close
+        end
+        handler = handler_class.new(subject)
+        loop.run do
+          subject.connect('127.0.0.1', 60000) do
+            subject.read_start(handler)
+          end
+        end
+        thread.join
+        server.close
+        expect(handler.received).to eq("test string")
+        expect(handler.eof).to be true
+      end
+
+      it "requires on_data" do
+        expect {
+          subject.read_start(Object.new)
+        }.to raise_error TypeError
+      end
+    end
+  end
+
+  context "#read_frames" do
+    def read_frames_from_server(payload, **options)
+      server = TCPServer.new '127.0.0.1', 60000
+      thread = Thread.new do
+        client = server.accept
+        payload.each_char.each_slice(3) { |chars| client.write chars.join }
+        client.close
+      end
+      frames = []
+      read_error = nil
+      loop.run do
+        subject.connect('127.0.0.1', 60000) do
+          subject.read_frames(**options) do |data, error|
+            if error
+              read_error = error
+              subject.close
+            else
+              frames.concat data
+            end
+          end
+        end
+      end
+      thread.join
+      server.close
+      [frames, read_error]
+    end
+
+    it "splits the data at the delimiter" do
+      frames, error = read_frames_from_server("GET\r\nSET a\r\n\r\nQUIT", delimiter: "\r\n")
+      expect(frames).to eq(["GET", "SET a", "", "QUIT"])
+      expect(error).to be_a EOFError
+    end
+
+    it "splits the data by a length prefix" do
+      payload = [3, "one", 0, "", 5, "three"].each_slice(2).map { |len, frame| [len].pack("N") + frame }.join
+      frames, error = read_frames_from_server(payload, length_prefix: 4)
+      expect(frames).to eq(["one", "", "three"])
+      expect(error).to be_a EOFError
+    end
+
+    it "reads little endian length prefixes" do
+      payload = [3].pack("v") + "one" + [300].pack("v") + "x" * 300
+      frames, error = read_frames_from_server(payload, length_prefix: 2, endian: :little)
+      expect(frames).to eq(["one", "x" * 300])
+    end
+
+    it "yields an error when a frame is too large" do
+      payload = [100].pack("n") + "x" * 100
+      frames, error = read_frames_from_server(payload, length_prefix: 2, max_frame_size: 10)
+      expect(frames).to eq([])
+      expect(error).to be_a Rbuv::Error::EMSGSIZE
+    end
+
+    it "gives the frame size error as error_mode says" do
+      payload = [100].pack("n") + "x" * 100
+      begin
+        Rbuv.error_mode = :symbol
+        _, error = read_frames_from_server(payload, length_prefix: 2, max_frame_size: 10)
+      ensure
+        Rbuv.error_mode = :new
+      end
+      expect(error).to eq(:EMSGSIZE)
+    end
+
+    it "requires a delimiter or a length prefix" do
+      expect { subject.read_frames {} }.to raise_error ArgumentError
+      expect { subject.read_frames(length_prefix: 3) {} }.to raise_error ArgumentError
+    end
+  end
+
+  context "#pipe_to" do
+    it "forwards the data to another stream" do
+      payload = Random.new(42).bytes(1_000_000)
+      source = TCPServer.new '127.0.0.1', 60000
+      sink = TCPServer.new '127.0.0.1', 60001
+      source_thread = Thread.new do
+        client = source.accept
+        client.write payload
+        client.close
+      end
+      sink_thread = Thread.new do
+        client = sink.accept
+        data = client.read
+        client.close
+        data
+      end
+      pipe_error = :not_called
+      loop.run do
+        target = Rbuv::Tcp.new(loop)
+        target.connect('127.0.0.1', 60001) do
+          subject.connect('127.0.0.1', 60000) do
+            subject.pipe_to(target, high_water: 4096) do |error|
+              pipe_error = error
+              subject.close
+              target.shutdown { target.close }
+            end
+          end
+        end
+      end
+      source_thread.join
+      received = sink_thread.value
+      source.close
+      sink.close
+      expect(pipe_error).to be_nil
+      expect(received.bytesize).to eq(payload.bytesize)
+      expect(received).to eq(payload)
+    end
+
+    it "stops forwarding on read_stop while paused" do
+      source = TCPServer.new '127.0.0.1', 60000
+      sink = TCPServer.new '127.0.0.1', 60001
+      sink.setsockopt(:SOCKET, :RCVBUF, 4096)
+      drain = Queue.new
+      source_thread = Thread.new do
+        client = source.accept
+        begin
+          client.write "x" * 4_000_000
+        rescue SystemCallError
+        ensure
+          client.close
+        end
+      end
+      sink_thread = Thread.new do
+        client = sink.accept
+        drain.pop
+        data = client.read
+        client.close
+        data
+      end
+      pipe_error = :not_called
+      paused_at = nil
+      loop.run do
+        target = Rbuv::Tcp.new(loop)
+        target.connect('127.0.0.1', 60001) do
+          target.send_buffer_size = 4096
+          subject.connect('127.0.0.1', 60000) do
+            subject.pipe_to(target, high_water: 1) { |error| pipe_error = error }
+            Rbuv::Timer.start(loop, 100, 0) do |timer|
+              timer.close
+              subject.read_stop
+              paused_at = target.write_queue_size
+              drain << true
+              Rbuv::Timer.start(loop, 100, 0) do |timer2|
+                timer2.close
+                subject.close
+                target.shutdown { target.close }
+              end
+            end
+          end
+        end
+      end
+      received = sink_thread.value
+      source_thread.join
+      source.close
+      sink.close
+      expect(paused_at > 0).to be true
+      expect(pipe_error).to eq(:not_called)
+      expect(received.bytesize < 4_000_000).to be true
+    end
+
+    it "requires a stream" do
+      expect { subject.pipe_to("stream") }.to raise_error TypeError
+    end
   end
 end
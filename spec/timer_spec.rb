@@ -38,6 +38,19 @@ describe Rbuv::Timer do
       end
     end # context "#start"
 
+    it "calls its block after GC.compact" do
+      skip "GC.compact is not supported" unless GC.respond_to?(:compact)
+      block = double
+      expect(block).to receive(:call).once.with(subject)
+
+      loop.run do
+        subject.start 0, 0 do |*args|
+          block.call(*args)
+        end
+        GC.compact
+      end
+    end
+
     it "#stop" do
       block = double
       expect(block).to receive(:call).once.with(subject)
@@ -50,6 +63,36 @@ describe Rbuv::Timer do
       end
     end
 
+    it "#stop from a timer due on the same tick" do
+      fired = []
+      other = Rbuv::Timer.new(loop)
+      loop.run do
+        subject.start 0, 0 do
+          fired << :subject
+          other.stop
+        end
+        other.start 0, 0 do
+          fired << :other
+        end
+      end
+      expect(fired).to eq([:subject])
+    end
+
+    it "#close from a timer due on the same tick" do
+      fired = []
+      other = Rbuv::Timer.new(loop)
+      loop.run do
+        subject.start 0, 0 do
+          fired << :subject
+          other.close
+        end
+        other.start 0, 0 do
+          fired << :other
+        end
+      end
+      expect(fired).to eq([:subject])
+    end
+
     context "#active?" do
       it "should be false" do
         loop.run do
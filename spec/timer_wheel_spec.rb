@@ -0,0 +1,81 @@
+require 'spec_helper'
+require 'shared_examples/handle'
+require 'shared_context/loop'
+
+describe Rbuv::TimerWheel do
+  include_context Rbuv::Loop
+  it_should_behave_like Rbuv::Handle
+
+  subject { Rbuv::TimerWheel.new(loop, tick: 5, slots: 8) }
+
+  it "rounds the slots up to a power of 2" do
+    expect(Rbuv::TimerWheel.new(loop, slots: 100).slots).to eq(128)
+    expect(subject.tick).to eq(5)
+  end
+
+  it "delivers the entries due on a tick together" do
+    batches = []
+    loop.run do
+      subject.start { |values| batches << values }
+      3.times { |i| subject.schedule(10, i) }
+      subject.schedule(30, :later)
+    end
+    expect(batches.size).to eq(2)
+    expect(batches[0].sort).to eq([0, 1, 2])
+    expect(batches[1]).to eq([:later])
+    expect(subject.size).to eq(0)
+  end
+
+  it "delivers the timeouts longer than a turn of the wheel" do
+    delivered_at = nil
+    start = nil
+    loop.run do
+      start = loop.now
+      subject.start { |values| delivered_at = loop.now }
+      subject.schedule(100, :value)
+    end
+    expect(delivered_at - start >= 100).to be true
+  end
+
+  it "cancels an entry" do
+    delivered = []
+    loop.run do
+      subject.start { |values| delivered.concat(values) }
+      id = subject.schedule(10, :canceled)
+      subject.schedule(20, :kept)
+      expect(subject.cancel(id)).to eq(:canceled)
+      expect(subject.cancel(id)).to be_nil
+      expect(subject.pending?(id)).to be false
+    end
+    expect(delivered).to eq([:kept])
+  end
+
+  it "reschedules an entry" do
+    delivered = []
+    loop.run do
+      subject.start { |values| delivered.concat(values) }
+      id = subject.schedule(10, :pushed_back)
+      subject.schedule(20, :first)
+      expect(subject.reschedule(id, 40)).to be true
+    end
+    expect(delivered).to eq([:first, :pushed_back])
+  end
+
+  it "does not match the ids of delivered entries" do
+    ids = []
+    loop.run do
+      subject.start do |values|
+        expect(subject.reschedule(ids.first, 10)).to be false
+        ids << subject.schedule(0, :second) if ids.size == 1
+      end
+      ids << subject.schedule(0, :first)
+    end
+    expect(ids[1]).not_to eq(ids[0])
+  end
+
+  it "does not keep the loop alive without entries" do
+    subject.start { }
+    loop.run
+    expect(subject.active?).to be false
+  end
+end